@@ -0,0 +1,126 @@
+//Compares the collision broadphases with moving colliders at different scales
+//Usage: UnEngine_BroadphaseBench [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Broadphase.h"
+
+struct Body
+{
+	float x, y, halfWidth, halfHeight, vx, vy;
+
+	une::Bounds GetBounds() const
+	{
+		return { y + halfHeight, x + halfWidth, y - halfHeight, x - halfWidth };
+	}
+};
+
+//Spawn bodies at a constant density so every scale has a similar amount of overlaps per collider
+std::vector<Body> SpawnBodies(int count, float& worldSize)
+{
+	std::mt19937 rng(1234);
+	worldSize = std::sqrt((float)count) * 40;
+	std::uniform_real_distribution<float> position(0, worldSize);
+	std::uniform_real_distribution<float> size(4, 12);
+	std::uniform_real_distribution<float> velocity(-2, 2);
+
+	std::vector<Body> bodies(count);
+	for (Body& body : bodies)
+		body = { position(rng), position(rng), size(rng), size(rng), velocity(rng), velocity(rng) };
+	return bodies;
+}
+
+void RunBenchmark(const std::string& name, une::Broadphase& broadphase, int count, int frames)
+{
+	float worldSize;
+	std::vector<Body> bodies = SpawnBodies(count, worldSize);
+	for (size_t i = 0; i < bodies.size(); i++)
+		broadphase.Update(i + 1, bodies[i].GetBounds());
+
+	std::vector<ecs::Entity> results;
+	double updateTime = 0;
+	double queryTime = 0;
+	uint64_t candidates = 0;
+	uint64_t overlaps = 0;
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		//Move every body, bouncing off the world edges
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < bodies.size(); i++)
+		{
+			Body& body = bodies[i];
+			body.x += body.vx;
+			body.y += body.vy;
+			if (body.x < 0 || body.x > worldSize)
+				body.vx = -body.vx;
+			if (body.y < 0 || body.y > worldSize)
+				body.vy = -body.vy;
+			broadphase.Update(i + 1, body.GetBounds());
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		updateTime += std::chrono::duration<double, std::milli>(end - start).count();
+
+		//Query every body like CollisionSystem::CheckCollision does
+		start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < bodies.size(); i++)
+		{
+			const une::Bounds bounds = bodies[i].GetBounds();
+			results.clear();
+			broadphase.Query(bounds, results);
+			candidates += results.size();
+			for (ecs::Entity entity : results)
+			{
+				if (entity != i + 1 && une::BoundsOverlap(bodies[entity - 1].GetBounds(), bounds))
+					overlaps++;
+			}
+		}
+		end = std::chrono::high_resolution_clock::now();
+		queryTime += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	std::cout << std::left << std::setw(12) << name << std::right
+		<< std::setw(10) << count
+		<< std::setw(14) << std::fixed << std::setprecision(3) << updateTime / frames
+		<< std::setw(14) << queryTime / frames
+		<< std::setw(14) << (updateTime + queryTime) / frames
+		<< std::setw(14) << candidates / frames
+		<< std::setw(12) << overlaps / frames << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const int frames = argc > 1 ? std::stoi(argv[1]) : 10;
+
+	std::cout << std::left << std::setw(12) << "broadphase" << std::right
+		<< std::setw(10) << "colliders"
+		<< std::setw(14) << "update ms"
+		<< std::setw(14) << "query ms"
+		<< std::setw(14) << "total ms"
+		<< std::setw(14) << "candidates"
+		<< std::setw(12) << "overlaps" << std::endl;
+
+	for (int count : { 1000, 10000, 50000 })
+	{
+		//Brute force is quadratic so run it for fewer frames at larger scales
+		une::BruteForceBroadphase bruteForce;
+		RunBenchmark("bruteForce", bruteForce, count, std::max(1, frames * 1000 / count));
+		une::AABBTree tree;
+		RunBenchmark("aabbTree", tree, count, frames);
+		//Cells roughly twice the average collider size
+		une::SpatialHashGrid grid(32);
+		RunBenchmark("spatialHash", grid, count, frames);
+		une::SweepAndPrune sweepAndPrune;
+		RunBenchmark("sweepPrune", sweepAndPrune, count, frames);
+	}
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+//Measures PhysicsSystem ticks on free falling rigidbodies without colliders, some of which are kinematic
+//Gravity, drag and movement are applied to packed arrays, most of the tick is copying the bodies between them and the Rigidbody and Transform components
+//Usage: UnEngine_IntegrationBench [ticks] [bodies]
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Physics.h"
+#include "utils/Timing.h"
+
+using namespace une;
+
+int main(int argc, char** argv)
+{
+	const int ticks = argc > 1 ? std::stoi(argv[1]) : 120;
+	const int bodyCount = argc > 2 ? std::stoi(argv[2]) : 100000;
+
+	ecs::SetComponentDestructor<Rigidbody>(PhysicsSystem::OnRigidbodyRemoved);
+	std::shared_ptr<PhysicsSystem> physicsSystem = ecs::GetSystem<PhysicsSystem>();
+	physicsSystem->gravity = Vector3(0, -100, 0);
+
+	//Every tenth body is kinematic and stays still, the rest fall with some drag
+	for (int i = 0; i < bodyCount; i++)
+	{
+		ecs::Entity entity = ecs::NewEntity();
+		ecs::AddComponent(entity, Transform{ .position = Vector3(i % 1000, i / 1000, 0) });
+		ecs::AddComponent(entity, Rigidbody{ .drag = 0.1f * (i % 4), .kinematic = i % 10 == 0, .canSleep = false });
+	}
+
+	double time = 0;
+	double slowest = 0;
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		deltaTime = 1.0 / physicsSystem->tickRate;
+		auto start = std::chrono::high_resolution_clock::now();
+		physicsSystem->Update();
+		auto end = std::chrono::high_resolution_clock::now();
+		const double tickTime = std::chrono::duration<double, std::milli>(end - start).count();
+		time += tickTime;
+		//The first tick also looks up every component
+		if (tick > 0)
+			slowest = std::max(slowest, tickTime);
+	}
+	time /= ticks;
+
+	std::cout << bodyCount << " bodies, " << physicsSystem->step << " steps per tick" << std::endl;
+	std::cout << std::fixed << std::setprecision(3)
+		<< "tick ms " << time
+		<< ", slowest ms " << slowest
+		<< ", ns per body per step " << time * 1e6 / bodyCount / physicsSystem->step << std::endl;
+	return 0;
+}
@@ -0,0 +1,136 @@
+//Measures PhysicsSystem ticks on separate piles of boxes with different thread counts, each pile is one island
+//Every thread count must end with exactly the same positions, the hash column shows whether they did
+//Usage: UnEngine_IslandSolverBench [ticks] [piles] [boxes per pile]
+
+#include <bit>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Collision.h"
+#include "Physics.h"
+#include "utils/ThreadPool.h"
+#include "utils/Timing.h"
+
+using namespace une;
+
+//Stack brick rows of boxes on a shared ground, with every other row shifted by half a box so the whole pile touches
+std::vector<ecs::Entity> CreatePiles(int pileCount, int boxesPerPile)
+{
+	constexpr int pileWidth = 10;
+	constexpr double boxSize = 2;
+	const std::vector<Vector2> box{ { -1, 1 }, { 1, 1 }, { 1, -1 }, { -1, -1 } };
+	const double pileSpacing = pileWidth * boxSize + 20;
+
+	std::vector<ecs::Entity> entities;
+	ecs::Entity ground = ecs::NewEntity();
+	const double groundWidth = pileCount * pileSpacing / 2 + 10;
+	ecs::AddComponent(ground, Transform{ .position = Vector3(groundWidth - 10, -1, 0) });
+	ecs::AddComponent(ground, PolygonCollider{ .vertices = { { -groundWidth, 1 }, { groundWidth, 1 }, { groundWidth, -1 }, { -groundWidth, -1 } } });
+	ecs::AddComponent(ground, Rigidbody{ .restitution = 0, .kinematic = true });
+	entities.push_back(ground);
+
+	for (int pile = 0; pile < pileCount; pile++)
+	{
+		for (int i = 0; i < boxesPerPile; i++)
+		{
+			const int row = i / pileWidth;
+			const int column = i % pileWidth;
+			ecs::Entity entity = ecs::NewEntity();
+			const double x = pile * pileSpacing + column * boxSize + (row % 2) * boxSize / 2;
+			ecs::AddComponent(entity, Transform{ .position = Vector3(x, 1 + row * (boxSize + 0.05), 0) });
+			ecs::AddComponent(entity, PolygonCollider{ .vertices = box });
+			ecs::AddComponent(entity, Rigidbody{ .restitution = 0, .canSleep = false });
+			entities.push_back(entity);
+		}
+	}
+	return entities;
+}
+
+//FNV-1a over the positions of the entities, in order
+uint64_t HashPositions(const std::vector<ecs::Entity>& entities)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](uint64_t value)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				hash ^= (value >> (i * 8)) & 0xff;
+				hash *= 1099511628211ull;
+			}
+		};
+	for (ecs::Entity entity : entities)
+	{
+		const Transform& transform = ecs::GetComponent<Transform>(entity);
+		mix(std::bit_cast<uint64_t>(transform.position.x));
+		mix(std::bit_cast<uint64_t>(transform.position.y));
+	}
+	return hash;
+}
+
+//Build the piles and let them settle with a thread count, returns the milliseconds per tick
+double RunBenchmark(unsigned int threadCount, int ticks, int pileCount, int boxesPerPile, double baseTime)
+{
+	GetThreadPool().SetThreadCount(threadCount);
+	std::shared_ptr<PhysicsSystem> physicsSystem = ecs::GetSystem<PhysicsSystem>();
+	std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+	std::shared_ptr<TransformSystem> transformSystem = ecs::GetSystem<TransformSystem>();
+
+	std::vector<ecs::Entity> entities = CreatePiles(pileCount, boxesPerPile);
+	collisionSystem->Update();
+	transformSystem->Update();
+
+	//One tick per frame, the same as the engine's update order
+	double time = 0;
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		deltaTime = 1.0 / physicsSystem->tickRate;
+		auto start = std::chrono::high_resolution_clock::now();
+		physicsSystem->Update();
+		auto end = std::chrono::high_resolution_clock::now();
+		time += std::chrono::duration<double, std::milli>(end - start).count();
+
+		collisionSystem->Update();
+		transformSystem->Update();
+	}
+	time /= ticks;
+
+	std::cout << std::setw(8) << threadCount
+		<< std::setw(14) << std::fixed << std::setprecision(3) << time
+		<< std::setw(10) << std::setprecision(2) << (baseTime > 0 ? baseTime / time : 1.0)
+		<< std::setw(12) << physicsSystem->GetManifolds().size()
+		<< std::setw(20) << std::hex << HashPositions(entities) << std::dec << std::endl;
+
+	//Start the next thread count from an empty world. Destroying in reverse gives the next piles the same entities, so the manifolds are solved in the same order
+	for (auto entity = entities.rbegin(); entity != entities.rend(); entity++)
+		ecs::DestroyEntity(*entity);
+	ecs::Update();
+	physicsSystem->Update();
+	return time;
+}
+
+int main(int argc, char** argv)
+{
+	const int ticks = argc > 1 ? std::stoi(argv[1]) : 120;
+	const int pileCount = argc > 2 ? std::stoi(argv[2]) : 50;
+	const int boxesPerPile = argc > 3 ? std::stoi(argv[3]) : 200;
+
+	ecs::SetComponentDestructor<PolygonCollider>(CollisionSystem::OnColliderRemoved);
+	ecs::SetComponentDestructor<Rigidbody>(PhysicsSystem::OnRigidbodyRemoved);
+	ecs::GetSystem<PhysicsSystem>()->gravity = Vector3(0, -100, 0);
+
+	std::cout << pileCount << " piles of " << boxesPerPile << " boxes, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	std::cout << std::setw(8) << "threads"
+		<< std::setw(14) << "tick ms"
+		<< std::setw(10) << "speedup"
+		<< std::setw(12) << "manifolds"
+		<< std::setw(20) << "hash" << std::endl;
+
+	const double baseTime = RunBenchmark(1, ticks, pileCount, boxesPerPile, 0);
+	for (unsigned int threadCount : { 2, 4, 8, 16 })
+		RunBenchmark(threadCount, ticks, pileCount, boxesPerPile, baseTime);
+
+	return 0;
+}
@@ -0,0 +1,179 @@
+//Measures the SAT narrowphase on pairs of polygons with different vertex counts, and the closed form tests of circles and capsules
+//Usage: UnEngine_NarrowphaseBench [iterations]
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Collision.h"
+
+using namespace une;
+
+//Regular polygon going clockwise
+std::vector<Vector2> RegularPolygon(int vertexCount, double radius)
+{
+	std::vector<Vector2> vertices;
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const double angle = PI / 4 - 2 * PI * i / vertexCount;
+		vertices.emplace_back(cos(angle) * radius, sin(angle) * radius);
+	}
+	return vertices;
+}
+
+//Time every pair with the vertice overload and the cached overload the CollisionSystem uses
+void RunBenchmark(const std::string& name, const std::vector<Vector2>& aShape, const std::vector<Vector2>& bShape, int iterations)
+{
+	constexpr int pairCount = 1000;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<double> offset(-4, 4);
+	std::uniform_real_distribution<double> rotation(0, 360);
+
+	//Place pairs at random offsets so roughly half of them collide
+	std::vector<ecs::Entity> aEntities;
+	std::vector<ecs::Entity> bEntities;
+	std::vector<std::vector<Vector2>> aVertices;
+	std::vector<std::vector<Vector2>> bVertices;
+	for (int i = 0; i < pairCount; i++)
+	{
+		ecs::Entity a = ecs::NewEntity();
+		ecs::AddComponent(a, Transform{ .rotation = Vector3(0, 0, rotation(rng)) });
+		ecs::AddComponent(a, PolygonCollider{ .vertices = aShape });
+		ecs::Entity b = ecs::NewEntity();
+		ecs::AddComponent(b, Transform{ .position = Vector3(offset(rng), offset(rng), 0), .rotation = Vector3(0, 0, rotation(rng)) });
+		ecs::AddComponent(b, PolygonCollider{ .vertices = bShape });
+
+		CollisionSystem::UpdateAABB(a);
+		CollisionSystem::UpdateAABB(b);
+		aEntities.push_back(a);
+		bEntities.push_back(b);
+		aVertices.push_back(TransformSystem::ApplyTransforms2D(aShape, TransformSystem::GetGlobalTransform(a)));
+		bVertices.push_back(TransformSystem::ApplyTransforms2D(bShape, TransformSystem::GetGlobalTransform(b)));
+	}
+
+	std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+	std::vector<PolygonView> aPolygons;
+	std::vector<PolygonView> bPolygons;
+	for (int i = 0; i < pairCount; i++)
+	{
+		aPolygons.push_back(collisionSystem->GetWorldPolygon(aEntities[i]));
+		bPolygons.push_back(collisionSystem->GetWorldPolygon(bEntities[i]));
+	}
+
+	int hits = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < pairCount; i++)
+			hits += CollisionSystem::SATIntersect(aVertices[i], bVertices[i]).type != Collision::Type::miss;
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	const double verticeTime = std::chrono::duration<double, std::nano>(end - start).count() / ((double)iterations * pairCount);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < pairCount; i++)
+			hits += CollisionSystem::SATIntersect(aPolygons[i], bPolygons[i]).type != Collision::Type::miss;
+	}
+	end = std::chrono::high_resolution_clock::now();
+	const double cachedTime = std::chrono::duration<double, std::nano>(end - start).count() / ((double)iterations * pairCount);
+
+	std::cout << std::left << std::setw(16) << name << std::right
+		<< std::setw(16) << std::fixed << std::setprecision(1) << verticeTime
+		<< std::setw(16) << cachedTime
+		<< std::setw(10) << std::setprecision(2) << hits / (2.0 * iterations * pairCount) << std::endl;
+
+	for (int i = 0; i < pairCount; i++)
+	{
+		ecs::DestroyEntity(aEntities[i]);
+		ecs::DestroyEntity(bEntities[i]);
+	}
+}
+
+//Time the closed form tests on circles and capsules, a capsule with halfLength 0 is a circle. bShape is used instead of b's capsule if it isn't empty
+void RunCapsuleBenchmark(const std::string& name, double aHalfLength, const std::vector<Vector2>& bShape, double bHalfLength, int iterations)
+{
+	constexpr int pairCount = 1000;
+	constexpr double radius = 2;
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<double> offset(-4, 4);
+	std::uniform_real_distribution<double> rotation(0, 2 * PI);
+
+	//Same placement as the polygon pairs
+	struct Pair
+	{
+		Vector2 aStart, aEnd, bStart, bEnd;
+		std::vector<Vector2> bVertices;
+		std::vector<Vector2> bAxes;
+	};
+	std::vector<Pair> pairs(pairCount);
+	for (Pair& pair : pairs)
+	{
+		const double aAngle = rotation(rng);
+		const Vector2 aDirection(cos(aAngle) * aHalfLength, sin(aAngle) * aHalfLength);
+		pair.aStart = Vector2() - aDirection;
+		pair.aEnd = aDirection;
+
+		const Vector2 bPosition(offset(rng), offset(rng));
+		const double bAngle = rotation(rng);
+		const Vector2 bDirection(cos(bAngle) * bHalfLength, sin(bAngle) * bHalfLength);
+		pair.bStart = bPosition - bDirection;
+		pair.bEnd = bPosition + bDirection;
+		for (const Vector2& vertex : bShape)
+			pair.bVertices.push_back(Vector2(vertex.x * cos(bAngle) - vertex.y * sin(bAngle), vertex.x * sin(bAngle) + vertex.y * cos(bAngle)) + bPosition);
+		for (size_t i = 0; i < pair.bVertices.size(); i++)
+			pair.bAxes.push_back((pair.bVertices[(i + 1) % pair.bVertices.size()] - pair.bVertices[i]).LeftNormal());
+	}
+
+	int hits = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (const Pair& pair : pairs)
+		{
+			if (bShape.empty())
+				hits += CollisionSystem::CapsuleIntersect(pair.aStart, pair.aEnd, radius, pair.bStart, pair.bEnd, radius).type != Collision::Type::miss;
+			else
+			{
+				const PolygonView polygon{ pair.bVertices.data(), (uint32_t)pair.bVertices.size(), pair.bAxes.data(), (uint32_t)pair.bAxes.size() };
+				hits += CollisionSystem::CapsulePolygonIntersect(pair.aStart, pair.aEnd, radius, polygon).type != Collision::Type::miss;
+			}
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	const double time = std::chrono::duration<double, std::nano>(end - start).count() / ((double)iterations * pairCount);
+
+	std::cout << std::left << std::setw(16) << name << std::right
+		<< std::setw(16) << "-"
+		<< std::setw(16) << std::fixed << std::setprecision(1) << time
+		<< std::setw(10) << std::setprecision(2) << hits / ((double)iterations * pairCount) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const int iterations = argc > 1 ? std::stoi(argv[1]) : 1000;
+
+	ecs::SetComponentDestructor<PolygonCollider>(CollisionSystem::OnColliderRemoved);
+
+	std::cout << std::left << std::setw(16) << "pair" << std::right
+		<< std::setw(16) << "vertices ns"
+		<< std::setw(16) << "cached ns"
+		<< std::setw(10) << "hit rate" << std::endl;
+
+	RunBenchmark("box-box", RegularPolygon(4, 2), RegularPolygon(4, 2), iterations);
+	RunBenchmark("hexagon-box", RegularPolygon(6, 2), RegularPolygon(4, 2), iterations);
+	RunBenchmark("16gon-16gon", RegularPolygon(16, 2), RegularPolygon(16, 2), iterations);
+
+	//Circles compared to the 16-gons approximating them above
+	RunCapsuleBenchmark("circle-circle", 0, {}, 0, iterations);
+	RunCapsuleBenchmark("circle-box", 0, RegularPolygon(4, 2), 0, iterations);
+	RunCapsuleBenchmark("capsule-capsule", 1, {}, 1, iterations);
+	RunCapsuleBenchmark("capsule-box", 1, RegularPolygon(4, 2), 0, iterations);
+
+	return 0;
+}
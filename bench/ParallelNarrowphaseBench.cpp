@@ -0,0 +1,132 @@
+//Measures CollisionSystem::DetectCollisions on densely packed moving colliders with different thread counts
+//Every thread count must find exactly the same contacts, the hash column shows whether they did
+//Usage: UnEngine_ParallelNarrowphaseBench [frames] [colliders]
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Collision.h"
+#include "utils/ThreadPool.h"
+
+using namespace une;
+
+//Regular polygon going clockwise
+std::vector<Vector2> RegularPolygon(int vertexCount, double radius)
+{
+	std::vector<Vector2> vertices;
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const double angle = PI / 4 - 2 * PI * i / vertexCount;
+		vertices.emplace_back(cos(angle) * radius, sin(angle) * radius);
+	}
+	return vertices;
+}
+
+//FNV-1a over everything the contacts contain, in order
+uint64_t HashContacts(const std::vector<Collision>& contacts, uint64_t hash)
+{
+	auto mix = [&hash](uint64_t value)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				hash ^= (value >> (i * 8)) & 0xff;
+				hash *= 1099511628211ull;
+			}
+		};
+	for (const Collision& contact : contacts)
+	{
+		mix(((uint64_t)contact.a << 32) | contact.b);
+		mix((uint64_t)contact.type);
+		mix(std::bit_cast<uint64_t>(contact.mtv.x));
+		mix(std::bit_cast<uint64_t>(contact.mtv.y));
+		mix(std::bit_cast<uint64_t>(contact.normal.x));
+		mix(std::bit_cast<uint64_t>(contact.normal.y));
+	}
+	return hash;
+}
+
+//Run the same frames from the same starting positions with a thread count, returns the milliseconds per frame
+double RunBenchmark(unsigned int threadCount, const std::vector<ecs::Entity>& entities, const std::vector<Vector3>& startPositions, int frames, double baseTime)
+{
+	GetThreadPool().SetThreadCount(threadCount);
+	std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+	std::shared_ptr<TransformSystem> transformSystem = ecs::GetSystem<TransformSystem>();
+
+	for (size_t i = 0; i < entities.size(); i++)
+		TransformSystem::SetPosition(entities[i], startPositions[i]);
+	collisionSystem->DetectCollisions();
+	transformSystem->Update();
+
+	//Jiggle every collider each frame so every pair is tested again
+	std::mt19937 rng(5678);
+	std::uniform_real_distribution<double> jiggle(-0.5, 0.5);
+	uint64_t hash = 14695981039346656037ull;
+	size_t contacts = 0;
+	double time = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (ecs::Entity entity : entities)
+			TransformSystem::Translate(entity, Vector3(jiggle(rng), jiggle(rng), 0));
+
+		auto start = std::chrono::high_resolution_clock::now();
+		collisionSystem->DetectCollisions();
+		auto end = std::chrono::high_resolution_clock::now();
+		time += std::chrono::duration<double, std::milli>(end - start).count();
+
+		hash = HashContacts(collisionSystem->GetContacts(), hash);
+		contacts += collisionSystem->GetContacts().size();
+		transformSystem->Update();
+	}
+	time /= frames;
+
+	std::cout << std::setw(8) << threadCount
+		<< std::setw(14) << std::fixed << std::setprecision(3) << time
+		<< std::setw(10) << std::setprecision(2) << (baseTime > 0 ? baseTime / time : 1.0)
+		<< std::setw(12) << contacts / frames
+		<< std::setw(20) << std::hex << hash << std::dec << std::endl;
+	return time;
+}
+
+int main(int argc, char** argv)
+{
+	const int frames = argc > 1 ? std::stoi(argv[1]) : 20;
+	const int colliderCount = argc > 2 ? std::stoi(argv[2]) : 20000;
+
+	ecs::SetComponentDestructor<PolygonCollider>(CollisionSystem::OnColliderRemoved);
+
+	//Pack the colliders so each one touches a few others
+	std::mt19937 rng(1234);
+	const double worldSize = std::sqrt((double)colliderCount) * 6;
+	std::uniform_real_distribution<double> position(0, worldSize);
+	std::uniform_real_distribution<double> rotation(0, 360);
+	std::uniform_int_distribution<int> vertexCount(4, 8);
+	std::vector<ecs::Entity> entities;
+	std::vector<Vector3> startPositions;
+	for (int i = 0; i < colliderCount; i++)
+	{
+		ecs::Entity entity = ecs::NewEntity();
+		startPositions.emplace_back(position(rng), position(rng), 0);
+		ecs::AddComponent(entity, Transform{ .position = startPositions.back(), .rotation = Vector3(0, 0, rotation(rng)) });
+		ecs::AddComponent(entity, PolygonCollider{ .vertices = RegularPolygon(vertexCount(rng), 3) });
+		entities.push_back(entity);
+	}
+
+	std::cout << colliderCount << " colliders, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+	std::cout << std::setw(8) << "threads"
+		<< std::setw(14) << "detect ms"
+		<< std::setw(10) << "speedup"
+		<< std::setw(12) << "contacts"
+		<< std::setw(20) << "hash" << std::endl;
+
+	const double baseTime = RunBenchmark(1, entities, startPositions, frames, 0);
+	for (unsigned int threadCount : { 2, 4, 8, 16 })
+		RunBenchmark(threadCount, entities, startPositions, frames, baseTime);
+
+	return 0;
+}
@@ -0,0 +1,271 @@
+//Runs physics scenes without a window and prints how long each system took per tick as JSON, to catch performance regressions
+//The hash of the final state shows whether a change also changed the results
+//Usage: UnEngine_PhysicsBench [scene] [ticks] [bodies] [threads]
+//Scenes are falling, piles, projectiles, corridors or all. 0 threads uses every hardware thread
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "UnEngine.h"
+#include "Tilemap.h"
+#include "TilemapCollision.h"
+#include "utils/ThreadPool.h"
+
+using namespace une;
+
+const std::vector<Vector2> box{ { -1, 1 }, { 1, 1 }, { 1, -1 }, { -1, -1 } };
+
+//Static box covering [left, right] x [bottom, top]
+ecs::Entity CreateWall(std::vector<ecs::Entity>& entities, double left, double right, double bottom, double top)
+{
+	const double halfWidth = (right - left) / 2;
+	const double halfHeight = (top - bottom) / 2;
+	ecs::Entity entity = ecs::NewEntity();
+	ecs::AddComponent(entity, Transform{ .position = Vector3(left + halfWidth, bottom + halfHeight, 0) });
+	ecs::AddComponent(entity, PolygonCollider{ .vertices = { { -halfWidth, halfHeight }, { halfWidth, halfHeight }, { halfWidth, -halfHeight }, { -halfWidth, -halfHeight } } });
+	ecs::AddComponent(entity, Rigidbody{ .restitution = 0, .kinematic = true });
+	entities.push_back(entity);
+	return entity;
+}
+
+//A box, circle or capsule body depending on shape
+ecs::Entity CreateBody(std::vector<ecs::Entity>& entities, int shape, Vector3 position, Rigidbody rigidbody)
+{
+	ecs::Entity entity = ecs::NewEntity();
+	ecs::AddComponent(entity, Transform{ .position = position });
+	if (shape == 0)
+		ecs::AddComponent(entity, PolygonCollider{ .vertices = box });
+	else if (shape == 1)
+		ecs::AddComponent(entity, CircleCollider{ .radius = 1 });
+	else
+		ecs::AddComponent(entity, CapsuleCollider{ .start = Vector2(0, -0.5), .end = Vector2(0, 0.5), .radius = 0.75 });
+	ecs::AddComponent(entity, rigidbody);
+	entities.push_back(entity);
+	return entity;
+}
+
+//Boxes, circles and capsules raining down onto the ground in loose columns
+void CreateFalling(std::vector<ecs::Entity>& entities, int bodyCount, std::mt19937& rng)
+{
+	const int columns = std::max((int)std::sqrt((double)bodyCount), 1);
+	const double width = columns * 4;
+	CreateWall(entities, -10, width + 10, -2, 0);
+	std::uniform_real_distribution<double> jitter(-0.5, 0.5);
+	for (int i = 0; i < bodyCount; i++)
+	{
+		const Vector3 position((i % columns) * 4 + 2 + jitter(rng), 10 + (i / columns) * 4 + jitter(rng), 0);
+		CreateBody(entities, i % 3, position, Rigidbody{ .restitution = 0.3f });
+	}
+}
+
+//Brick rows of boxes in piles of 100 which settle and fall asleep
+void CreatePiles(std::vector<ecs::Entity>& entities, int bodyCount, std::mt19937& rng)
+{
+	constexpr int pileWidth = 10;
+	constexpr int boxesPerPile = 100;
+	const int pileCount = std::max((bodyCount + boxesPerPile - 1) / boxesPerPile, 1);
+	const double pileSpacing = pileWidth * 2 + 20;
+	CreateWall(entities, -10, pileCount * pileSpacing, -2, 0);
+	for (int i = 0; i < bodyCount; i++)
+	{
+		const int pile = i / boxesPerPile;
+		const int row = (i % boxesPerPile) / pileWidth;
+		const int column = i % pileWidth;
+		const Vector3 position(pile * pileSpacing + column * 2 + (row % 2), 1 + row * 2.05, 0);
+		CreateBody(entities, 0, position, Rigidbody{ .restitution = 0 });
+	}
+}
+
+//Fast swept boxes without gravity shot at columns of static targets
+void CreateProjectiles(std::vector<ecs::Entity>& entities, int bodyCount, std::mt19937& rng)
+{
+	const double fieldSize = std::sqrt((double)bodyCount) * 6 + 20;
+	for (int column = 0; column < 4; column++)
+	{
+		for (double y = 0; y < fieldSize; y += 8)
+			CreateWall(entities, fieldSize + column * 20, fieldSize + column * 20 + 4, y, y + 4);
+	}
+
+	std::uniform_real_distribution<double> position(0, fieldSize);
+	std::uniform_real_distribution<double> speed(300, 600);
+	std::uniform_real_distribution<double> spread(-100, 100);
+	for (int i = 0; i < bodyCount; i++)
+	{
+		ecs::Entity entity = CreateBody(entities, 0, Vector3(position(rng) - fieldSize, position(rng), 0), Rigidbody{ .gravityScale = 0, .restitution = 0.5f, .ccd = true });
+		ecs::GetComponent<Rigidbody>(entity).velocity = Vector3(speed(rng), spread(rng), 0);
+	}
+}
+
+//Long corridors lined with the tiles of a tilemap collision layer, with bodies sliding along their floors
+//The walls of each corridor are merged into a few boxes, which the bodies collide with through CollideTiles
+std::unique_ptr<Tilemap> corridorMap;
+void CreateCorridors(std::vector<ecs::Entity>& entities, int bodyCount, std::mt19937& rng)
+{
+	constexpr int bodiesPerCorridor = 50;
+	constexpr int corridorLength = 100;
+	constexpr int corridorHeight = 4;
+	constexpr int tileSize = 2;
+	const int corridorCount = std::max((bodyCount + bodiesPerCorridor - 1) / bodiesPerCorridor, 1);
+
+	//Every corridor is a ceiling row, the rows inside it and a floor row, closed off by a column of tiles on each end
+	corridorMap = std::make_unique<Tilemap>();
+	corridorMap->Create(Vector2Int(tileSize, tileSize), corridorLength + 2, corridorCount * (corridorHeight + 2), 1);
+	corridorMap->mapLayers[0]->hasCollision = true;
+	std::vector<Tilemap::TileEdit> walls;
+	for (int corridor = 0; corridor < corridorCount; corridor++)
+	{
+		const int ceiling = corridor * (corridorHeight + 2);
+		const int floor = ceiling + corridorHeight + 1;
+		for (int x = 0; x < corridorLength + 2; x++)
+		{
+			walls.push_back(Tilemap::TileEdit{ .pos = Vector2Int(x, ceiling), .gid = 1 });
+			walls.push_back(Tilemap::TileEdit{ .pos = Vector2Int(x, floor), .gid = 1 });
+		}
+		for (int y = ceiling + 1; y < floor; y++)
+		{
+			walls.push_back(Tilemap::TileEdit{ .pos = Vector2Int(0, y), .gid = 1 });
+			walls.push_back(Tilemap::TileEdit{ .pos = Vector2Int(corridorLength + 1, y), .gid = 1 });
+		}
+	}
+	corridorMap->SetTiles(0, walls);
+
+	ecs::Entity map = ecs::NewEntity();
+	ecs::AddComponent(map, Transform{});
+	ecs::AddComponent(map, TilemapCollider{ .tilemap = corridorMap.get() });
+	entities.push_back(map);
+
+	//Tile rows go down from the map's origin
+	std::uniform_real_distribution<double> speed(-40, 40);
+	for (int corridor = 0; corridor < corridorCount; corridor++)
+	{
+		const double floorTop = -(corridor * (corridorHeight + 2) + corridorHeight + 1) * tileSize;
+		const int bodies = std::min(bodiesPerCorridor, bodyCount - corridor * bodiesPerCorridor);
+		for (int i = 0; i < bodies; i++)
+		{
+			const Vector3 position(tileSize + (i + 0.5) * corridorLength * tileSize / bodiesPerCorridor, floorTop + tileSize, 0);
+			ecs::Entity entity = CreateBody(entities, i % 2, position, Rigidbody{ .restitution = 0.8f, .canSleep = false });
+			ecs::GetComponent<Rigidbody>(entity).velocity = Vector3(speed(rng), 0, 0);
+		}
+	}
+}
+
+//Mean and percentiles of the tick times of a system
+std::string TimingJSON(std::vector<double> times)
+{
+	std::sort(times.begin(), times.end());
+	auto percentile = [&times](double p)
+		{
+			return times[std::min((size_t)(p * times.size()), times.size() - 1)];
+		};
+	double mean = 0;
+	for (double time : times)
+		mean += time;
+	mean /= times.size();
+
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(4)
+		<< "{ \"mean\": " << mean
+		<< ", \"p50\": " << percentile(0.5)
+		<< ", \"p90\": " << percentile(0.9)
+		<< ", \"p99\": " << percentile(0.99)
+		<< ", \"max\": " << times.back() << " }";
+	return json.str();
+}
+
+//Build a scene, run it for ticks and destroy it, returns the scene as a JSON object
+std::string RunScene(const std::string& name, const std::function<void(std::vector<ecs::Entity>&, int, std::mt19937&)>& create, int ticks, int bodyCount)
+{
+	std::mt19937 rng(1234);
+	std::vector<ecs::Entity> entities;
+	create(entities, bodyCount, rng);
+	collisionSystem->Update();
+	transformSystem->Update();
+
+	//Same order as the engine's update, all times are in milliseconds
+	std::vector<double> physicsTimes, collisionTimes, transformTimes, totalTimes;
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		deltaTime = 1.0 / physicsSystem->tickRate;
+		auto start = std::chrono::high_resolution_clock::now();
+		physicsSystem->Update();
+		auto physicsEnd = std::chrono::high_resolution_clock::now();
+		collisionSystem->Update();
+		auto collisionEnd = std::chrono::high_resolution_clock::now();
+		transformSystem->Update();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		physicsTimes.push_back(std::chrono::duration<double, std::milli>(physicsEnd - start).count());
+		collisionTimes.push_back(std::chrono::duration<double, std::milli>(collisionEnd - physicsEnd).count());
+		transformTimes.push_back(std::chrono::duration<double, std::milli>(end - collisionEnd).count());
+		totalTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	std::ostringstream json;
+	json << "    {\n"
+		<< "      \"scene\": \"" << name << "\",\n"
+		<< "      \"bodies\": " << bodyCount << ",\n"
+		<< "      \"entities\": " << entities.size() << ",\n"
+		<< "      \"ticks\": " << ticks << ",\n"
+		<< "      \"manifolds\": " << physicsSystem->GetManifolds().size() << ",\n"
+		<< "      \"hash\": \"" << std::hex << std::setw(16) << std::setfill('0') << physicsSystem->GetStateHash() << std::dec << "\",\n"
+		<< "      \"physics\": " << TimingJSON(physicsTimes) << ",\n"
+		<< "      \"collision\": " << TimingJSON(collisionTimes) << ",\n"
+		<< "      \"transform\": " << TimingJSON(transformTimes) << ",\n"
+		<< "      \"total\": " << TimingJSON(totalTimes) << "\n"
+		<< "    }";
+
+	//Start the next scene from an empty world. Destroying in reverse gives the next scene the same entities every run
+	for (auto entity = entities.rbegin(); entity != entities.rend(); entity++)
+		ecs::DestroyEntity(*entity);
+	ecs::Update();
+	physicsSystem->Update();
+	collisionSystem->Update();
+	return json.str();
+}
+
+int main(int argc, char** argv)
+{
+	const std::string sceneName = argc > 1 ? argv[1] : "all";
+	const int ticks = argc > 2 ? std::stoi(argv[2]) : 300;
+	const int bodyCount = argc > 3 ? std::stoi(argv[3]) : 2000;
+	const unsigned int threadCount = argc > 4 ? std::stoi(argv[4]) : 0;
+
+	SimulationInit();
+	physicsSystem->gravity = Vector3(0, -100, 0);
+	GetThreadPool().SetThreadCount(threadCount);
+
+	const std::vector<std::pair<std::string, std::function<void(std::vector<ecs::Entity>&, int, std::mt19937&)>>> scenes{
+		{ "falling", CreateFalling },
+		{ "piles", CreatePiles },
+		{ "projectiles", CreateProjectiles },
+		{ "corridors", CreateCorridors } };
+
+	std::vector<std::string> results;
+	for (const auto& [name, create] : scenes)
+	{
+		if (sceneName == "all" || sceneName == name)
+			results.push_back(RunScene(name, create, ticks, bodyCount));
+	}
+	if (results.empty())
+	{
+		std::cerr << "Unknown scene " << sceneName << ", use falling, piles, projectiles, corridors or all" << std::endl;
+		return 1;
+	}
+
+	std::cout << "{\n"
+		<< "  \"threads\": " << GetThreadPool().GetThreadCount() << ",\n"
+		<< "  \"scenes\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+		std::cout << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+	std::cout << "  ]\n}" << std::endl;
+	return 0;
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <array>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+#include "ECS.h"
+
+namespace une
+{
+	//Axis-aligned bounding box in world coordinates. Bounds go top, right, bottom, left, same as PolygonCollider::bounds
+	using Bounds = std::array<float, 4>;
+	//Layer bits of an entity which is in every layer, or a mask which accepts every layer
+	constexpr uint32_t allLayers = ~0u;
+	//Two entities whose bounds overlap, first is always the smaller entity
+	using EntityPair = std::pair<ecs::Entity, ecs::Entity>;
+
+	//Pack two entities to a single key, smaller entity first
+	inline uint64_t PairKey(ecs::Entity a, ecs::Entity b)
+	{
+		if (a > b)
+			std::swap(a, b);
+		return ((uint64_t)a << 32) | b;
+	}
+
+	//Returns true if a and b overlap or touch
+	inline bool BoundsOverlap(const Bounds& a, const Bounds& b)
+	{
+		return a[3] <= b[1] && a[1] >= b[3] && a[2] <= b[0] && a[0] >= b[2];
+	}
+	//Returns true if outer fully contains inner
+	inline bool BoundsContain(const Bounds& outer, const Bounds& inner)
+	{
+		return outer[0] >= inner[0] && outer[1] >= inner[1] && outer[2] <= inner[2] && outer[3] <= inner[3];
+	}
+
+	//Interface for the structures CollisionSystem uses to find entities which might be colliding
+	class Broadphase
+	{
+	public:
+		virtual ~Broadphase() = default;
+
+		//Add an entity or update its bounds and layer bits if it has already been added
+		virtual void Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers = allLayers) = 0;
+		//Remove an entity, does nothing if it has not been added
+		virtual void Remove(ecs::Entity entity) = 0;
+		//Remove every entity
+		virtual void Clear() = 0;
+		//Has the entity been added
+		virtual bool Contains(ecs::Entity entity) const = 0;
+		//Append every entity whose bounds might overlap bounds and whose layer bits share a bit with layerMask to results
+		//This can return false positives but never false negatives
+		virtual void Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask = allLayers) = 0;
+	};
+
+	//Tests every entity against every query, O(n) per query. Mostly useful as a reference for the other broadphases
+	class BruteForceBroadphase : public Broadphase
+	{
+	public:
+		void Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers = allLayers) override;
+		void Remove(ecs::Entity entity) override;
+		void Clear() override;
+		bool Contains(ecs::Entity entity) const override;
+		void Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask = allLayers) override;
+
+	private:
+		//Entities and their bounds are stored densely, removing swaps the last element into the hole
+		std::vector<ecs::Entity> entities;
+		std::vector<Bounds> bounds;
+		std::vector<uint32_t> layers;
+		std::unordered_map<ecs::Entity, uint32_t> entityToIndex;
+	};
+
+	//Dynamic bounding volume hierarchy of fattened AABBs, O(log n) per query
+	//Each entity is stored as a leaf whose bounds are expanded by margin, so small movements don't require touching the tree
+	class AABBTree : public Broadphase
+	{
+	public:
+		void Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers = allLayers) override;
+		void Remove(ecs::Entity entity) override;
+		void Clear() override;
+		bool Contains(ecs::Entity entity) const override;
+		void Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask = allLayers) override;
+
+		//Height of the tree, mostly for debugging
+		int32_t Height() const;
+
+		//How much the stored bounds are expanded in every direction, bigger means fewer tree updates but more false positives
+		float margin = 4;
+
+	private:
+		static constexpr int32_t nullNode = -1;
+
+		struct Node
+		{
+			//Fattened bounds of a leaf or the union of both children
+			Bounds bounds;
+			//Parent node, or the next free node if this node is unused
+			int32_t parent = nullNode;
+			int32_t left = nullNode;
+			int32_t right = nullNode;
+			//Leaves are 0, unused nodes are -1
+			int32_t height = 0;
+			//Layer bits of a leaf or the union of both children
+			uint32_t layers = allLayers;
+			//Only valid on leaves
+			ecs::Entity entity = 0;
+
+			bool IsLeaf() const { return left == nullNode; }
+		};
+
+		//Get a node from the free list, grows the node pool if necessary
+		int32_t AllocateNode();
+		//Return a node to the free list
+		void FreeNode(int32_t node);
+		//Insert a leaf to the position in the tree that increases the total perimeter the least
+		void InsertLeaf(int32_t leaf);
+		//Detach a leaf from the tree without freeing it
+		void RemoveLeaf(int32_t leaf);
+		//Rotate the subtree at node if it is imbalanced, returns the new root of the subtree
+		int32_t Balance(int32_t node);
+
+		std::vector<Node> nodes;
+		int32_t root = nullNode;
+		int32_t freeList = nullNode;
+		std::unordered_map<ecs::Entity, int32_t> entityToLeaf;
+		//Traversal stack reused between queries
+		std::vector<int32_t> stack;
+	};
+
+	//Uniform grid of cells stored in a flat open-addressing hash table, O(1) per query when colliders are similar in size to a cell
+	//Each entity is linked into every cell its bounds touch, and is only relinked when it moves to a different set of cells
+	class SpatialHashGrid : public Broadphase
+	{
+	public:
+		explicit SpatialHashGrid(float cellSize = 64);
+
+		void Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers = allLayers) override;
+		void Remove(ecs::Entity entity) override;
+		void Clear() override;
+		bool Contains(ecs::Entity entity) const override;
+		void Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask = allLayers) override;
+
+		//Set the width and height of a cell in world units, this relinks every entity
+		void SetCellSize(float size);
+		float GetCellSize() const;
+
+	private:
+		static constexpr int32_t nullIndex = -1;
+
+		//Inclusive range of cells
+		struct CellRange
+		{
+			int32_t minX, minY, maxX, maxY;
+
+			bool operator==(const CellRange& other) const = default;
+		};
+		struct Proxy
+		{
+			ecs::Entity entity = 0;
+			Bounds bounds;
+			uint32_t layers = allLayers;
+			CellRange cells;
+			//Id of the last query which returned this proxy, prevents duplicates from entities in multiple cells
+			uint32_t lastQuery = 0;
+		};
+		//A slot in the hash table, one per occupied cell. Slots are only removed when the table is rehashed
+		struct Cell
+		{
+			uint64_t key = 0;
+			//First entry in this cell, nullIndex if the cell is empty
+			int32_t head = nullIndex;
+			bool used = false;
+		};
+		//Singly linked list node linking a proxy to a cell
+		struct Entry
+		{
+			int32_t proxy;
+			int32_t next;
+		};
+
+		CellRange GetCellRange(const Bounds& bounds) const;
+		//Find the slot of a cell, returns nullIndex if the cell does not exist and create is false
+		int32_t FindCell(int32_t x, int32_t y, bool create);
+		//Link or unlink a proxy to every cell in its range
+		void LinkProxy(int32_t proxy);
+		void UnlinkProxy(int32_t proxy);
+		//Resize the hash table, dropping cells which no longer contain anything
+		void Rehash(size_t capacity);
+
+		float cellSize;
+		std::vector<Cell> cells;
+		size_t usedCells = 0;
+		std::vector<Entry> entries;
+		int32_t freeEntry = nullIndex;
+		std::vector<Proxy> proxies;
+		std::vector<int32_t> freeProxies;
+		std::unordered_map<ecs::Entity, int32_t> entityToProxy;
+		uint32_t queryCount = 0;
+	};
+
+	//Sorted lists of bounds endpoints on both axes, kept sorted across frames with insertion sort
+	//With coherent motion each update only moves endpoints a few places, and the swaps maintain a persistent set of overlapping pairs
+	class SweepAndPrune : public Broadphase
+	{
+	public:
+		void Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers = allLayers) override;
+		void Remove(ecs::Entity entity) override;
+		void Clear() override;
+		bool Contains(ecs::Entity entity) const override;
+		void Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask = allLayers) override;
+
+		//Append every pair whose bounds currently overlap to result
+		void GetPairs(std::vector<EntityPair>& result) const;
+		//Append the pairs which started or stopped overlapping since the last call. Pairs which both started and stopped in between are not reported
+		void ConsumePairChanges(std::vector<EntityPair>& began, std::vector<EntityPair>& ended);
+
+	private:
+		//Pair state flags
+		static constexpr uint8_t overlapping = 1;
+		static constexpr uint8_t reported = 2;
+		static constexpr uint8_t queued = 4;
+
+		struct Endpoint
+		{
+			float value;
+			//Index of the box shifted left by one, lowest bit is set for max endpoints
+			uint32_t data;
+
+			uint32_t Box() const { return data >> 1; }
+			bool IsMax() const { return data & 1; }
+		};
+		struct Box
+		{
+			ecs::Entity entity = 0;
+			Bounds bounds;
+			uint32_t layers = allLayers;
+			//Indices of the endpoints on both axes, x is 0 and y is 1
+			uint32_t min[2];
+			uint32_t max[2];
+		};
+
+		//Move an endpoint down or up its axis until it is sorted, updating overlapping pairs along the way
+		void SortDown(int axis, uint32_t index, bool updatePairs);
+		void SortUp(int axis, uint32_t index, bool updatePairs);
+		//Swap two neighbouring endpoints and fix the indices of their boxes
+		void SwapEndpoints(int axis, uint32_t index);
+		//Do the boxes overlap on an axis according to the sorted endpoints
+		bool OverlapOnAxis(uint32_t a, uint32_t b, int axis) const;
+		void AddPair(uint32_t a, uint32_t b);
+		void RemovePair(uint32_t a, uint32_t b);
+		//Add a pair to the list of changed pairs if it isn't there already
+		void QueuePair(uint64_t key, uint8_t& flags);
+
+		std::vector<Endpoint> axes[2];
+		std::vector<Box> boxes;
+		std::vector<uint32_t> freeBoxes;
+		std::unordered_map<ecs::Entity, uint32_t> entityToBox;
+		//Widest bounds ever added, limits how far back queries need to look
+		float maxWidth = 0;
+
+		//Every overlapping pair, and the pairs which have been reported as began but have since ended, keyed by both entities
+		std::unordered_map<uint64_t, uint8_t> pairs;
+		//Keys of pairs which have changed since the last ConsumePairChanges
+		std::vector<uint64_t> changedPairs;
+	};
+}
@@ -3,10 +3,12 @@
 #include <vector>
 #include <array>
 #include <functional>
+#include <memory>
 
 #include "ECS.h"
 #include "Vector.h"
 #include "Transform.h"
+#include "Broadphase.h"
 
 namespace une
 {
@@ -14,15 +16,22 @@ namespace une
 	struct Collision
 	{
 		enum class Type { miss, collision, trigger, tilemapCollision, tilemapTrigger };
+		//Begin on the first frame of contact, stay while the contact persists, and end on the first frame the colliders no longer touch
+		enum class State { begin, stay, end };
 
 		Type type;
+		State state = State::begin;
 
 		//The entity which instigated the collision
 		ecs::Entity a;
 		//The entity which was subject to the collision
 		ecs::Entity b;
 		//In a tilemap collision this will be the tile GID
-		uint16_t tileGID = 0;
+		uint32_t tileGID = 0;
+		//In a tilemap collision the index of the tile's layer in Tilemap::mapLayers, and the index of the tile in the layer's row-major tiles
+		//For a box of merged tiles the index of its top left tile, so every tile and box touched is a separate contact
+		uint32_t tileLayer = 0;
+		uint32_t tileIndex = 0;
 
 		//The point of collision, will always be a vertice of one collider
 		Vector3 point;
@@ -30,8 +39,92 @@ namespace une
 		Vector3 normal;
 		//Minimum Translation Vector is the smallest translation needed to end overlap
 		Vector3 mtv;
+
+		//The same collision from the perspective of b
+		Collision Reversed() const
+		{
+			Collision reversed = *this;
+			reversed.a = b;
+			reversed.b = a;
+			reversed.normal = Vector2() - normal;
+			reversed.mtv = Vector2() - mtv;
+			return reversed;
+		}
+	};
+
+	//Non-owning view of a convex polygon in world coordinates and its normalized edge normals
+	struct PolygonView
+	{
+		const Vector2* vertices = nullptr;
+		uint32_t vertexCount = 0;
+		//Normals of the edges with parallel edges only included once
+		const Vector2* axes = nullptr;
+		uint32_t axisCount = 0;
+	};
+
+	//Which colliders and tiles a spatial query can hit, according to the collision layer matrix
+	struct QueryFilter
+	{
+		//Hit colliders and tiles whose layer collides with this layer
+		int layer = 0;
+		//Also hit triggers whose layer triggers with this layer
+		bool triggers = false;
+		//Never hit this entity, usually the one making the query
+		ecs::Entity ignore = 0;
+	};
+
+	//A ray in world coordinates
+	struct Ray
+	{
+		Vector2 origin;
+		//Doesn't need to be normalized
+		Vector2 direction;
+		double maxDistance = 10000;
+		QueryFilter filter;
+	};
+
+	//A convex polygon in world coordinates moved along a direction
+	struct ShapeCastQuery
+	{
+		//Vertices going clockwise, with transforms applied
+		std::vector<Vector2> polygon;
+		//Casts a circle or capsule instead when above 0, polygon then holds the circle's center or the ends of the capsule's segment
+		double radius = 0;
+		//Doesn't need to be normalized
+		Vector2 direction;
+		double maxDistance = 10000;
+		QueryFilter filter;
+	};
+
+	//A box in world coordinates
+	struct BoxQuery
+	{
+		Vector2 center;
+		Vector2 halfExtents;
+		//Rotation around the center, (0-360)degrees
+		float rotation = 0;
+		QueryFilter filter;
 	};
 
+	//Result of a spatial query
+	struct QueryHit
+	{
+		//Did the query hit anything, batched queries which missed leave this false
+		bool hit = false;
+		//The collider hit, or the entity with the TilemapCollider if a tile was hit
+		ecs::Entity entity = 0;
+		//GID of the tile hit, 0 if a collider was hit
+		uint32_t tileGID = 0;
+		//Where the query first touched the collider. For overlaps a point where the box and the collider meet
+		Vector2 point;
+		//Normal of the surface hit, facing back towards the query. For overlaps the direction which pushes the box out
+		Vector2 normal;
+		//How far along the direction the hit is. For overlaps how deep the box is inside the collider
+		double distance = 0;
+	};
+
+	class Tilemap;
+
 	//Polygon Collider component
 	ECS_REGISTER_COMPONENT(PolygonCollider)
 	struct PolygonCollider
@@ -39,11 +132,67 @@ namespace une
 		//The vertices of the polygon making up the collider, going clockwise. The vertices must form a convex polygon
 		//Make sure to set Transform::staleCache = true, when changing this
 		std::vector<Vector2> vertices;
-		//Callback function on collision
+		//Callback function on collision, called once per frame for every begin, stay and end of a contact
+		std::function<void(Collision)> callback;
+		//Should the collider only act as a trigger
+		//Make sure to set Transform::staleCache = true, when changing this
+		bool trigger = false;
+		//The layer of the collider (0-31), behavior is determined by the collision layer matrix
+		//Make sure to set Transform::staleCache = true, when changing this
+		int layer = 0;
+		//Override the rotation of the collider, (0-360)degrees. This is useful if attaching a 2D collider to a 3D model
+		//Make sure to set Transform::staleCache = true, when changing this
+		float rotationOverride = -1;
+		//Draw this collider
+		bool visualise = false;
+		//The axis-aligned bounding box of the collider. This is updated automatically and is set in world coordinates
+		std::array<float, 4> bounds;
+	};
+
+	//Circle Collider component, much cheaper to test than a polygon approximating a circle
+	//An entity should only have one collider component
+	ECS_REGISTER_COMPONENT(CircleCollider)
+	struct CircleCollider
+	{
+		//Center of the circle relative to the entity
+		//Make sure to set Transform::staleCache = true, when changing this
+		Vector2 center;
+		//Radius of the circle, scaled by the larger of the transform's x and y scale
+		//Make sure to set Transform::staleCache = true, when changing this
+		double radius = 1;
+		//Callback function on collision, called once per frame for every begin, stay and end of a contact
+		std::function<void(Collision)> callback;
+		//Should the collider only act as a trigger
+		//Make sure to set Transform::staleCache = true, when changing this
+		bool trigger = false;
+		//The layer of the collider (0-31), behavior is determined by the collision layer matrix
+		//Make sure to set Transform::staleCache = true, when changing this
+		int layer = 0;
+		//Draw this collider
+		bool visualise = false;
+		//The axis-aligned bounding box of the collider. This is updated automatically and is set in world coordinates
+		std::array<float, 4> bounds;
+	};
+
+	//Capsule Collider component, every point within radius of a line segment. Good for characters
+	//An entity should only have one collider component
+	ECS_REGISTER_COMPONENT(CapsuleCollider)
+	struct CapsuleCollider
+	{
+		//Ends of the segment running through the middle of the capsule, relative to the entity
+		//Make sure to set Transform::staleCache = true, when changing this
+		Vector2 start = Vector2(0, -1);
+		Vector2 end = Vector2(0, 1);
+		//Radius around the segment, scaled by the larger of the transform's x and y scale
+		//Make sure to set Transform::staleCache = true, when changing this
+		double radius = 1;
+		//Callback function on collision, called once per frame for every begin, stay and end of a contact
 		std::function<void(Collision)> callback;
 		//Should the collider only act as a trigger
+		//Make sure to set Transform::staleCache = true, when changing this
 		bool trigger = false;
-		//The layer of the collider, behavior is determined by the collision layer matrix
+		//The layer of the collider (0-31), behavior is determined by the collision layer matrix
+		//Make sure to set Transform::staleCache = true, when changing this
 		int layer = 0;
 		//Override the rotation of the collider, (0-360)degrees. This is useful if attaching a 2D collider to a 3D model
 		//Make sure to set Transform::staleCache = true, when changing this
@@ -54,42 +203,274 @@ namespace une
 		std::array<float, 4> bounds;
 	};
 
+	//Track the entities with circle and capsule colliders, the CollisionSystem tests them together with the polygon colliders
+	ECS_REGISTER_SYSTEM(CircleCollisionSystem, Transform, CircleCollider)
+	class CircleCollisionSystem : public ecs::System {};
+	ECS_REGISTER_SYSTEM(CapsuleCollisionSystem, Transform, CapsuleCollider)
+	class CapsuleCollisionSystem : public ecs::System {};
+
 	//Collision System, Requires Transform and PolygonCollider
 	ECS_REGISTER_SYSTEM(CollisionSystem, Transform, PolygonCollider)
 	class CollisionSystem : public ecs::System
 	{
 	public:
 		enum class LayerInteraction { all, none, collisions, triggers };
+		//Number of collision layers, layers are stored as bits
+		static constexpr int layerCount = 32;
+		enum class BroadphaseType { bruteForce, aabbTree, spatialHash, sweepAndPrune };
 
-		//Called every frame
+		//Called every frame, detects collisions and dispatches their events to the callbacks
 		void Update();
+		//Find the contacts of every collider which has moved since the last detection, and update the persistent contact pairs
+		//The physics system calls this after every step, events are only dispatched in Update
+		void DetectCollisions();
+		//Queue the colliders around tiles changed with Tilemap::SetTiles for the next DetectCollisions and wake up their bodies
+		//DetectCollisions calls this first, the physics system calls it before packing the bodies so the woken ones move that tick
+		void InvalidateEditedTiles();
+		//Get the entity contacts found by the last DetectCollisions, from the perspective of the smaller entity and sorted by entity
+		const std::vector<Collision>& GetContacts() const;
+		//Get the tilemap contacts found by the last DetectCollisions, sorted by entity
+		const std::vector<Collision>& GetTilemapContacts() const;
+		//Get the latest contact between two touching entities, including pairs which weren't tested again because neither moved. Returns null if they aren't touching
+		const Collision* GetContact(ecs::Entity a, ecs::Entity b) const;
+
+		//Destructor for the PolygonCollider component, removes the entity from the broadphase
+		static void OnColliderRemoved(ecs::Entity entity, PolygonCollider& collider);
+		//Destructors for the CircleCollider and CapsuleCollider components
+		static void OnCircleColliderRemoved(ecs::Entity entity, CircleCollider& collider);
+		static void OnCapsuleColliderRemoved(ecs::Entity entity, CapsuleCollider& collider);
+		//Does the entity have a polygon, circle or capsule collider
+		static bool HasCollider(ecs::Entity entity);
 
-		//Checks collision between entity a and every other entity and tilemap, Returns the collisions from the perspective of a, and calls every applicable callback function
+		//Checks collision between entity a and every other entity and tilemap, Returns the collisions from the perspective of a. Does not call callbacks
 		std::vector<Collision> CheckCollision(ecs::Entity a);
-		//Checks for collision between a tilemap collision layer and an entity. Does not call callbacks
+		//Checks for collision between the collision tiles of every tilemap and an entity, one collision per box of merged tiles or other tile. Does not call callbacks
+		//Only the tiles under the entity's bounds are tested, with the colliders from Tilemap::GetTileCollider
 		std::vector<Collision> CheckTilemapCollision(ecs::Entity entity);
 		//Check Entity-Entity collision. Does not call callbacks
 		Collision CheckEntityCollision(ecs::Entity a, ecs::Entity b);
 
-		//Check SAT intersection between two convex polygons, Expects Vertices to have Transforms applied
-		static Collision SATIntersect(std::vector<Vector2> aVerts, std::vector<Vector2> bVerts);
+		//Check SAT intersection between two convex polygons, Expects Vertices to have Transforms applied. Does not allocate for polygons of up to 32 vertices
+		static Collision SATIntersect(const std::vector<Vector2>& aVerts, const std::vector<Vector2>& bVerts);
+		//Check SAT intersection between two convex polygons with precalculated axes. Does not allocate
+		static Collision SATIntersect(const PolygonView& a, const PolygonView& b);
+		//Find when convex polygon a moving by velocity first touches convex polygon b, time is the fraction of velocity travelled (0-1)
+		//The normal is b's surface normal facing a. Returns false if they don't touch during the movement, and time 0 if they already overlap
+		static bool SweptSATIntersect(const PolygonView& a, const Vector2& velocity, const PolygonView& b, double& time, Vector2& normal);
+		//Check intersection between two capsules, a circle is a capsule whose start and end are the same point. Closed form, much cheaper than SAT
+		//The mtv and normal push a out of b, and the point is on b's surface
+		static Collision CapsuleIntersect(const Vector2& aStart, const Vector2& aEnd, double aRadius, const Vector2& bStart, const Vector2& bEnd, double bRadius);
+		//Check intersection between a capsule or circle and a convex polygon. The mtv and normal push the capsule out of the polygon
+		static Collision CapsulePolygonIntersect(const Vector2& start, const Vector2& end, double radius, const PolygonView& polygon);
 		//Checks if a and b bounds are intersecting
 		static bool AABBIntersect(ecs::Entity a, ecs::Entity b);
-		//Update the AABB of the polygon collider
-		static void UpdateAABB(ecs::Entity entity);
+		//Update the AABB and cached world space geometry of the polygon collider, and its place in the broadphase
+		//Returns true if the geometry changed, the collider will then be checked by the next DetectCollisions
+		static bool UpdateAABB(ecs::Entity entity);
+		//Get the world space vertices and axes of a collider, valid until the next UpdateAABB
+		//Circles only have their center as a vertex and capsules the ends of their segment, neither have axes
+		PolygonView GetWorldPolygon(ecs::Entity entity);
+		//Set the shape and filter of query to cast the collider of entity, on its layer and ignoring itself. The direction and distance are left alone
+		void GetColliderCast(ecs::Entity entity, ShapeCastQuery& query);
+
+		//Spatial queries test the colliders as of their last UpdateAABB, and every tilemap with a TilemapCollider
+		//Find the closest collider or tile a ray hits, returns false if it hits nothing
+		bool Raycast(const Ray& ray, QueryHit& hit);
+		//Find every collider and tile a ray hits, sorted by distance
+		void RaycastAll(const Ray& ray, std::vector<QueryHit>& hits);
+		//Find the first collider or tile a polygon, circle or capsule hits when moved, returns false if it hits nothing. Colliders it starts inside are hit at distance 0
+		bool ShapeCast(const ShapeCastQuery& query, QueryHit& hit);
+		//Find every collider and tile a polygon, circle or capsule hits when moved, sorted by distance
+		void ShapeCastAll(const ShapeCastQuery& query, std::vector<QueryHit>& hits);
+		//Find every collider and tile overlapping a box
+		void OverlapBox(const BoxQuery& query, std::vector<QueryHit>& hits);
+
+		//Batched queries, hits[i] is the result of query i. The broadphase is searched on the calling thread, the exact tests can run on the thread pool
+		//The results are the same whether or not the tests run in parallel
+		void RaycastBatch(const std::vector<Ray>& rays, std::vector<QueryHit>& hits, bool parallel = true);
+		void ShapeCastBatch(const std::vector<ShapeCastQuery>& queries, std::vector<QueryHit>& hits, bool parallel = true);
+		//The hits of query i are hits[offsets[i]] up to hits[offsets[i + 1]]
+		void RaycastAllBatch(const std::vector<Ray>& rays, std::vector<QueryHit>& hits, std::vector<uint32_t>& offsets, bool parallel = true);
+		void OverlapBoxBatch(const std::vector<BoxQuery>& queries, std::vector<QueryHit>& hits, std::vector<uint32_t>& offsets, bool parallel = true);
+
+		//Change the broadphase used to find potential collisions, every collider is moved to the new broadphase
+		void SetBroadphase(BroadphaseType type);
+		//Get the type of the broadphase currently in use
+		BroadphaseType GetBroadphaseType() const;
+		//Get the broadphase currently in use, useful for tweaking its settings
+		Broadphase& GetBroadphase();
 
 		//Set the collision layer of a tile id
-		inline void SetTileCollisionLayer(unsigned int tileID, int layer);
+		void SetTileCollisionLayer(unsigned int tileID, int layer);
 		//Get the collision layer of a tile id, defaults to 0
-		inline int GetTileCollisionLayer(unsigned int tileID);
+		int GetTileCollisionLayer(unsigned int tileID) const;
+		//Set whether a tile id only acts as a trigger
+		void SetTileTrigger(unsigned int tileID, bool trigger);
+		//Does a tile id only act as a trigger, defaults to false
+		bool IsTileTrigger(unsigned int tileID) const;
 		//Sets the interaction state between two layers
-		inline void SetLayerInteraction(int layer1, int layer2, LayerInteraction interaction);
+		void SetLayerInteraction(int layer1, int layer2, LayerInteraction interaction);
 		//Get the interaction type between two collision layers
-		inline LayerInteraction GetLayerInteraction(int layer1, int layer2);
+		LayerInteraction GetLayerInteraction(int layer1, int layer2) const;
 
 	private:
-		std::unordered_map<int, std::unordered_map<int, LayerInteraction>> layerCollisionMatrix;
-		std::unordered_map<unsigned int, int> tileIDTolayer;
-		std::unordered_map<unsigned int, bool> tileIDToTrigger;
+		//Spatial structure for finding potential collisions
+		std::unique_ptr<Broadphase> broadphase = std::make_unique<AABBTree>();
+		BroadphaseType broadphaseType = BroadphaseType::aabbTree;
+		//Reused between queries to avoid allocations
+		std::vector<ecs::Entity> candidates;
+
+		enum class Shape : uint8_t { polygon, circle, capsule };
+		//World space geometry of a collider, refreshed by UpdateAABB whenever its transform changes
+		struct ColliderGeometry
+		{
+			//Circles store their center as their only vertex and capsules the ends of their segment, without any axes
+			Shape shape = Shape::polygon;
+			double radius = 0;
+			//Has the geometry changed since the last DetectCollisions
+			bool moved = false;
+			//Where the vertices and axes start in geometryVertices and geometryAxes, and how many fit there
+			uint32_t offset = 0;
+			uint32_t capacity = 0;
+			uint32_t vertexCount = 0;
+			uint32_t axisCount = 0;
+			//Layer and trigger flag of the collider when the geometry was cached
+			int layer = 0;
+			bool trigger = false;
+			//Global position of the entity, orients the mtv
+			Vector3 position;
+			Bounds bounds;
+		};
+		//Get the cached geometry of a collider, caching it first if it hasn't been yet
+		const ColliderGeometry& GetGeometry(ecs::Entity entity);
+		//Remove a collider of any type from the broadphase and geometry cache
+		static void RemoveCollider(ecs::Entity entity);
+		//Call visit on every entity with a polygon, circle or capsule collider
+		template<typename Visit>
+		void ForEachCollider(Visit visit);
+		//Intersect the cached geometry of two colliders of any shape, the mtv pushes a out of b
+		Collision IntersectGeometry(const ColliderGeometry& a, const ColliderGeometry& b) const;
+		//Append the collisions between a collider and the tiles of the gathered tilemaps, one per box of merged tiles or other tile from the perspective of the collider
+		void CollideTiles(ecs::Entity entity, const ColliderGeometry& cache, std::vector<Collision>& collisions) const;
+		//Check collision between the cached geometry of two colliders. Only reads the cache, so pairs can be checked from several threads at once
+		Collision CollideGeometry(ecs::Entity a, ecs::Entity b, const ColliderGeometry& aGeometry, const ColliderGeometry& bGeometry) const;
+		//Make a polygon view of cached geometry
+		PolygonView ToPolygon(const ColliderGeometry& cache) const;
+		//Move every collider's geometry to the start of the buffers, removing the gaps left by removed or grown colliders
+		void CompactGeometry();
+
+		std::unordered_map<ecs::Entity, ColliderGeometry> geometry;
+		//Every collider's world space vertices and axes, stored back to back
+		std::vector<Vector2> geometryVertices;
+		std::vector<Vector2> geometryAxes;
+		//Slots in the buffers no collider is using
+		size_t unusedGeometry = 0;
+		//Transformed vertices are compared to the cached ones here before being stored
+		std::vector<Vector2> geometryScratch;
+		//Local points of circles and capsules before they are transformed
+		std::vector<Vector2> shapeScratch;
+
+		//Two colliders, or a collider and a tile, which have touched. Kept until their end event has been dispatched
+		struct ContactPair
+		{
+			//The latest contact, from the perspective of the smaller entity
+			Collision collision;
+			//Did the latest detection find them touching
+			bool touching = false;
+			//Has the begin event been dispatched
+			bool reported = false;
+		};
+		//Append the begin, stay and end events of the pairs to events, and forget the pairs which have ended
+		template<typename Pairs>
+		void GenerateEvents(Pairs& pairs);
+		//A collider touching a tile or box of merged tiles of a tilemap entity
+		struct TilePairKey
+		{
+			ecs::Entity entity;
+			ecs::Entity tilemap;
+			uint32_t layer;
+			uint32_t tile;
+			bool operator==(const TilePairKey& other) const = default;
+		};
+		struct TilePairKeyHash
+		{
+			size_t operator()(const TilePairKey& key) const;
+		};
+
+		//A tilemap spatial queries test, and the transforms between its local space and world space
+		struct QueryTilemap
+		{
+			ecs::Entity entity;
+			const Tilemap* tilemap;
+			glm::mat4 localToWorld;
+			glm::mat4 worldToLocal;
+		};
+		//A query's mask for the broadphase and the layer it uses in the layer matrix
+		struct ResolvedFilter
+		{
+			int layer;
+			uint32_t broadphaseMask;
+			bool triggers;
+			ecs::Entity ignore;
+		};
+		ResolvedFilter ResolveFilter(const QueryFilter& filter) const;
+		//Can a query hit a collider or tile on layer
+		bool FilterAccepts(const ResolvedFilter& filter, int layer, bool trigger) const;
+		//Collect the tilemaps for the next queries and tile collision checks
+		void GatherQueryTilemaps();
+		//Append the colliders inside bounds which the filter accepts to queryCandidates
+		void GatherQueryCandidates(const Bounds& bounds, const ResolvedFilter& filter);
+		//The exact tests of each query against candidates and the gathered tilemaps. They only read, so they can run on several threads at once
+		//Hits are appended to hits, only the closest one if closestOnly is set
+		void RayTest(const Ray& ray, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, bool closestOnly, std::vector<QueryHit>& hits) const;
+		void ShapeCastTest(const ShapeCastQuery& query, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, bool closestOnly, std::vector<QueryHit>& hits) const;
+		void OverlapBoxTest(const BoxQuery& query, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, std::vector<QueryHit>& hits) const;
+		//Run a test over a batch of queries, collecting the hits in query order
+		template<typename Query, typename Test>
+		void RunQueryBatch(const std::vector<Query>& queries, std::vector<QueryHit>& hits, std::vector<uint32_t>& offsets, bool parallel, Test test);
+
+		std::vector<QueryTilemap> queryTilemaps;
+		std::vector<ecs::Entity> queryCandidates;
+		//Where the candidates of each query in a batch start in queryCandidates
+		std::vector<uint32_t> queryCandidateOffsets;
+		std::vector<ResolvedFilter> queryFilters;
+		//Hits found by each thread in a batch, tagged with their query
+		std::vector<std::vector<std::pair<uint32_t, QueryHit>>> threadQueryHits;
+		//Results of the batches which only keep one hit per query, before misses are filled in
+		std::vector<QueryHit> batchHits;
+		std::vector<uint32_t> batchOffsets;
+		//How many queries a thread takes at a time
+		static constexpr size_t queryChunkSize = 16;
+
+		//Colliders which have moved or been removed since the last DetectCollisions
+		std::vector<ecs::Entity> movedColliders;
+		std::vector<ecs::Entity> removedColliders;
+		//Broadphase pairs of the current detection, smaller entity first
+		std::vector<EntityPair> broadphasePairs;
+		std::vector<Collision> contacts;
+		std::vector<Collision> tilemapContacts;
+		//Contacts found by each thread of the thread pool, merged into contacts
+		std::vector<std::vector<Collision>> threadContacts;
+		//How many broadphase pairs a thread takes at a time
+		static constexpr size_t narrowphaseChunkSize = 64;
+		//Entity pairs keyed by both entities, and tile pairs keyed by the entity and the tile or box it touches
+		std::unordered_map<uint64_t, ContactPair> contactPairs;
+		std::unordered_map<TilePairKey, ContactPair, TilePairKeyHash> tileContactPairs;
+		//Events waiting to be dispatched, from the perspective of the smaller entity
+		std::vector<Collision> events;
+
+		//Bit j of collisionMasks[i] is set if layers i and j report collisions, triggerMasks the same for triggers
+		//Every layer interacts with every other layer by default
+		std::array<uint32_t, layerCount> collisionMasks = FilledLayerMasks();
+		std::array<uint32_t, layerCount> triggerMasks = FilledLayerMasks();
+		static constexpr std::array<uint32_t, layerCount> FilledLayerMasks()
+		{
+			std::array<uint32_t, layerCount> masks;
+			masks.fill(allLayers);
+			return masks;
+		}
+		//Layer and trigger flag of each tile, indexed by tile GID. Tiles past the end are on layer 0 and not triggers
+		std::vector<uint8_t> tileIDToLayer;
+		std::vector<uint8_t> tileIDToTrigger;
 	};
 }
\ No newline at end of file
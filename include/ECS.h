@@ -346,6 +346,8 @@ namespace ecs
 		std::unordered_map<uint32_t, Entity> indexToEntity;
 		//Callback funtion to be used as a component destructor
 		std::function<void(Entity, T&)> componentDestructor;
+		//Incremented whenever a component is added or removed
+		uint64_t version = 0;
 
 	public:
 		void SetDestructor(std::function<void(Entity, T&)> destructor)
@@ -359,6 +361,12 @@ namespace ecs
 			return entityToIndex.contains(entity);
 		}
 
+		//Get the number of times components have been added or removed
+		uint64_t GetVersion() const
+		{
+			return version;
+		}
+
 		//Get a component from an entity
 		T& GetComponent(Entity entity)
 		{
@@ -371,6 +379,7 @@ namespace ecs
 			entityToIndex[entity] = components.size();
 			indexToEntity[components.size()] = entity;
 			components.push_back(component);
+			version++;
 		}
 
 		//Removes a component from an entity
@@ -395,6 +404,7 @@ namespace ecs
 			entityToIndex.erase(entity);
 			indexToEntity.erase(components.size() - 1);
 			components.pop_back();
+			version++;
 		}
 	};
 
@@ -658,6 +668,14 @@ namespace ecs
 		return GetComponentArray<T>()->HasComponent(entity);
 	}
 
+	//Get a number which changes whenever a component of type T is added or removed
+	//References to components of type T stay valid for as long as it doesn't change
+	template<typename T>
+	uint64_t GetComponentVersion()
+	{
+		return GetComponentArray<T>()->GetVersion();
+	}
+
 	//Get a reference to entity's component of type T
 	template<typename T>
 	T& GetComponent(Entity entity)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <vector>
 
 #include "ECS.h"
@@ -25,6 +26,52 @@ namespace une
 		float restitution = 1;
 		//If true, this will not be effected by outside forces calculations
 		bool kinematic = false;
+		//Sweep the movement each step so fast bodies stop at colliders instead of passing through them
+		bool ccd = false;
+		//Draw the body between its last two ticks so it moves smoothly at any frame rate. Turn this off for bodies which are moved every frame by hand
+		bool interpolate = true;
+		//Can the body fall asleep once it and everything touching it stop moving
+		bool canSleep = true;
+
+		//Position and rotation at the start of the latest tick, set by the physics system
+		Vector3 previousPosition;
+		Vector3 previousRotation;
+		//Has the body been through a tick, bodies added since the latest tick are drawn where they are
+		bool ticked = false;
+		//Sleeping bodies aren't moved or tested for collisions until something wakes them up, set by the physics system
+		bool sleeping = false;
+		//How many ticks in a row the body has been slower than PhysicsSystem::sleepVelocity
+		uint32_t stillTicks = 0;
+		//Index of the body in the islands being solved and in the bodies packed for the current tick, set by the physics system
+		uint32_t solverBody = 0;
+		uint32_t packedBody = 0;
+	};
+
+	//A point where the colliders of a ContactManifold touch
+	struct ManifoldPoint
+	{
+		//Position in world coordinates
+		Vector2 position;
+		//How far the colliders overlap at this point
+		double depth = 0;
+		//Impulse pushing the bodies apart at this point, summed over the solver iterations and carried over to the next step
+		double normalImpulse = 0;
+		//Which edges the point came from, points with the same id in consecutive steps are the same point
+		uint32_t id = 0;
+	};
+
+	//The contact between two rigidbodies, kept for as long as they touch. From the perspective of the smaller entity
+	struct ContactManifold
+	{
+		ecs::Entity a;
+		ecs::Entity b;
+		//Normalized direction which pushes a out of b
+		Vector2 normal;
+		//Polygons touching along an edge have two points, everything else has one
+		std::array<ManifoldPoint, 2> points;
+		uint8_t pointCount = 0;
+		//Velocity along the normal the solver aims for, non-zero when the bodies hit fast enough to bounce
+		double bounceVelocity = 0;
 	};
 
 	//Physics System, Requires Rigidbody and Transform components
@@ -32,17 +79,34 @@ namespace une
 	class PhysicsSystem : public ecs::System
 	{
 	public:
-		//Update the physics system, call this every frame
+		//Update the physics system, call this every frame. Runs as many ticks as the time since the last frame needs
 		void Update();
+		//Simulate tickTime seconds, Update calls this with 1 / tickRate
+		void Tick(double tickTime);
+		//How far the frame is between the latest tick and the next one (0-1), the rendered transforms are interpolated by this
+		double GetInterpolationAlpha() const;
+
+		//Destructor for the Rigidbody component, stops interpolating the transform and drops the manifolds of the body before the next tick
+		static void OnRigidbodyRemoved(ecs::Entity entity, Rigidbody& rigidbody);
 
 		//COLLISION RESOLUTION:
 
 		//Temporary (permanent) function to solve a collision. Does not affect rotation, Returns 0 on success, >0 on trigger, and <0 on failure
 		static int SimpleSolveCollision(const Collision& collision);
 
+		//Detect the collisions of everything that has moved and solve them
+		static void SolveCollisions();
+
 		//Solve a collision between an entity and a tilemap, Returns 0 on success, >0 on trigger, and <0 on failure
 		static int SolveTilemapCollision(std::vector<Collision> collisions);
 
+		//Get the contacts solved in the latest step, sorted by entity
+		const std::vector<ContactManifold>& GetManifolds() const;
+		//Get a hash of the positions, rotations and velocities of every body and of the manifolds carried over to the next tick, in entity order
+		//Two simulations which hash the same after a tick continue the same way, as long as they get the same inputs and no collider was moved outside of the physics
+		//The contacts CollisionSystem keeps for pairs it hasn't tested again and its collision events aren't hashed
+		uint64_t GetStateHash();
+
 		//UTILITY:
 
 		//Move an entity while checking for collision, assuming entity has collider
@@ -54,8 +118,127 @@ namespace une
 		//Add force to entity
 		static inline void AddForce(ecs::Entity entity, Vector3 velocity);
 
-		//How many steps should be used for movements, bigger is more accurate but slower
+		//Wake up a sleeping body, the bodies touching it wake up at the end of the tick
+		static void WakeUp(ecs::Entity entity);
+
+		//Physics ticks per second. Every tick simulates the same amount of time, so the simulation doesn't depend on the frame rate
+		double tickRate = 60;
+		//Most ticks run in a single frame, the simulation slows down instead when frames take longer than this many ticks
+		int maxTicksPerFrame = 8;
+		//Update doesn't run any ticks and Tick is called by hand instead, for lockstep networking and replays. Bodies are drawn where they were last ticked
+		bool manualTicks = false;
+		//How many steps each tick is split into, bigger is more accurate but slower. Use Rigidbody::ccd for fast bodies instead of raising this
 		int step = 1;
 		Vector3 gravity;
+
+		//How many times the contacts are solved each step. The impulses carry over between steps, so stacks settle over a few steps even with few iterations
+		int velocityIterations = 8;
+		//How much of the overlap is removed each step (0-1), and how much overlap is left alone. Both keep resting bodies from jittering
+		float positionCorrection = 0.8f;
+		float allowedPenetration = 0.01f;
+		//Bodies hitting each other slower than this don't bounce and come to rest instead
+		float restitutionThreshold = 1;
+
+		//Bodies slower than this are still. Touching bodies which have all been still for ticksToSleep ticks fall asleep together
+		float sleepVelocity = 2;
+		uint32_t ticksToSleep = 30;
+
+	private:
+		//Time which hasn't been simulated yet, less than a tick after Update
+		double accumulator = 0;
+		//Bodies removed since the last tick, their manifolds are dropped before the solver reads them
+		std::vector<ecs::Entity> removedBodies;
+
+		//Rebuild the manifolds from the latest contacts, keeping the impulses of the points which persist
+		void UpdateManifolds(CollisionSystem& collisionSystem);
+		//Add the manifold of a contact between two rigidbodies, previous is the manifold of the same pair from the last step or null
+		void AddManifold(CollisionSystem& collisionSystem, const Collision& contact, const ContactManifold* previous);
+		//Look up the components of every body again if they may have moved in memory
+		void UpdatePackedPointers();
+		//Pack the state of every body into arrays. Sleeping bodies which were moved by hand wake up
+		void PackBodies();
+		//Apply gravity and drag to the packed velocities
+		void IntegrateForces(double stepTime);
+		//Move the bodies which have velocity, ccd bodies are swept. Only the bodies which move are tested for collisions
+		void IntegratePositions(double stepTime);
+		//Shorten the movement of a ccd entity to where it first hits a rigidbody or tile, and bounce it off what it hit
+		Vector3 SweepMovement(ecs::Entity entity, Vector3 movement);
+		//Copy the velocities and positions of the rigidbodies and transforms to the packed arrays
+		void LoadBodies();
+		//Copy the velocities of the bodies forces move back to the rigidbodies
+		void StoreVelocities();
+		//Detect the collisions of everything that has moved, push overlapping bodies apart and solve the tilemap collisions
+		void ResolveContacts(bool solveVelocities);
+		//Apply the impulses of the last step and solve the velocities of the bodies in the manifolds
+		void SolveVelocities();
+		//Push the bodies of the manifolds apart by part of their overlap, split by their masses
+		void CorrectPositions();
+		//Gather the bodies of the manifolds and group the manifolds into islands which share no moving body, batching the small islands together
+		void BuildSolverIslands();
+		//Solve the velocities or correct the positions of the manifolds in solverOrder[begin, end)
+		void SolveIslandVelocities(size_t begin, size_t end);
+		void CorrectIslandPositions(size_t begin, size_t end);
+		//Group the bodies into islands which touch each other and put the islands which have been still long enough to sleep
+		void UpdateSleep();
+		//Find the island of a body in a union-find, halving the path on the way
+		static uint32_t FindIsland(std::vector<uint32_t>& parents, uint32_t body);
+
+		//Sorted by entity, previousManifolds holds the last step's manifolds while they are rebuilt
+		std::vector<ContactManifold> manifolds;
+		std::vector<ContactManifold> previousManifolds;
+		//The rigidbodies of each manifold, gathered once per step
+		struct ManifoldBodies
+		{
+			Rigidbody* a;
+			Rigidbody* b;
+			Transform* transformA;
+			Transform* transformB;
+			double inverseMassA;
+			double inverseMassB;
+		};
+		std::vector<ManifoldBodies> manifoldBodies;
+
+		//Islands are solved on the thread pool, islands with fewer manifolds than this are batched together onto one thread
+		static constexpr size_t islandBatchSize = 64;
+		//Union-find over the moving bodies of the manifolds, indexed by Rigidbody::solverBody
+		std::vector<uint32_t> solverParents;
+		//Manifold indices grouped by island, in manifold order within each island
+		std::vector<uint32_t> solverOrder;
+		std::vector<uint32_t> solverIslandSizes;
+		//Start of each batch in solverOrder, followed by the end of the last batch
+		std::vector<uint32_t> solverBatches;
+
+		//Every body as a structure of arrays, indexed by Rigidbody::packedBody. The components are only looked up again when their versions change
+		uint64_t packedRigidbodyVersion = UINT64_MAX;
+		uint64_t packedTransformVersion = UINT64_MAX;
+		uint64_t packedColliderVersion = UINT64_MAX;
+		std::vector<ecs::Entity> packedEntities;
+		std::vector<Rigidbody*> packedRigidbodies;
+		std::vector<Transform*> packedTransforms;
+		//Bodies with a collider of any type, looked up together with the pointers
+		std::vector<uint8_t> packedCollider;
+		//Velocities of the current tick, copied to the rigidbodies for the solver
+		std::vector<float> packedVelocityX;
+		std::vector<float> packedVelocityY;
+		std::vector<float> packedVelocityZ;
+		//Positions of the current step, moved all at once and then copied to the transforms of the bodies which have velocity
+		std::vector<double> packedPositionX;
+		std::vector<double> packedPositionY;
+		std::vector<double> packedPositionZ;
+		//Mass times gravity scale and drag, both are 0 on kinematic and sleeping bodies so forces leave them alone
+		std::vector<float> packedGravityFactor;
+		std::vector<float> packedDrag;
+		//Bodies which forces and the solver move, and the ones of them which are swept when they move
+		std::vector<uint8_t> packedDynamic;
+		std::vector<uint8_t> packedSweep;
+		//The query and hits of the latest sweep, kept to reuse their memory
+		ShapeCastQuery sweepQuery;
+		std::vector<QueryHit> sweepHits;
+
+		//Union-find over the packed bodies, rebuilt every tick. Each body points towards the root of its island
+		std::vector<uint32_t> islandParents;
+		//Still ticks of each packed body, and the fewest still ticks of any body in each island indexed by the root
+		std::vector<uint32_t> bodyStillTicks;
+		std::vector<uint32_t> islandStillTicks;
 	};
 }
\ No newline at end of file
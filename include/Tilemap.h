@@ -1,5 +1,7 @@
 #pragma once
 
+#include <span>
+
 #include "ECS.h"
 #include "tmxlite/Map.hpp"
 
@@ -7,69 +9,166 @@
 #include "glad/gl.h"
 #endif
 
+#include "glm/glm.hpp"
+
 #include "Vector.h"
 #include "renderer/gl/Texture.h"
 
 namespace une
 {
-	//A single layer in the tilemap
+	//The GIDs of a tileset and how its image is laid out, lookup textures index tiles relative to their tileset
+	struct TilesetRange
+	{
+		uint32_t firstGID = 0;
+		uint32_t lastGID = 0;
+		unsigned int columns = 0;
+		unsigned int rows = 0;
+		Texture* texture = nullptr;
+	};
+
+	//A single layer in the tilemap, drawn in square chunks of tiles which are only loaded near the cameras
 	class MapLayer
 	{
 	public:
-		MapLayer(const tmx::Map* map, uint32_t i, const std::vector<Texture*>& textures, std::unordered_map<std::string, tmx::Property> layerProperties);
+		MapLayer(const tmx::Map* map, uint32_t i, const std::vector<TilesetRange>& tilesets, std::unordered_map<std::string, tmx::Property> layerProperties, uint32_t chunkSize);
+		//Empty layer of a size, filled in by the caller such as when loading a cooked map
+		MapLayer(uint32_t i, const std::vector<TilesetRange>& tilesets, uint32_t width, uint32_t height, uint32_t chunkSize);
 		~MapLayer();
 		MapLayer(const MapLayer&) = delete;
 		MapLayer& operator = (const MapLayer&) = delete;
 
-		//Draw a quad for each subset in this layer
-		void DrawSubsets(int tilesetSizeLoc);
+		//Lookup texture data of a chunk for each tileset it uses
+		struct ChunkData
+		{
+			uint32_t chunk = 0;
+			std::vector<uint32_t> tilesets;
+			std::vector<std::vector<uint16_t>> lookups;
+		};
+		//Fill the lookup data of a chunk. Only reads the layer, so chunks can be built on several threads at once
+		void BuildChunk(uint32_t chunk, ChunkData& data) const;
+		//Create the lookup textures of a chunk from built data, returns the bytes of lookup textures added
+		size_t UploadChunk(const ChunkData& data);
+		//Delete the lookup textures of a chunk, returns the bytes freed
+		size_t UnloadChunk(uint32_t chunk);
+		//Change a tile, the loaded chunks are updated by UpdateDirtyChunks. Doesn't update the collider boxes
+		void SetTile(uint32_t x, uint32_t y, uint32_t gid, uint8_t flip);
+		//Upload the tiles changed since the last call to the lookup textures of the loaded chunks, only the changed rectangle of each chunk
+		//Chunks which need a lookup texture for a tileset they didn't use are built again. Returns the bytes of lookup textures added minus the bytes freed
+		int64_t UpdateDirtyChunks(const std::vector<bool>& loadedChunks);
+		//Draw a quad for each subset of the loaded chunks from start up to but not including end, in chunk coordinates
+		//model is the layer's model matrix, each chunk's quad is placed inside it
+		void DrawChunks(Vector2Int start, Vector2Int end, const glm::mat4& model, Vector2Int tileSize, int modelLoc, int tilesetSizeLoc) const;
 
 		uint32_t index;
 		bool enabled = true;
 		bool hasCollision = false;
 		//User specified z offset
 		float zOffset = 0;
-		//Tile based collision map
-		std::vector<std::vector<uint32_t>> collider;
+		//Tile GIDs in row-major order, 0 is no tile
+		std::vector<uint32_t> tiles;
+		//Tiled flip flags of the tiles in the same order
+		std::vector<uint8_t> flipFlags;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		//Tiles along each side of a chunk, and the amount of chunks covering the layer
+		uint32_t chunkSize = 64;
+		uint32_t chunkColumns = 0;
+		uint32_t chunkRows = 0;
+
+		//Get the tile GID at tile coordinates, 0 if there is no tile or the coordinates are outside the layer
+		uint32_t GetTileGID(int64_t x, int64_t y) const
+		{
+			if (x < 0 || y < 0 || x >= width || y >= height || tiles.empty())
+				return 0;
+			return tiles[y * width + x];
+		}
+		//Get the collision tile GID at tile coordinates, 0 if there is no tile, the coordinates are outside the layer or it has no collision
+		uint32_t GetColliderGID(int64_t x, int64_t y) const
+		{
+			return hasCollision ? GetTileGID(x, y) : 0;
+		}
+
+		//Rectangle of collision tiles with the same GID, in tile coordinates
+		struct ColliderBox
+		{
+			uint32_t x = 0;
+			uint32_t y = 0;
+			uint32_t width = 1;
+			uint32_t height = 1;
+			uint32_t gid = 0;
+		};
+		//Full tile colliders merged into as few boxes as possible, so walls and floors collide as one shape without seams between tiles
+		std::vector<ColliderBox> colliderBoxes;
+		//One plus the index of the box covering each tile in row-major order, 0 for empty tiles and tiles with their own collider shape
+		std::vector<uint32_t> tileBoxes;
 		std::unordered_map<std::string, tmx::Property> properties;
 
+		//Where a chunk's lookup data starts in bakedLookups, and which tilesets in bakedTilesets it has lookups for
+		struct BakedChunk
+		{
+			uint64_t lookupOffset = 0;
+			uint32_t firstTileset = 0;
+			uint32_t tilesetCount = 0;
+		};
+		//Lookup data of every chunk baked into a cooked map, copied instead of building chunks from the tiles. Empty for maps loaded from tmx
+		std::vector<BakedChunk> bakedChunks;
+		std::vector<uint32_t> bakedTilesets;
+		std::vector<uint16_t> bakedLookups;
+
 	private:
 		struct Subset
 		{
+			uint32_t tileset = 0;
 			unsigned int columns = 0;
 			unsigned int rows = 0;
 			Texture* texture = nullptr;
 			Texture* lookup = nullptr;
 		};
+		//Size of a chunk in tiles, the chunks on the right and bottom edges may be smaller
+		Vector2Int ChunkSize(uint32_t chunk) const;
 
-		//Create a subset for each tilseset this layer uses
-		void CreateSubsets(const tmx::Map* map);
-
-		std::vector<Texture*> tilesetTextures;
-		std::vector<Subset> subsets;
+		//The tilemap's tilesets, which outlive the layer
+		const std::vector<TilesetRange>* tilesets = nullptr;
+		//Subsets of each chunk in row-major order, empty while the chunk isn't loaded
+		std::vector<std::vector<Subset>> chunks;
+		//Tiles changed in each chunk since the last UpdateDirtyChunks, from start up to but not including end in the chunk's tiles
+		struct DirtyRect
+		{
+			Vector2Int start;
+			Vector2Int end;
+		};
+		std::vector<DirtyRect> dirtyRects;
+		std::vector<uint32_t> dirtyChunks;
 	};
 
 	//A class to load a tiled tilemap using the tmxlite library
 	class Tilemap : public resources::Resource
 	{
 	public:
+		//A view of a tile's data, cheap to make and copy. Only valid until the tilemap is loaded again
 		struct TileInfo
 		{
 			//The unique gid of this tile
 			uint32_t gid = 0;
 			//The tileset ID of this tile
 			uint32_t id = 0;
-			//The name of the parent tileset
-			std::string tilesetName;
+			//Index of the parent tileset, see GetTilesetName
+			uint32_t tileset = 0;
 			//The collider vertices of this tile
-			std::vector<Vector2> collider;
+			std::span<const Vector2> collider;
 		};
 
 		Tilemap() = default;
 		~Tilemap() override;
 
-		//Load pixel data from disk with stbimage
+		//Load a tmx map, or its cooked .unmap file instead if that is newer. Also loads the pixel data of the tilesets
 		bool Load(const std::string& path, GLuint filteringType = GL_NEAREST);
+		//Write the loaded map to a cooked .unmap file, which loads with a single read and no processing of the tiles
+		bool SaveCooked(const std::string& path) const;
+		//Load a tmx map and write it to a cooked .unmap file next to it, for example as a build step
+		static bool Cook(const std::string& tmxPath);
+		//Make an empty map without tilesets, filled in with SetTile or SetTiles. Every tile has the full tile collider
+		void Create(Vector2Int tileSize, uint32_t width, uint32_t height, uint32_t layerCount);
 		//Make OpenGl Texture using loaded pixel data
 		bool SetupGLResources() override;
 
@@ -81,17 +180,120 @@ namespace une
 		Vector3 GetTilePosition(ecs::Entity entity, Vector2Int pos) const;
 		//Returns the TileInfo of every tile with a collider at tilemap coords
 		std::vector<TileInfo> GetCollisionTilesAtLocation(Vector2Int pos) const;
+		//Same as above but reuses the memory of hits, which is cleared first
+		void GetCollisionTilesAtLocation(Vector2Int pos, std::vector<TileInfo>& hits) const;
+		//Returns the TileInfo of a gid, tiles not in any tileset have the full tile collider
+		TileInfo GetTileInfo(uint32_t gid) const;
+		//Name of a tileset by its index in TileInfo
+		const std::string& GetTilesetName(uint32_t tileset) const;
 		//Returns the vertices making up this tile's collider
-		std::vector<Vector2> GetTileCollider(uint32_t gid) const;
+		std::span<const Vector2> GetTileCollider(uint32_t gid) const;
+		//Does this tile have its own collider shape instead of covering the whole tile
+		bool HasCustomCollider(uint32_t gid) const;
+		//A tile to change with SetTiles
+		struct TileEdit
+		{
+			Vector2Int pos;
+			uint32_t gid = 0;
+			uint8_t flipFlags = 0;
+		};
+		//Change a tile of a layer at tilemap coords, gid 0 removes the tile
+		//The collision is updated right away, and the drawn chunks at the next UpdateStreaming
+		void SetTile(uint32_t layer, Vector2Int pos, uint32_t gid, uint8_t flipFlags = 0);
+		//Change many tiles of a layer at once, the collider boxes around the edits in each chunk are merged only once. Tiles outside the layer are skipped
+		void SetTiles(uint32_t layer, std::span<const TileEdit> edits);
+		//Tiles from start up to but not including end, in tilemap coords
+		struct TileRect
+		{
+			Vector2Int start;
+			Vector2Int end;
+		};
+		//Move the rectangles of collision tiles changed since the last call to the end of rects
+		//The CollisionSystem takes them to test the colliders around them again and wake their bodies
+		void TakeEditedRects(std::vector<TileRect>& rects);
+		//Merge the full tile colliders of a layer into boxes again in the tiles from start up to but not including end
+		//Boxes reaching into the region are merged again with it. Call after changing the tiles of a collision layer
+		void MergeColliderBoxes(MapLayer& layer, Vector2Int start, Vector2Int end) const;
+
+		//Keep the chunks from start up to but not including end loaded, in chunk coordinates
+		//Called for every camera looking at the tilemap before UpdateStreaming
+		void RequestChunks(Vector2Int start, Vector2Int end);
+		//Upload the changed tiles and load the requested chunks on the thread pool, unloading the chunks requested longest ago to stay within the streaming budget
+		//Called once per frame on the main thread, because the lookup textures are uploaded here
+		void UpdateStreaming();
+		//Bytes of chunk lookup textures currently loaded
+		size_t GetStreamedBytes() const;
 
 		Vector2Int tileSize;
 		std::vector<MapLayer*> mapLayers;
+		//Tiles along each side of the chunks the layers are drawn in, set before Load
+		uint32_t chunkSize = 64;
+		//Most bytes of chunk lookup textures loaded at once. Chunks which haven't been requested for the longest are unloaded to make room
+		//and requested chunks which still don't fit aren't loaded
+		size_t streamingBudget = 64 * 1024 * 1024;
+		//Most chunks from the middle of a camera's view to the edge of the area it requests and draws, along each axis
+		uint32_t streamingRadius = 16;
+		//Most chunks loaded in one frame, so moving into a new area spreads the work over a few frames
+		uint32_t chunkLoadsPerFrame = 32;
+		//Tiled's coordinates of tile (0, 0), infinite maps start from their top left chunk
+		Vector2Int tileOffset;
 
-		unsigned int VAO, VBO;
+		unsigned int VAO = 0, VBO = 0;
 	private:
-		std::vector<tmx::Tileset> tilesets;
-		std::unordered_map<uint32_t, std::vector<Vector2>> tileColliders;
+		std::vector<uint32_t> requestedChunks;
+		//Is each chunk loaded in every layer, and the frame it was last requested
+		std::vector<bool> chunkLoaded;
+		std::vector<uint64_t> chunkLastRequested;
+		uint64_t streamingFrame = 0;
+		size_t streamedBytes = 0;
+		//Changed collision tiles waiting for TakeEditedRects
+		std::vector<TileRect> editedRects;
+
+		//Parse a tmx map with tmxlite and build the layers from it, without loading the tileset images
+		bool LoadTMX(const std::string& path);
+		//Read a cooked .unmap file into the layers. With rejectStale it fails when a source file has changed since the map was cooked
+		bool LoadCooked(const std::string& path, bool rejectStale);
+		//Load the pixel data of the tilesets
+		void LoadTilesetTextures(GLuint filteringType);
+		//Delete the layers and tileset textures
+		void Clear();
+		//Set the default collider of a tile from the tile size, before any tile's own collider
+		void SetDefaultCollider();
+		//Mark every chunk of the layers as not loaded
+		void ResetStreaming();
+
+		enum TileFlags : uint32_t
+		{
+			//The gid is in a tileset
+			TileInTileset = 1 << 0,
+			//The tile has its own collider shape instead of covering the whole tile
+			TileCustomCollider = 1 << 1
+		};
+		//Everything known about a gid, precomputed so tile queries don't search the tilesets
+		struct TileData
+		{
+			uint32_t tileset = 0;
+			uint32_t id = 0;
+			//The collider's vertices in colliderVertices
+			uint32_t colliderOffset = 0;
+			uint32_t colliderCount = 0;
+			uint32_t flags = 0;
+		};
+
+		std::vector<TilesetRange> tilesets;
+		std::vector<std::string> tilesetNames;
+		std::vector<std::string> tilesetImagePaths;
+		//Files the map was built from besides the tmx, the external tilesets and the tileset images, with their write times when loaded
+		struct SourceFile
+		{
+			std::string path;
+			int64_t writeTime = 0;
+		};
+		std::vector<SourceFile> sourceFiles;
+		//Data of every gid up to the last gid of the tilesets, indexed by gid
+		std::vector<TileData> tileData;
+		//Collider vertices of every tile with a custom collider, after the four vertices of the full tile collider
+		std::vector<Vector2> colliderVertices;
 		std::vector<Texture*> tilesetTextures;
-		tmx::Map* map;
 	};
 }
\ No newline at end of file
@@ -16,9 +16,9 @@ namespace une
 	class TilemapCollisionSystem : public ecs::System
 	{
 	public:
-		//Get the tilemap coords of a tile with a collider at this point in world coords
+		//Get the tilemap coords of a tile with a collider at this point in world coords, (-1, -1) if there is none
 		static Vector2Int GetCollisionTile(ecs::Entity entity, Vector2 pos);
-		//Get the tilemap coords of all tiles with colliders within a rectangle in world coords
+		//Get the tilemap coords of all tiles with colliders within a rectangle in world coords, row by row
 		static std::vector<Vector2Int> GetCollisionTiles(ecs::Entity entity, Vector2 topLeft, Vector2 bottomRight);
 	};
 }
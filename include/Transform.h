@@ -34,6 +34,10 @@ namespace une
 		//If true updates all transform based caches, reverts to false next frame
 		//WARNING: This will not update if transform is manually changed
 		bool staleCache = true;
+
+		//Added to the position and rotation when rendering, the physics system sets these to draw rigidbodies between ticks
+		Vector3 renderPositionOffset;
+		Vector3 renderRotationOffset;
 	};
 
 	//Transform system, Requires Transform component
@@ -99,16 +103,20 @@ namespace une
 		//Calculate the global transform of an entity, this is not a reference and does not affect the original transform
 		static Transform GetGlobalTransform(ecs::Entity entity);
 
-		static glm::mat4 GetLocalTranformMatrix(ecs::Entity entity);
+		//Get the Transform matrix of an entity without its parents, rendered includes the render offsets
+		static glm::mat4 GetLocalTranformMatrix(ecs::Entity entity, bool rendered = false);
 
 		//Get the global Transform matrix of an entity after all parent transforms have been applied
-		static glm::mat4 GetGlobalTransformMatrix(ecs::Entity entity);
+		//Renderers set rendered to include the render offsets of the entity and its parents
+		static glm::mat4 GetGlobalTransformMatrix(ecs::Entity entity, bool rendered = false);
 
 		//Applies transforms to vertices and returns the transformed vertices
 		static std::vector<Vector3> ApplyTransforms(const std::vector<Vector3>& vertices, const Transform& transform);
 
 		//Applies relevant 2D transforms to given 2D vertices and returns the transformed vertices
 		static std::vector<Vector2> ApplyTransforms2D(const std::vector<Vector2>& vertices, const Transform& transform);
+		//Applies relevant 2D transforms to given 2D vertices and writes them to transformedVerts, which must have room for every vertice
+		static void ApplyTransforms2D(const std::vector<Vector2>& vertices, const Transform& transform, Vector2* transformedVerts);
 
 		static void ApplyRotation(glm::mat4& mat, Vector3 eulers, RotationOrder order);
 	};
@@ -47,6 +47,8 @@ namespace une
 	inline std::shared_ptr<renderer::TextRenderSystem> textRenderSystem;
 	inline std::shared_ptr<renderer::TilemapRenderSystem> tilemapRenderSystem;
 
+	//Initialize only the transform, collision and physics systems, no window is needed. For servers and benchmarks, EngineInit calls this too
+	void SimulationInit();
 	//Initialize engine library, should be called after creating a window
 	void EngineInit();
 
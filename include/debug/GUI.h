@@ -25,6 +25,8 @@ namespace debug::gui
 	//Components
 	void TransformInspector();
 	void PolygonColliderInspector();
+	void CircleColliderInspector();
+	void CapsuleColliderInspector();
 	void RigidbodyInspector();
 	void TextRendererInspector();
 	void CameraInspector();
@@ -32,7 +34,8 @@ namespace debug::gui
 
 	//Function pointers to draw each component inspector by their readable name
 	const std::unordered_map<std::string, std::function<void()>> componentDrawFunctions{
-		{"Transform", TransformInspector}, {"PolygonCollider", PolygonColliderInspector}, {"TextRenderer", TextRendererInspector},
+		{"Transform", TransformInspector}, {"PolygonCollider", PolygonColliderInspector}, {"CircleCollider", CircleColliderInspector},
+		{"CapsuleCollider", CapsuleColliderInspector}, {"TextRenderer", TextRendererInspector},
 		{"Rigidbody", RigidbodyInspector}, {"Camera", CameraInspector}, {"SpriteRenderer", SpriteRendererInspector}
 	};
 
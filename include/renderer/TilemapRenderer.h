@@ -29,7 +29,7 @@ namespace une
 		public:
 			void Init();
 
-			//Sorts the tilemap layers into their draw layers (currently only transparent world)
+			//Sorts the tilemap layers into their draw layers (currently only transparent world), and streams the chunks near the cameras
 			void Prepass();
 
 			//Draws one layer of an entity's tilemap
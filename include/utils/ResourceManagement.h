@@ -153,7 +153,7 @@ namespace une::resources
             {"png", BasicLoad<Texture>},
             {"obj", BasicLoad<Model>},
             {"ttf", BasicLoad<Font>}, {"otf", BasicLoad<Font>},
-            {"tmx", BasicLoad<Tilemap>},
+            {"tmx", BasicLoad<Tilemap>}, {"unmap", BasicLoad<Tilemap>},
         };
 
     //Setup opengl stuff of asunchronously loaded resources
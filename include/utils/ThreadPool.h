@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace une
+{
+	//Fixed set of worker threads which split loops into chunks, the calling thread works on the chunks too
+	class ThreadPool
+	{
+	public:
+		//Function called on a range of indices [begin, end) by the thread threadIndex
+		using RangeFunction = std::function<void(size_t begin, size_t end, unsigned int threadIndex)>;
+
+		//threadCount includes the calling thread, 0 uses every hardware thread
+		explicit ThreadPool(unsigned int threadCount = 0);
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		//Restart the pool with a different amount of threads, 0 uses every hardware thread
+		void SetThreadCount(unsigned int threadCount);
+		//Amount of threads including the calling thread, every threadIndex is below this
+		unsigned int GetThreadCount() const;
+
+		//Call function on consecutive ranges of at most chunkSize indices covering [0, count), returns once every range is done
+		//Ranges are handed out in increasing order, so each thread sees its ranges in order. The calling thread is threadIndex 0
+		//Calls from inside a range run on the calling thread alone, calls from other threads wait for the running one to finish
+		void ParallelFor(size_t count, size_t chunkSize, const RangeFunction& function);
+
+	private:
+		void StartWorkers(unsigned int threadCount);
+		void StopWorkers();
+		//Workers start from the generation the pool was at when they were created, so a job started before they first wait isn't missed
+		void WorkerLoop(unsigned int threadIndex, uint64_t seenGeneration);
+		//Take ranges of the current job until there are none left
+		void RunChunks(unsigned int threadIndex);
+
+		std::vector<std::thread> workers;
+		//Only one ParallelFor at a time
+		std::mutex callMutex;
+
+		//Guards everything below except nextChunk
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		//Incremented for every job so sleeping workers can tell a new job from a spurious wake up
+		uint64_t generation = 0;
+		bool stopping = false;
+		//Workers which haven't finished the current job yet
+		unsigned int busyWorkers = 0;
+
+		const RangeFunction* job = nullptr;
+		size_t jobCount = 0;
+		size_t jobChunkSize = 1;
+		std::atomic<size_t> nextChunk = 0;
+	};
+
+	//Thread pool shared by the engine systems, created on first use with every hardware thread
+	ThreadPool& GetThreadPool();
+}
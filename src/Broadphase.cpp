@@ -0,0 +1,1033 @@
+#include "Broadphase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace une
+{
+	namespace
+	{
+		//Smallest bounds containing both a and b
+		Bounds BoundsUnion(const Bounds& a, const Bounds& b)
+		{
+			return { std::max(a[0], b[0]), std::max(a[1], b[1]), std::min(a[2], b[2]), std::min(a[3], b[3]) };
+		}
+		//Perimeter of bounds, used as the cost of a node when building the tree
+		float BoundsPerimeter(const Bounds& b)
+		{
+			return 2 * ((b[1] - b[3]) + (b[0] - b[2]));
+		}
+		//Pack cell coordinates to a single key
+		uint64_t CellKey(int32_t x, int32_t y)
+		{
+			return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+		}
+		//Hash a cell key, spreads nearby cells across the table
+		uint64_t HashCellKey(uint64_t key)
+		{
+			key ^= key >> 33;
+			key *= 0xff51afd7ed558ccdULL;
+			key ^= key >> 33;
+			key *= 0xc4ceb9fe1a85ec53ULL;
+			key ^= key >> 33;
+			return key;
+		}
+	}
+
+	////////// Brute Force //////////
+
+	void BruteForceBroadphase::Update(ecs::Entity entity, const Bounds& entityBounds, uint32_t entityLayers)
+	{
+		auto it = entityToIndex.find(entity);
+		if (it != entityToIndex.end())
+		{
+			bounds[it->second] = entityBounds;
+			layers[it->second] = entityLayers;
+			return;
+		}
+
+		entityToIndex[entity] = entities.size();
+		entities.push_back(entity);
+		bounds.push_back(entityBounds);
+		layers.push_back(entityLayers);
+	}
+
+	void BruteForceBroadphase::Remove(ecs::Entity entity)
+	{
+		auto it = entityToIndex.find(entity);
+		if (it == entityToIndex.end())
+			return;
+
+		//Move the last element to the removed index
+		const uint32_t index = it->second;
+		entities[index] = entities.back();
+		bounds[index] = bounds.back();
+		layers[index] = layers.back();
+		entityToIndex[entities[index]] = index;
+
+		entityToIndex.erase(entity);
+		entities.pop_back();
+		bounds.pop_back();
+		layers.pop_back();
+	}
+
+	void BruteForceBroadphase::Clear()
+	{
+		entities.clear();
+		bounds.clear();
+		layers.clear();
+		entityToIndex.clear();
+	}
+
+	bool BruteForceBroadphase::Contains(ecs::Entity entity) const
+	{
+		return entityToIndex.contains(entity);
+	}
+
+	void BruteForceBroadphase::Query(const Bounds& queryBounds, std::vector<ecs::Entity>& results, uint32_t layerMask)
+	{
+		for (size_t i = 0; i < entities.size(); i++)
+		{
+			if ((layers[i] & layerMask) && BoundsOverlap(bounds[i], queryBounds))
+				results.push_back(entities[i]);
+		}
+	}
+
+	////////// AABB Tree //////////
+
+	void AABBTree::Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers)
+	{
+		auto it = entityToLeaf.find(entity);
+		int32_t leaf;
+		if (it != entityToLeaf.end())
+		{
+			leaf = it->second;
+			//The fattened bounds still contain the entity so only the layers might need updating
+			if (BoundsContain(nodes[leaf].bounds, bounds))
+			{
+				if (nodes[leaf].layers != layers)
+				{
+					nodes[leaf].layers = layers;
+					for (int32_t index = nodes[leaf].parent; index != nullNode; index = nodes[index].parent)
+						nodes[index].layers = nodes[nodes[index].left].layers | nodes[nodes[index].right].layers;
+				}
+				return;
+			}
+
+			RemoveLeaf(leaf);
+		}
+		else
+		{
+			leaf = AllocateNode();
+			nodes[leaf].entity = entity;
+			entityToLeaf[entity] = leaf;
+		}
+
+		//Reinsert with fattened bounds
+		nodes[leaf].layers = layers;
+		nodes[leaf].bounds = { bounds[0] + margin, bounds[1] + margin, bounds[2] - margin, bounds[3] - margin };
+		InsertLeaf(leaf);
+	}
+
+	void AABBTree::Remove(ecs::Entity entity)
+	{
+		auto it = entityToLeaf.find(entity);
+		if (it == entityToLeaf.end())
+			return;
+
+		RemoveLeaf(it->second);
+		FreeNode(it->second);
+		entityToLeaf.erase(it);
+	}
+
+	void AABBTree::Clear()
+	{
+		nodes.clear();
+		entityToLeaf.clear();
+		root = nullNode;
+		freeList = nullNode;
+	}
+
+	bool AABBTree::Contains(ecs::Entity entity) const
+	{
+		return entityToLeaf.contains(entity);
+	}
+
+	void AABBTree::Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask)
+	{
+		if (root == nullNode)
+			return;
+
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const int32_t index = stack.back();
+			stack.pop_back();
+
+			//Subtrees without any of the layers are skipped entirely
+			const Node& node = nodes[index];
+			if (!(node.layers & layerMask) || !BoundsOverlap(node.bounds, bounds))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				results.push_back(node.entity);
+			}
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	int32_t AABBTree::Height() const
+	{
+		return root == nullNode ? 0 : nodes[root].height;
+	}
+
+	//Get a node from the free list, grows the node pool if necessary
+	int32_t AABBTree::AllocateNode()
+	{
+		if (freeList == nullNode)
+		{
+			nodes.emplace_back();
+			return nodes.size() - 1;
+		}
+
+		const int32_t node = freeList;
+		freeList = nodes[node].parent;
+		nodes[node] = Node();
+		return node;
+	}
+
+	//Return a node to the free list
+	void AABBTree::FreeNode(int32_t node)
+	{
+		nodes[node].parent = freeList;
+		nodes[node].height = -1;
+		freeList = node;
+	}
+
+	//Insert a leaf to the position in the tree that increases the total perimeter the least
+	void AABBTree::InsertLeaf(int32_t leaf)
+	{
+		if (root == nullNode)
+		{
+			root = leaf;
+			nodes[root].parent = nullNode;
+			return;
+		}
+
+		//Find the best sibling for the new leaf
+		const Bounds leafBounds = nodes[leaf].bounds;
+		int32_t index = root;
+		while (!nodes[index].IsLeaf())
+		{
+			const Node& node = nodes[index];
+			const float perimeter = BoundsPerimeter(node.bounds);
+			const float combinedPerimeter = BoundsPerimeter(BoundsUnion(node.bounds, leafBounds));
+
+			//Cost of making a new parent for this node and the new leaf
+			const float cost = 2 * combinedPerimeter;
+			//Minimum cost of pushing the leaf further down the tree
+			const float inheritanceCost = 2 * (combinedPerimeter - perimeter);
+
+			//Cost of descending into either child
+			float childCosts[2];
+			const int32_t children[2] = { node.left, node.right };
+			for (int i = 0; i < 2; i++)
+			{
+				const Node& child = nodes[children[i]];
+				const float childPerimeter = BoundsPerimeter(BoundsUnion(child.bounds, leafBounds));
+				if (child.IsLeaf())
+					childCosts[i] = childPerimeter + inheritanceCost;
+				else
+					childCosts[i] = childPerimeter - BoundsPerimeter(child.bounds) + inheritanceCost;
+			}
+
+			if (cost < childCosts[0] && cost < childCosts[1])
+				break;
+
+			index = childCosts[0] < childCosts[1] ? node.left : node.right;
+		}
+		const int32_t sibling = index;
+
+		//Create a new parent for the sibling and the leaf
+		const int32_t oldParent = nodes[sibling].parent;
+		const int32_t newParent = AllocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].bounds = BoundsUnion(leafBounds, nodes[sibling].bounds);
+		nodes[newParent].layers = nodes[leaf].layers | nodes[sibling].layers;
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].left = sibling;
+		nodes[newParent].right = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent != nullNode)
+		{
+			if (nodes[oldParent].left == sibling)
+				nodes[oldParent].left = newParent;
+			else
+				nodes[oldParent].right = newParent;
+		}
+		else
+		{
+			root = newParent;
+		}
+
+		//Walk back up the tree fixing heights and bounds
+		index = nodes[leaf].parent;
+		while (index != nullNode)
+		{
+			index = Balance(index);
+
+			Node& node = nodes[index];
+			node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+			node.bounds = BoundsUnion(nodes[node.left].bounds, nodes[node.right].bounds);
+			node.layers = nodes[node.left].layers | nodes[node.right].layers;
+
+			index = node.parent;
+		}
+	}
+
+	//Detach a leaf from the tree without freeing it
+	void AABBTree::RemoveLeaf(int32_t leaf)
+	{
+		if (leaf == root)
+		{
+			root = nullNode;
+			return;
+		}
+
+		const int32_t parent = nodes[leaf].parent;
+		const int32_t grandParent = nodes[parent].parent;
+		const int32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+		//The sibling takes the place of the parent
+		if (grandParent != nullNode)
+		{
+			if (nodes[grandParent].left == parent)
+				nodes[grandParent].left = sibling;
+			else
+				nodes[grandParent].right = sibling;
+			nodes[sibling].parent = grandParent;
+			FreeNode(parent);
+
+			//Walk back up the tree fixing heights and bounds
+			int32_t index = grandParent;
+			while (index != nullNode)
+			{
+				index = Balance(index);
+
+				Node& node = nodes[index];
+				node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+				node.bounds = BoundsUnion(nodes[node.left].bounds, nodes[node.right].bounds);
+				node.layers = nodes[node.left].layers | nodes[node.right].layers;
+
+				index = node.parent;
+			}
+		}
+		else
+		{
+			root = sibling;
+			nodes[sibling].parent = nullNode;
+			FreeNode(parent);
+		}
+	}
+
+	//Rotate the subtree at node if it is imbalanced, returns the new root of the subtree
+	int32_t AABBTree::Balance(int32_t iA)
+	{
+		Node& a = nodes[iA];
+		if (a.IsLeaf() || a.height < 2)
+			return iA;
+
+		const int32_t iB = a.left;
+		const int32_t iC = a.right;
+		Node& b = nodes[iB];
+		Node& c = nodes[iC];
+
+		const int32_t balance = c.height - b.height;
+
+		//Rotate c up
+		if (balance > 1)
+		{
+			const int32_t iF = c.left;
+			const int32_t iG = c.right;
+			Node& f = nodes[iF];
+			Node& g = nodes[iG];
+
+			//Swap a and c
+			c.left = iA;
+			c.parent = a.parent;
+			a.parent = iC;
+
+			//a's old parent should point to c
+			if (c.parent != nullNode)
+			{
+				if (nodes[c.parent].left == iA)
+					nodes[c.parent].left = iC;
+				else
+					nodes[c.parent].right = iC;
+			}
+			else
+			{
+				root = iC;
+			}
+
+			//Keep the taller of c's children under c
+			if (f.height > g.height)
+			{
+				c.right = iF;
+				a.right = iG;
+				g.parent = iA;
+				a.bounds = BoundsUnion(b.bounds, g.bounds);
+				a.layers = b.layers | g.layers;
+				c.bounds = BoundsUnion(a.bounds, f.bounds);
+				c.layers = a.layers | f.layers;
+				a.height = 1 + std::max(b.height, g.height);
+				c.height = 1 + std::max(a.height, f.height);
+			}
+			else
+			{
+				c.right = iG;
+				a.right = iF;
+				f.parent = iA;
+				a.bounds = BoundsUnion(b.bounds, f.bounds);
+				a.layers = b.layers | f.layers;
+				c.bounds = BoundsUnion(a.bounds, g.bounds);
+				c.layers = a.layers | g.layers;
+				a.height = 1 + std::max(b.height, f.height);
+				c.height = 1 + std::max(a.height, g.height);
+			}
+
+			return iC;
+		}
+
+		//Rotate b up
+		if (balance < -1)
+		{
+			const int32_t iD = b.left;
+			const int32_t iE = b.right;
+			Node& d = nodes[iD];
+			Node& e = nodes[iE];
+
+			//Swap a and b
+			b.left = iA;
+			b.parent = a.parent;
+			a.parent = iB;
+
+			//a's old parent should point to b
+			if (b.parent != nullNode)
+			{
+				if (nodes[b.parent].left == iA)
+					nodes[b.parent].left = iB;
+				else
+					nodes[b.parent].right = iB;
+			}
+			else
+			{
+				root = iB;
+			}
+
+			//Keep the taller of b's children under b
+			if (d.height > e.height)
+			{
+				b.right = iD;
+				a.left = iE;
+				e.parent = iA;
+				a.bounds = BoundsUnion(c.bounds, e.bounds);
+				a.layers = c.layers | e.layers;
+				b.bounds = BoundsUnion(a.bounds, d.bounds);
+				b.layers = a.layers | d.layers;
+				a.height = 1 + std::max(c.height, e.height);
+				b.height = 1 + std::max(a.height, d.height);
+			}
+			else
+			{
+				b.right = iE;
+				a.left = iD;
+				d.parent = iA;
+				a.bounds = BoundsUnion(c.bounds, d.bounds);
+				a.layers = c.layers | d.layers;
+				b.bounds = BoundsUnion(a.bounds, e.bounds);
+				b.layers = a.layers | e.layers;
+				a.height = 1 + std::max(c.height, d.height);
+				b.height = 1 + std::max(a.height, e.height);
+			}
+
+			return iB;
+		}
+
+		return iA;
+	}
+
+	////////// Spatial Hash Grid //////////
+
+	SpatialHashGrid::SpatialHashGrid(float cellSize)
+	{
+		this->cellSize = cellSize;
+		cells.resize(64);
+	}
+
+	void SpatialHashGrid::Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers)
+	{
+		const CellRange range = GetCellRange(bounds);
+
+		auto it = entityToProxy.find(entity);
+		if (it != entityToProxy.end())
+		{
+			Proxy& proxy = proxies[it->second];
+			proxy.bounds = bounds;
+			proxy.layers = layers;
+
+			//Only relink if the entity moved to different cells
+			if (proxy.cells == range)
+				return;
+
+			UnlinkProxy(it->second);
+			proxy.cells = range;
+			LinkProxy(it->second);
+			return;
+		}
+
+		//Add a new proxy
+		int32_t index;
+		if (!freeProxies.empty())
+		{
+			index = freeProxies.back();
+			freeProxies.pop_back();
+		}
+		else
+		{
+			index = proxies.size();
+			proxies.emplace_back();
+		}
+		proxies[index] = Proxy{ entity, bounds, layers, range, 0 };
+		entityToProxy[entity] = index;
+		LinkProxy(index);
+	}
+
+	void SpatialHashGrid::Remove(ecs::Entity entity)
+	{
+		auto it = entityToProxy.find(entity);
+		if (it == entityToProxy.end())
+			return;
+
+		UnlinkProxy(it->second);
+		proxies[it->second].entity = 0;
+		freeProxies.push_back(it->second);
+		entityToProxy.erase(it);
+	}
+
+	void SpatialHashGrid::Clear()
+	{
+		cells.assign(64, Cell());
+		usedCells = 0;
+		entries.clear();
+		freeEntry = nullIndex;
+		proxies.clear();
+		freeProxies.clear();
+		entityToProxy.clear();
+	}
+
+	bool SpatialHashGrid::Contains(ecs::Entity entity) const
+	{
+		return entityToProxy.contains(entity);
+	}
+
+	void SpatialHashGrid::Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask)
+	{
+		//New query id, on overflow reset every proxy so stale ids can't match
+		if (++queryCount == 0)
+		{
+			for (Proxy& proxy : proxies)
+				proxy.lastQuery = 0;
+			queryCount = 1;
+		}
+
+		auto visitCell = [&](int32_t entry)
+		{
+			for (; entry != nullIndex; entry = entries[entry].next)
+			{
+				Proxy& proxy = proxies[entries[entry].proxy];
+				if (proxy.lastQuery == queryCount)
+					continue;
+				proxy.lastQuery = queryCount;
+
+				if ((proxy.layers & layerMask) && BoundsOverlap(proxy.bounds, bounds))
+					results.push_back(proxy.entity);
+			}
+		};
+
+		const CellRange range = GetCellRange(bounds);
+		const uint64_t rangeArea = (uint64_t)(range.maxX - range.minX + 1) * (range.maxY - range.minY + 1);
+
+		//Very large queries are cheaper to do by going through every occupied cell
+		if (rangeArea > cells.size())
+		{
+			for (const Cell& cell : cells)
+			{
+				if (cell.head == nullIndex)
+					continue;
+				const int32_t x = (int32_t)(cell.key >> 32);
+				const int32_t y = (int32_t)(uint32_t)cell.key;
+				if (x >= range.minX && x <= range.maxX && y >= range.minY && y <= range.maxY)
+					visitCell(cell.head);
+			}
+			return;
+		}
+
+		for (int32_t x = range.minX; x <= range.maxX; x++)
+		{
+			for (int32_t y = range.minY; y <= range.maxY; y++)
+			{
+				const int32_t cell = FindCell(x, y, false);
+				if (cell != nullIndex)
+					visitCell(cells[cell].head);
+			}
+		}
+	}
+
+	//Set the width and height of a cell in world units, this relinks every entity
+	void SpatialHashGrid::SetCellSize(float size)
+	{
+		cellSize = size;
+
+		//Rebuild the grid from the stored proxies
+		cells.assign(64, Cell());
+		usedCells = 0;
+		entries.clear();
+		freeEntry = nullIndex;
+		for (size_t i = 0; i < proxies.size(); i++)
+		{
+			if (proxies[i].entity == 0)
+				continue;
+			proxies[i].cells = GetCellRange(proxies[i].bounds);
+			LinkProxy(i);
+		}
+	}
+
+	float SpatialHashGrid::GetCellSize() const
+	{
+		return cellSize;
+	}
+
+	SpatialHashGrid::CellRange SpatialHashGrid::GetCellRange(const Bounds& bounds) const
+	{
+		return {
+			(int32_t)std::floor(bounds[3] / cellSize), (int32_t)std::floor(bounds[2] / cellSize),
+			(int32_t)std::floor(bounds[1] / cellSize), (int32_t)std::floor(bounds[0] / cellSize)
+		};
+	}
+
+	//Find the slot of a cell, returns nullIndex if the cell does not exist and create is false
+	int32_t SpatialHashGrid::FindCell(int32_t x, int32_t y, bool create)
+	{
+		//Keep the load factor under 0.5 so probing stays short and always terminates
+		if (create && (usedCells + 1) * 2 > cells.size())
+			Rehash(cells.size() * 2);
+
+		const uint64_t key = CellKey(x, y);
+		const size_t mask = cells.size() - 1;
+
+		//Linear probing
+		for (size_t slot = HashCellKey(key) & mask;; slot = (slot + 1) & mask)
+		{
+			Cell& cell = cells[slot];
+			if (cell.used && cell.key == key)
+				return slot;
+
+			if (!cell.used)
+			{
+				if (!create)
+					return nullIndex;
+
+				cell.used = true;
+				cell.key = key;
+				cell.head = nullIndex;
+				usedCells++;
+				return slot;
+			}
+		}
+	}
+
+	//Link a proxy to every cell in its range
+	void SpatialHashGrid::LinkProxy(int32_t proxy)
+	{
+		const CellRange range = proxies[proxy].cells;
+		for (int32_t x = range.minX; x <= range.maxX; x++)
+		{
+			for (int32_t y = range.minY; y <= range.maxY; y++)
+			{
+				//Get an entry from the free list or the end of the pool
+				int32_t entry;
+				if (freeEntry != nullIndex)
+				{
+					entry = freeEntry;
+					freeEntry = entries[entry].next;
+				}
+				else
+				{
+					entry = entries.size();
+					entries.emplace_back();
+				}
+
+				//Push the entry to the front of the cell's list
+				Cell& cell = cells[FindCell(x, y, true)];
+				entries[entry] = { proxy, cell.head };
+				cell.head = entry;
+			}
+		}
+	}
+
+	//Unlink a proxy from every cell in its range
+	void SpatialHashGrid::UnlinkProxy(int32_t proxy)
+	{
+		const CellRange range = proxies[proxy].cells;
+		for (int32_t x = range.minX; x <= range.maxX; x++)
+		{
+			for (int32_t y = range.minY; y <= range.maxY; y++)
+			{
+				const int32_t cell = FindCell(x, y, false);
+				if (cell == nullIndex)
+					continue;
+
+				//Find and remove the proxy's entry from the cell's list
+				int32_t* link = &cells[cell].head;
+				while (*link != nullIndex)
+				{
+					const int32_t entry = *link;
+					if (entries[entry].proxy == proxy)
+					{
+						*link = entries[entry].next;
+						entries[entry].next = freeEntry;
+						freeEntry = entry;
+						break;
+					}
+					link = &entries[entry].next;
+				}
+			}
+		}
+	}
+
+	//Resize the hash table, dropping cells which no longer contain anything
+	void SpatialHashGrid::Rehash(size_t capacity)
+	{
+		std::vector<Cell> oldCells = std::move(cells);
+
+		//Empty cells are dropped so the table might not need to grow after all
+		size_t occupied = 0;
+		for (const Cell& cell : oldCells)
+		{
+			if (cell.head != nullIndex)
+				occupied++;
+		}
+		size_t newCapacity = 64;
+		while (newCapacity < occupied * 4)
+			newCapacity *= 2;
+		newCapacity = std::min(newCapacity, capacity);
+
+		cells.assign(newCapacity, Cell());
+		usedCells = 0;
+		const size_t mask = newCapacity - 1;
+		for (const Cell& cell : oldCells)
+		{
+			if (cell.head == nullIndex)
+				continue;
+
+			size_t slot = HashCellKey(cell.key) & mask;
+			while (cells[slot].used)
+				slot = (slot + 1) & mask;
+			cells[slot] = cell;
+			usedCells++;
+		}
+	}
+
+	////////// Sweep and Prune //////////
+
+	void SweepAndPrune::Update(ecs::Entity entity, const Bounds& bounds, uint32_t layers)
+	{
+		//Lower and upper values of the bounds on each axis
+		const float mins[2] = { bounds[3], bounds[2] };
+		const float maxs[2] = { bounds[1], bounds[0] };
+		maxWidth = std::max(maxWidth, bounds[1] - bounds[3]);
+
+		auto it = entityToBox.find(entity);
+		if (it == entityToBox.end())
+		{
+			uint32_t index;
+			if (!freeBoxes.empty())
+			{
+				index = freeBoxes.back();
+				freeBoxes.pop_back();
+			}
+			else
+			{
+				index = boxes.size();
+				boxes.emplace_back();
+			}
+			entityToBox[entity] = index;
+
+			Box& box = boxes[index];
+			box.entity = entity;
+			box.bounds = bounds;
+			box.layers = layers;
+
+			//Add the endpoints to the ends of the axes and sort them down to place
+			for (int axis = 0; axis < 2; axis++)
+			{
+				box.min[axis] = axes[axis].size();
+				axes[axis].push_back({ mins[axis], index << 1 });
+				box.max[axis] = axes[axis].size();
+				axes[axis].push_back({ maxs[axis], (index << 1) | 1 });
+			}
+			for (int axis = 0; axis < 2; axis++)
+			{
+				SortDown(axis, boxes[index].min[axis], true);
+				SortDown(axis, boxes[index].max[axis], true);
+			}
+			return;
+		}
+
+		const uint32_t index = it->second;
+		boxes[index].bounds = bounds;
+		boxes[index].layers = layers;
+		for (int axis = 0; axis < 2; axis++)
+		{
+			axes[axis][boxes[index].min[axis]].value = mins[axis];
+			axes[axis][boxes[index].max[axis]].value = maxs[axis];
+
+			//In this order a min endpoint can never get stuck behind its own max
+			SortUp(axis, boxes[index].max[axis], true);
+			SortDown(axis, boxes[index].min[axis], true);
+			SortUp(axis, boxes[index].min[axis], true);
+			SortDown(axis, boxes[index].max[axis], true);
+		}
+	}
+
+	void SweepAndPrune::Remove(ecs::Entity entity)
+	{
+		auto it = entityToBox.find(entity);
+		if (it == entityToBox.end())
+			return;
+
+		//Move the endpoints to the ends of the axes, moving the min removes every pair this box is in
+		const uint32_t index = it->second;
+		for (int axis = 0; axis < 2; axis++)
+		{
+			axes[axis][boxes[index].max[axis]].value = std::numeric_limits<float>::infinity();
+			SortUp(axis, boxes[index].max[axis], false);
+			axes[axis][boxes[index].min[axis]].value = std::numeric_limits<float>::infinity();
+			SortUp(axis, boxes[index].min[axis], true);
+
+			axes[axis].pop_back();
+			axes[axis].pop_back();
+		}
+
+		boxes[index].entity = 0;
+		freeBoxes.push_back(index);
+		entityToBox.erase(it);
+	}
+
+	void SweepAndPrune::Clear()
+	{
+		axes[0].clear();
+		axes[1].clear();
+		boxes.clear();
+		freeBoxes.clear();
+		entityToBox.clear();
+		maxWidth = 0;
+		pairs.clear();
+		changedPairs.clear();
+	}
+
+	bool SweepAndPrune::Contains(ecs::Entity entity) const
+	{
+		return entityToBox.contains(entity);
+	}
+
+	void SweepAndPrune::Query(const Bounds& bounds, std::vector<ecs::Entity>& results, uint32_t layerMask)
+	{
+		//Every overlapping box must start after this
+		const float lowest = bounds[3] - maxWidth;
+		const std::vector<Endpoint>& endpoints = axes[0];
+		auto start = std::lower_bound(endpoints.begin(), endpoints.end(), lowest,
+			[](const Endpoint& endpoint, float value) { return endpoint.value < value; });
+
+		for (auto it = start; it != endpoints.end() && it->value <= bounds[1]; it++)
+		{
+			if (it->IsMax())
+				continue;
+
+			const Box& box = boxes[it->Box()];
+			if ((box.layers & layerMask) && BoundsOverlap(box.bounds, bounds))
+				results.push_back(box.entity);
+		}
+	}
+
+	//Append every pair whose bounds currently overlap to result
+	void SweepAndPrune::GetPairs(std::vector<EntityPair>& result) const
+	{
+		for (const auto& [key, flags] : pairs)
+		{
+			if (flags & overlapping)
+				result.emplace_back(key >> 32, (uint32_t)key);
+		}
+	}
+
+	//Append the pairs which started or stopped overlapping since the last call
+	void SweepAndPrune::ConsumePairChanges(std::vector<EntityPair>& began, std::vector<EntityPair>& ended)
+	{
+		for (uint64_t key : changedPairs)
+		{
+			auto it = pairs.find(key);
+			//Pair was removed before it was reported, or this is a duplicate
+			if (it == pairs.end() || !(it->second & queued))
+				continue;
+
+			uint8_t& flags = it->second;
+			flags &= ~queued;
+			if ((flags & overlapping) && !(flags & reported))
+			{
+				began.emplace_back(key >> 32, (uint32_t)key);
+				flags |= reported;
+			}
+			else if (!(flags & overlapping))
+			{
+				ended.emplace_back(key >> 32, (uint32_t)key);
+				pairs.erase(it);
+			}
+		}
+		changedPairs.clear();
+	}
+
+	//Move an endpoint down its axis until it is sorted, updating overlapping pairs along the way
+	void SweepAndPrune::SortDown(int axis, uint32_t index, bool updatePairs)
+	{
+		std::vector<Endpoint>& endpoints = axes[axis];
+		const Endpoint endpoint = endpoints[index];
+		const int otherAxis = 1 - axis;
+
+		while (index > 0 && endpoints[index - 1].value > endpoint.value)
+		{
+			const Endpoint& previous = endpoints[index - 1];
+			if (updatePairs && previous.IsMax() != endpoint.IsMax())
+			{
+				const uint32_t a = endpoint.Box();
+				const uint32_t b = previous.Box();
+				//A min passing a max starts overlap on this axis, a max passing a min ends it
+				if (OverlapOnAxis(a, b, otherAxis))
+				{
+					if (previous.IsMax())
+						AddPair(a, b);
+					else
+						RemovePair(a, b);
+				}
+			}
+
+			SwapEndpoints(axis, index - 1);
+			index--;
+		}
+	}
+
+	//Move an endpoint up its axis until it is sorted, updating overlapping pairs along the way
+	void SweepAndPrune::SortUp(int axis, uint32_t index, bool updatePairs)
+	{
+		std::vector<Endpoint>& endpoints = axes[axis];
+		const Endpoint endpoint = endpoints[index];
+		const int otherAxis = 1 - axis;
+
+		while (index + 1 < endpoints.size() && endpoints[index + 1].value < endpoint.value)
+		{
+			const Endpoint& next = endpoints[index + 1];
+			if (updatePairs && next.IsMax() != endpoint.IsMax())
+			{
+				const uint32_t a = endpoint.Box();
+				const uint32_t b = next.Box();
+				//A max passing a min starts overlap on this axis, a min passing a max ends it
+				if (OverlapOnAxis(a, b, otherAxis))
+				{
+					if (endpoint.IsMax())
+						AddPair(a, b);
+					else
+						RemovePair(a, b);
+				}
+			}
+
+			SwapEndpoints(axis, index);
+			index++;
+		}
+	}
+
+	//Swap two neighbouring endpoints and fix the indices of their boxes
+	void SweepAndPrune::SwapEndpoints(int axis, uint32_t index)
+	{
+		std::vector<Endpoint>& endpoints = axes[axis];
+		std::swap(endpoints[index], endpoints[index + 1]);
+
+		for (uint32_t i = index; i <= index + 1; i++)
+		{
+			Box& box = boxes[endpoints[i].Box()];
+			if (endpoints[i].IsMax())
+				box.max[axis] = i;
+			else
+				box.min[axis] = i;
+		}
+	}
+
+	//Do the boxes overlap on an axis according to the sorted endpoints
+	bool SweepAndPrune::OverlapOnAxis(uint32_t a, uint32_t b, int axis) const
+	{
+		return boxes[a].min[axis] < boxes[b].max[axis] && boxes[b].min[axis] < boxes[a].max[axis];
+	}
+
+	void SweepAndPrune::AddPair(uint32_t a, uint32_t b)
+	{
+		const uint64_t key = PairKey(boxes[a].entity, boxes[b].entity);
+		uint8_t& flags = pairs[key];
+		flags |= overlapping;
+		QueuePair(key, flags);
+	}
+
+	void SweepAndPrune::RemovePair(uint32_t a, uint32_t b)
+	{
+		const uint64_t key = PairKey(boxes[a].entity, boxes[b].entity);
+		auto it = pairs.find(key);
+		if (it == pairs.end())
+			return;
+
+		//Never reported, so it can be forgotten immediately
+		if (!(it->second & reported))
+		{
+			pairs.erase(it);
+			return;
+		}
+
+		it->second &= ~overlapping;
+		QueuePair(key, it->second);
+	}
+
+	//Add a pair to the list of changed pairs if it isn't there already
+	void SweepAndPrune::QueuePair(uint64_t key, uint8_t& flags)
+	{
+		if (flags & queued)
+			return;
+		flags |= queued;
+		changedPairs.push_back(key);
+
+		//If changes are never consumed, drop the keys of forgotten pairs so the list can't grow forever
+		if (changedPairs.size() > 2 * pairs.size() + 64)
+		{
+			std::erase_if(changedPairs, [this](uint64_t changed)
+			{
+				auto it = pairs.find(changed);
+				return it == pairs.end() || !(it->second & queued);
+			});
+		}
+	}
+}
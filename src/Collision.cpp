@@ -1,481 +1,2301 @@
 #include "Collision.h"
 
+#include <algorithm>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNE_SAT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define UNE_SAT_NEON
+#include <arm_neon.h>
+#endif
+
+#include "debug/Logging.h"
+#include "utils/ThreadPool.h"
+#include "TilemapCollision.h"
+#include "Physics.h"
 #include "debug/Primitives.h"
 #include "renderer/PrimitiveRenderer.h"
 
 namespace une
 {
-	///Called every frame
-	void CollisionSystem::Update()
+	namespace
 	{
-		//For each entity
-		for (ecs::Entity entity : entities)
+		//Polygons with at most this many vertices calculate their axes on the stack in SATIntersect
+		constexpr size_t fixedPolygonCapacity = 32;
+
+		//The projection kernel reads vertices as a flat array of doubles
+		static_assert(sizeof(Vector2) == 2 * sizeof(double));
+
+		//Project every vertice of a polygon to axis and get the lowest and highest projection
+		void ProjectPolygon(const Vector2* vertices, uint32_t vertexCount, const Vector2& axis, double& min, double& max)
 		{
-			PolygonCollider& collider = ecs::GetComponent<PolygonCollider>(entity);
-			Transform& transform = ecs::GetComponent<Transform>(entity);
+			min = INFINITY;
+			max = -INFINITY;
+			uint32_t i = 0;
 
-			//Update bounding box if the entity has moved and check collision if it is a trigger
-			if (transform.staleCache)
+			//Project two vertices at a time
+#if defined(UNE_SAT_SSE2)
+			if (vertexCount >= 2)
 			{
-				UpdateAABB(entity);
-				if (collider.trigger)
+				const double* data = &vertices[0].x;
+				const __m128d axisX = _mm_set1_pd(axis.x);
+				const __m128d axisY = _mm_set1_pd(axis.y);
+				__m128d minProjection = _mm_set1_pd(INFINITY);
+				__m128d maxProjection = _mm_set1_pd(-INFINITY);
+				for (; i + 2 <= vertexCount; i += 2)
 				{
-					CheckCollision(entity);
+					const __m128d first = _mm_loadu_pd(data + i * 2);
+					const __m128d second = _mm_loadu_pd(data + i * 2 + 2);
+					const __m128d x = _mm_unpacklo_pd(first, second);
+					const __m128d y = _mm_unpackhi_pd(first, second);
+					const __m128d projection = _mm_add_pd(_mm_mul_pd(x, axisX), _mm_mul_pd(y, axisY));
+					minProjection = _mm_min_pd(minProjection, projection);
+					maxProjection = _mm_max_pd(maxProjection, projection);
 				}
+				minProjection = _mm_min_sd(minProjection, _mm_unpackhi_pd(minProjection, minProjection));
+				maxProjection = _mm_max_sd(maxProjection, _mm_unpackhi_pd(maxProjection, maxProjection));
+				min = _mm_cvtsd_f64(minProjection);
+				max = _mm_cvtsd_f64(maxProjection);
 			}
-
-			//Draw the bounding box and polygon collider
-			if (collider.visualise)
+#elif defined(UNE_SAT_NEON)
+			if (vertexCount >= 2)
 			{
-				//Calculate the vertices of the collision and bounding boxes in world coordinates
-				Transform globalTf = TransformSystem::GetGlobalTransform(entity);
-				if (collider.rotationOverride >= 0)
-					globalTf.rotation.z = collider.rotationOverride;
+				const double* data = &vertices[0].x;
+				const float64x2_t axisX = vdupq_n_f64(axis.x);
+				const float64x2_t axisY = vdupq_n_f64(axis.y);
+				float64x2_t minProjection = vdupq_n_f64(INFINITY);
+				float64x2_t maxProjection = vdupq_n_f64(-INFINITY);
+				for (; i + 2 <= vertexCount; i += 2)
+				{
+					//Loads x and y of both vertices into separate registers
+					const float64x2x2_t xy = vld2q_f64(data + i * 2);
+					const float64x2_t projection = vaddq_f64(vmulq_f64(xy.val[0], axisX), vmulq_f64(xy.val[1], axisY));
+					minProjection = vminq_f64(minProjection, projection);
+					maxProjection = vmaxq_f64(maxProjection, projection);
+				}
+				min = vminvq_f64(minProjection);
+				max = vmaxvq_f64(maxProjection);
+			}
+#endif
 
-				//Collider
-				std::vector<Vector2> colliderVerts = TransformSystem::ApplyTransforms2D(collider.vertices, globalTf);
-				debug::DrawPolygon(colliderVerts, Color::Red(), true, globalTf.position.z);
-				//AABB
-				std::vector<Vector2> boundingBoxVerts{
-					Vector2(collider.bounds[3], collider.bounds[0]), Vector2(collider.bounds[1], collider.bounds[0]),
-					Vector2(collider.bounds[1], collider.bounds[2]), Vector2(collider.bounds[3], collider.bounds[2]) };
-				debug::DrawPolygon(boundingBoxVerts, Color::Green(), true, globalTf.position.z);
+			//Remaining vertices
+			for (; i < vertexCount; i++)
+			{
+				const double projection = axis.Dot(vertices[i]);
+				min = std::min(min, projection);
+				max = std::max(max, projection);
 			}
 		}
-	}
-
-	///Checks collision between entity a and every other entity and tilemap, Returns the collisions from the perspective of a, and calls every applicable callback function
-	std::vector<Collision> CollisionSystem::CheckCollision(ecs::Entity a)
-	{
-		Transform& aTransform = ecs::GetComponent<Transform>(a);
-		PolygonCollider& aCollider = ecs::GetComponent<PolygonCollider>(a);
 
-		//Check tilemap collision
-		std::vector<Collision> tilemapCollisions = CheckTilemapCollision(a);
-		std::vector<Collision> entityCollisions;
+		//Is axis parallel to any of axes
+		bool ContainsParallelAxis(const Vector2* axes, uint32_t axisCount, const Vector2& axis)
+		{
+			for (uint32_t i = 0; i < axisCount; i++)
+			{
+				if (std::abs(axes[i].x * axis.y - axes[i].y * axis.x) < epsilon)
+					return true;
+			}
+			return false;
+		}
 
-		//For each entity
-		for (ecs::Entity b : entities)
+		//Calculate the normalized edge normals of a clockwise polygon, skipping parallel edges. Returns the amount of axes written
+		uint32_t CalculateAxes(const Vector2* vertices, uint32_t vertexCount, Vector2* axes)
 		{
-			//Don't collide with self
-			if (a == b)
-				continue;
+			uint32_t axisCount = 0;
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				//Overflow nextVertice to beginning
+				const uint32_t nextVertice = i < vertexCount - 1 ? i + 1 : 0;
+				const Vector2 edge = vertices[nextVertice] - vertices[i];
+				if (edge.x == 0 && edge.y == 0)
+					continue;
 
-			Collision collision = CheckEntityCollision(a, b);
-			if (collision.type != Collision::Type::miss)
-				entityCollisions.push_back(collision);
+				//Left normal because clockwise
+				const Vector2 axis = edge.LeftNormal();
+				if (!ContainsParallelAxis(axes, axisCount, axis))
+					axes[axisCount++] = axis;
+			}
+			return axisCount;
 		}
 
-		//For each collision call a and b callbacks
-		for (const Collision& entityCollision : entityCollisions)
+		//Axes of a polygon which isn't cached, stored on the stack for polygons of up to fixedPolygonCapacity vertices
+		struct PolygonAxes
 		{
-			PolygonCollider& bCollider = ecs::GetComponent<PolygonCollider>(entityCollision.b);
-
-			//Setup collision event from b's perspective
-			Collision bToA;
-			bToA.a = entityCollision.b;
-			bToA.b = a;
-			bToA.type = entityCollision.type;
-			bToA.normal = Vector2() - entityCollision.normal;
-			bToA.mtv = Vector2() - entityCollision.mtv;
+			std::array<Vector2, fixedPolygonCapacity> fixedAxes;
+			std::vector<Vector2> largeAxes;
 
-			if (ecs::EntityExists(entityCollision.a))
-			{
-				//Call a's callback
-				if (aCollider.callback)
-					aCollider.callback(entityCollision);
-			}
-			if (ecs::EntityExists(entityCollision.b))
+			PolygonView View(const Vector2* vertices, uint32_t vertexCount)
 			{
-				//Call b's callback
-				if (bCollider.callback)
-					bCollider.callback(bToA);
+				Vector2* axes = fixedAxes.data();
+				if (vertexCount > fixedPolygonCapacity)
+				{
+					largeAxes.resize(vertexCount);
+					axes = largeAxes.data();
+				}
+				return PolygonView{ vertices, vertexCount, axes, CalculateAxes(vertices, vertexCount, axes) };
 			}
+		};
+
+		//Closest point to point on the segment start-end
+		Vector2 ClosestPointOnSegment(const Vector2& point, const Vector2& start, const Vector2& end)
+		{
+			const Vector2 segment = end - start;
+			const double lengthSquared = segment.Dot(segment);
+			if (lengthSquared < epsilon * epsilon)
+				return start;
+			return start + segment * std::clamp((point - start).Dot(segment) / lengthSquared, 0.0, 1.0);
 		}
-		//For each tilemap collision call a's callback
-		for (const Collision& tilemapCollision : tilemapCollisions)
+
+		//Closest points between the segments aStart-aEnd and bStart-bEnd, segments may be single points
+		//Works on the components directly, this runs for every circle and capsule pair
+		void ClosestPointsOnSegments(const Vector2& aStart, const Vector2& aEnd, const Vector2& bStart, const Vector2& bEnd, Vector2& aClosest, Vector2& bClosest)
 		{
-			if (ecs::EntityExists(tilemapCollision.a))
+			const double aX = aEnd.x - aStart.x, aY = aEnd.y - aStart.y;
+			const double bX = bEnd.x - bStart.x, bY = bEnd.y - bStart.y;
+			const double offsetX = aStart.x - bStart.x, offsetY = aStart.y - bStart.y;
+			const double aLengthSquared = aX * aX + aY * aY;
+			const double bLengthSquared = bX * bX + bY * bY;
+			const double bOffset = bX * offsetX + bY * offsetY;
+
+			//Fraction along each segment
+			double s = 0;
+			double t = 0;
+			if (aLengthSquared < epsilon * epsilon)
 			{
-				//Call a's callback
-				if (aCollider.callback)
-					aCollider.callback(tilemapCollision);
+				if (bLengthSquared >= epsilon * epsilon)
+					t = std::clamp(bOffset / bLengthSquared, 0.0, 1.0);
+			}
+			else
+			{
+				const double aOffset = aX * offsetX + aY * offsetY;
+				if (bLengthSquared < epsilon * epsilon)
+					s = std::clamp(-aOffset / aLengthSquared, 0.0, 1.0);
+				else
+				{
+					//Closest points of the infinite lines, clamped to the segments
+					const double dot = aX * bX + aY * bY;
+					const double denominator = aLengthSquared * bLengthSquared - dot * dot;
+					s = denominator > 0 ? std::clamp((dot * bOffset - aOffset * bLengthSquared) / denominator, 0.0, 1.0) : 0;
+					t = (dot * s + bOffset) / bLengthSquared;
+					if (t < 0)
+					{
+						t = 0;
+						s = std::clamp(-aOffset / aLengthSquared, 0.0, 1.0);
+					}
+					else if (t > 1)
+					{
+						t = 1;
+						s = std::clamp((dot - aOffset) / aLengthSquared, 0.0, 1.0);
+					}
+				}
 			}
-		}
 
-		//Combine the tilemap and entity collisions
-		std::vector<Collision> collisions = tilemapCollisions;
-		collisions.insert(collisions.end(), entityCollisions.begin(), entityCollisions.end());
+			aClosest.x = aStart.x + aX * s;
+			aClosest.y = aStart.y + aY * s;
+			bClosest.x = bStart.x + bX * t;
+			bClosest.y = bStart.y + bY * t;
+		}
 
-		return collisions;
-	}
+		//Distance between the segment start-end and a clockwise convex polygon, and the closest points on both
+		//Returns 0 when the segment crosses the outline or is inside the polygon
+		double SegmentPolygonDistance(const Vector2& start, const Vector2& end, const Vector2* vertices, uint32_t vertexCount, Vector2& segmentClosest, Vector2& polygonClosest)
+		{
+			double minDistanceSquared = INFINITY;
+			bool startInside = vertexCount >= 3;
+			Vector2 onSegment, onEdge;
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				const Vector2& vertex = vertices[i];
+				const Vector2& next = vertices[i < vertexCount - 1 ? i + 1 : 0];
+
+				ClosestPointsOnSegments(start, end, vertex, next, onSegment, onEdge);
+				const double differenceX = onSegment.x - onEdge.x;
+				const double differenceY = onSegment.y - onEdge.y;
+				const double distanceSquared = differenceX * differenceX + differenceY * differenceY;
+				if (distanceSquared < minDistanceSquared)
+				{
+					minDistanceSquared = distanceSquared;
+					segmentClosest = onSegment;
+					polygonClosest = onEdge;
+				}
 
-	///Checks for collision between a tilemap collision layer and an entity. Does not call callbacks
-	std::vector<Collision> CollisionSystem::CheckTilemapCollision(ecs::Entity entity)
-	{/*
-		//If no tilemap collision layer is set return no collisions
-		if (!tilemap)
-			return std::vector<Collision>();
+				//Left normals face outwards on clockwise polygons
+				if (-(next.y - vertex.y) * (start.x - vertex.x) + (next.x - vertex.x) * (start.y - vertex.y) > 0)
+					startInside = false;
+			}
 
-		Transform& transform = ecs::GetComponent<Transform>(entity);
-		PolygonCollider& collider = ecs::GetComponent<PolygonCollider>(entity);
+			//A segment which doesn't cross the outline is either completely inside or outside
+			return startInside ? 0 : std::sqrt(minDistanceSquared);
+		}
 
-		//Log the collisions
-		std::vector<Collision> collisions;
+		//Find where the segment origin + time * delta (0-1) enters a capsule, and the capsule's normal there
+		//Segments starting inside the capsule enter at time 0 with a zero normal
+		bool RayCapsule(const Vector2& origin, const Vector2& delta, const Vector2& start, const Vector2& end, double radius, double& time, Vector2& normal)
+		{
+			normal = Vector2();
+			const Vector2 closest = ClosestPointOnSegment(origin, start, end);
+			if ((origin - closest).Dot(origin - closest) <= radius * radius)
+			{
+				time = 0;
+				return true;
+			}
 
-		//Find collider tiles inside bounding box
-		std::vector<Vector2> possibleCollisions = tilemap->CheckCollisionBox(Vector2(collider.bounds[3], collider.bounds[0]), Vector2(collider.bounds[1], collider.bounds[2]));
+			//The rounded ends
+			time = INFINITY;
+			const double deltaSquared = delta.Dot(delta);
+			for (const Vector2& center : { start, end })
+			{
+				const Vector2 offset = origin - center;
+				const double half = offset.Dot(delta);
+				const double discriminant = half * half - deltaSquared * (offset.Dot(offset) - radius * radius);
+				if (deltaSquared == 0 || discriminant < 0)
+					continue;
 
-		//Apply transforms to entity verts
-		float rotation = collider.rotationOverride >= 0 ? collider.rotationOverride : transform.rotation.z;
-		std::vector<Vector2> entityVerts = TransformSystem::ApplyTransforms2D(collider.vertices, rotation, transform.scale, transform.position);
+				const double enter = (-half - std::sqrt(discriminant)) / deltaSquared;
+				if (enter >= 0 && enter <= 1 && enter < time)
+				{
+					time = enter;
+					normal = (origin + delta * enter - center).Normalize();
+				}
+			}
 
+			//The straight sides, only hit from the outside
+			const Vector2 segment = end - start;
+			const double lengthSquared = segment.Dot(segment);
+			if (lengthSquared >= epsilon * epsilon)
+			{
+				const Vector2 sideNormal = segment.LeftNormal();
+				for (const Vector2& side : { sideNormal, Vector2() - sideNormal })
+				{
+					const double speed = delta.Dot(side);
+					if (speed >= 0)
+						continue;
+
+					const Vector2 sideStart = start + side * radius;
+					const double enter = (sideStart - origin).Dot(side) / speed;
+					const double along = (origin + delta * enter - sideStart).Dot(segment) / lengthSquared;
+					if (enter >= 0 && enter <= 1 && enter < time && along >= 0 && along <= 1)
+					{
+						time = enter;
+						normal = side;
+					}
+				}
+			}
+			return time != INFINITY;
+		}
 
-		//For each tile inside the bounding box
-		for (int i = 0; i < possibleCollisions.size(); i++)
+		//Find when a convex polygon moving by velocity first touches a capsule by conservative advancement, with the same results as SweptSATIntersect
+		//The normal is the capsule's surface normal facing the polygon, and point is where they touch relative to the polygon's start
+		bool SweptPolygonCapsule(const PolygonView& polygon, const Vector2& velocity, const Vector2& start, const Vector2& end, double radius, double& time, Vector2& normal, Vector2& point)
 		{
-			//Get the final polygon collider of the tile
-			std::vector<unsigned int> tileIDs = tilemap->GetCollisionTileAtLocation(possibleCollisions[i].x, possibleCollisions[i].y);
-			unsigned int tileID = tileIDs[0];
-			std::vector<Vector2> tileVerts = tilemap->GetTileCollider(tileID);
-
-			//Comply with the layer matrix
-			LayerInteraction collisionInteraction = GetLayerInteraction(GetTileCollisionLayer(tileID), collider.layer);
-			if (collisionInteraction == LayerInteraction::none)
-				continue;
+			//Gaps smaller than this count as touching
+			constexpr double tolerance = 0.001;
+			constexpr int maxIterations = 64;
+			const double speed = velocity.Length();
+
+			//Move the capsule towards the polygon instead, which gives the same gaps
+			double advanced = 0;
+			for (int i = 0; i < maxIterations; i++)
+			{
+				const Vector2 offset = velocity * -advanced;
+				Vector2 segmentClosest, polygonClosest;
+				const double distance = SegmentPolygonDistance(start + offset, end + offset, polygon.vertices, polygon.vertexCount, segmentClosest, polygonClosest);
 
-			//Move the tile verts to position
-			Vector2 tilePosition = tilemap->GetTilePosition(possibleCollisions[i].x, possibleCollisions[i].y);
-			std::vector<Vector2> transformedTileVerts = TransformSystem::ApplyTransforms2D(tileVerts, 0, 1, tilePosition);
-			//Check entity-tile collision
-			Collision collision = SATIntersect(entityVerts, transformedTileVerts);
+				const double gap = distance - radius;
+				if (gap <= tolerance)
+				{
+					time = advanced;
+					//Already overlapping at the start
+					if (gap < 0 && advanced == 0)
+						normal = Vector2() - velocity.Normalize();
+					else
+						normal = (polygonClosest - segmentClosest).Normalize();
+					point = polygonClosest;
+					return true;
+				}
 
-			Collision::Type collisionType = collider.trigger || tileIDToTrigger[tileID] ? Collision::Type::tilemapTrigger : Collision::Type::tilemapCollision;
+				//Nothing can close the gap faster than moving straight at it
+				if (speed == 0)
+					return false;
+				advanced += gap / speed;
+				if (advanced > 1)
+					return false;
+			}
+			return false;
+		}
 
-			//Comply with the layer matrix
-			if (collisionInteraction == LayerInteraction::triggers)
-				if (collisionType != Collision::Type::tilemapTrigger)
-					continue;
-			if (collisionInteraction == LayerInteraction::collisions)
-				if (collisionType != Collision::Type::tilemapCollision)
-					continue;
+		//Find when a capsule moving by velocity first touches a convex polygon, circles are capsules whose start and end are the same
+		//The normal is the polygon's surface normal facing the capsule, and point is where they touch
+		bool SweptCapsulePolygon(const Vector2& start, const Vector2& end, double radius, const Vector2& velocity, const PolygonView& polygon, double& time, Vector2& normal, Vector2& point)
+		{
+			//Move the polygon towards the capsule instead, the polygon doesn't move so the point is already where they touch
+			if (!SweptPolygonCapsule(polygon, Vector2() - velocity, start, end, radius, time, normal, point))
+				return false;
+			normal = Vector2() - normal;
+			return true;
+		}
 
-			//If collided with tile
-			if (collision.type != Collision::Type::miss)
+		//Find when a capsule moving by velocity first touches another capsule, circles are capsules whose start and end are the same
+		//The other capsule grown by radius is hit by the ends of the moving segment, or the moving capsule grown by otherRadius by the other's ends moving the other way
+		//The normal is the other capsule's surface normal facing the moving one, and point is where they touch
+		bool SweptCapsuleCapsule(const Vector2& start, const Vector2& end, double radius, const Vector2& velocity, const Vector2& otherStart, const Vector2& otherEnd, double otherRadius, double& time, Vector2& normal, Vector2& point)
+		{
+			time = INFINITY;
+			double endTime;
+			Vector2 endNormal;
+			for (const Vector2& origin : { start, end })
 			{
-#ifdef _DEBUG
-				//Draw tiles which are colliding
-				if (collider.visualise)
+				if (RayCapsule(origin, velocity, otherStart, otherEnd, radius + otherRadius, endTime, endNormal) && endTime < time)
 				{
-					Primitive tileCollider = Primitive::Polygon(tileVerts);
-					//tileCollider.Draw(cam, Vector3(255, 0, 0), Transform{ .position = Vector3(tilePosition, 10) });
+					time = endTime;
+					normal = endNormal;
+					point = origin + velocity * endTime - endNormal * radius;
 				}
-#endif
-
-				//If the mtv is facing in to the other collider, flip it
-				Vector3 directionAtoB = transform.position - tilePosition;
-				if (directionAtoB.Dot(collision.mtv) < 0)
-					collision.mtv = Vector2() - collision.mtv;
-
-				//Setup the collision
-				collision.a = entity;
-				collision.b = tileID;
-				collision.type = collisionType;
-
-				collisions.push_back(collision);
 			}
-			else
+			for (const Vector2& origin : { otherStart, otherEnd })
 			{
-#ifdef _DEBUG
-				//Draw tiles inside bounding box
-				if (collider.visualise)
+				if (RayCapsule(origin, Vector2() - velocity, start, end, radius + otherRadius, endTime, endNormal) && endTime < time)
 				{
-					//Vertices of a tile's aabb
-					const std::vector<Vector2> boundingBoxVerts{
-						Vector2(-((float)tilemap->tileSize.x / 2), (float)tilemap->tileSize.y / 2), //Top-Left
-							Vector2((float)tilemap->tileSize.x / 2, (float)tilemap->tileSize.y / 2),  //Top-Right
-							Vector2((float)tilemap->tileSize.x / 2, -((float)tilemap->tileSize.y / 2)), //Bottom-Right
-							Vector2(-((float)tilemap->tileSize.x / 2), -((float)tilemap->tileSize.y / 2)) //Bottom-Left
-					};
-					Primitive tileCollider = Primitive::Polygon(boundingBoxVerts);
-					//tileCollider.Draw(cam, Vector3(0, 255, 0), Transform{ .position = Vector3(tilePosition, 10) });
+					time = endTime;
+					normal = Vector2() - endNormal;
+					point = origin + normal * otherRadius;
 				}
-#endif
 			}
+			if (time == INFINITY)
+				return false;
+
+			//Already overlapping at the start
+			if (normal.x == 0 && normal.y == 0)
+				normal = Vector2() - velocity.Normalize();
+			return true;
 		}
 
-		return collisions;*/
-		return std::vector<Collision>();
-	}
+		//Outline of a capsule for drawing, circles are capsules whose start and end are the same
+		std::vector<Vector2> CapsuleOutline(const Vector2& start, const Vector2& end, double radius)
+		{
+			constexpr int arcSegments = 8;
+			const Vector2 segment = end - start;
+			const double angle = segment.Dot(segment) > 0 ? std::atan2(segment.y, segment.x) : 0;
 
-	///Check Entity-Entity collision. Does not call callbacks
-	Collision CollisionSystem::CheckEntityCollision(ecs::Entity a, ecs::Entity b)
-	{
-		//Check AABB collision first because it's cheaper
-		if (!AABBIntersect(a, b))
-			return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
+			//A half circle around each end, going clockwise
+			std::vector<Vector2> outline;
+			for (int i = 0; i <= arcSegments; i++)
+			{
+				const double arcAngle = angle + PI / 2 - PI * i / arcSegments;
+				outline.push_back(end + Vector2(std::cos(arcAngle), std::sin(arcAngle)) * radius);
+			}
+			for (int i = 0; i <= arcSegments; i++)
+			{
+				const double arcAngle = angle - PI / 2 - PI * i / arcSegments;
+				outline.push_back(start + Vector2(std::cos(arcAngle), std::sin(arcAngle)) * radius);
+			}
+			return outline;
+		}
 
-		//Get relevant components from a and b
-		PolygonCollider& aCollider = ecs::GetComponent<PolygonCollider>(a);
-		PolygonCollider& bCollider = ecs::GetComponent<PolygonCollider>(b);
+		//Call visit with whichever collider component the entity has, returns false if it has none
+		template<typename Visit>
+		bool VisitCollider(ecs::Entity entity, Visit visit)
+		{
+			if (ecs::HasComponent<PolygonCollider>(entity))
+				visit(ecs::GetComponent<PolygonCollider>(entity));
+			else if (ecs::HasComponent<CircleCollider>(entity))
+				visit(ecs::GetComponent<CircleCollider>(entity));
+			else if (ecs::HasComponent<CapsuleCollider>(entity))
+				visit(ecs::GetComponent<CapsuleCollider>(entity));
+			else
+				return false;
+			return true;
+		}
 
-		//If collision layer matrix specifies to ignore, return miss
-		const LayerInteraction collisionInteraction = GetLayerInteraction(aCollider.layer, bCollider.layer);
-		if (collisionInteraction == LayerInteraction::none)
-			return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
+		//Find where the segment origin + time * delta (0-1) enters a convex polygon, and the outwards normal of the edge it enters through
+		//Segments starting inside the polygon enter at time 0 with a zero normal
+		bool RayPolygon(const Vector2& origin, const Vector2& delta, const Vector2* vertices, uint32_t vertexCount, double& time, Vector2& normal)
+		{
+			if (vertexCount < 3)
+				return false;
 
-		//Rotate and scale every vertex of a, movement is handled later
-		Transform aTransform = TransformSystem::GetGlobalTransform(b);
-		if (aCollider.rotationOverride >= 0)
-			aTransform.rotation.z = aCollider.rotationOverride;
-		std::vector<Vector2> aVerts = TransformSystem::ApplyTransforms2D(aCollider.vertices, aTransform);
-		//Rotate and scale every vertex of b, movement is handled later
-		Transform bTransform = TransformSystem::GetGlobalTransform(b);
-		if (bCollider.rotationOverride >= 0)
-			bTransform.rotation.z = bCollider.rotationOverride;
-		std::vector<Vector2> bVerts = TransformSystem::ApplyTransforms2D(bCollider.vertices, bTransform);
+			//Left normals face outwards on clockwise polygons, flip them if the polygon is counter-clockwise
+			double area = 0;
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				const Vector2& next = vertices[i < vertexCount - 1 ? i + 1 : 0];
+				area += vertices[i].x * next.y - next.x * vertices[i].y;
+			}
+			const double facing = area <= 0 ? 1 : -1;
 
-		//Check SAT collision
-		Collision collision = SATIntersect(aVerts, bVerts);
+			double enter = 0;
+			double exit = 1;
+			normal = Vector2();
+			for (uint32_t i = 0; i < vertexCount; i++)
+			{
+				const Vector2 edge = vertices[i < vertexCount - 1 ? i + 1 : 0] - vertices[i];
+				if (edge.x == 0 && edge.y == 0)
+					continue;
+				const Vector2 edgeNormal = edge.LeftNormal() * facing;
 
-		//If there was a collision
-		if (collision.type != Collision::Type::miss)
-		{
-			Collision::Type type = aCollider.trigger || bCollider.trigger ? Collision::Type::trigger : Collision::Type::collision;
+				//Positive when the origin is on the inside of the edge
+				const double distance = edgeNormal.Dot(vertices[i] - origin);
+				const double speed = edgeNormal.Dot(delta);
+				if (speed == 0)
+				{
+					//Parallel to the edge and outside of it
+					if (distance < 0)
+						return false;
+					continue;
+				}
 
-			//Comply with the layer matrix
-			if (collisionInteraction == LayerInteraction::triggers)
-				if (type != Collision::Type::trigger)
-					return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
-			if (collisionInteraction == LayerInteraction::collisions)
-				if (type != Collision::Type::collision)
-					return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
-
-			//If the mtv is facing in to the other collider from a's pov, flip it
-			Vector3 directionAtoB = aTransform.position - bTransform.position;
-			if (directionAtoB.Dot(collision.mtv) < 0)
-				collision.mtv = Vector2() - collision.mtv;
+				const double edgeTime = distance / speed;
+				if (speed < 0)
+				{
+					//Entering through this edge
+					if (edgeTime > enter)
+					{
+						enter = edgeTime;
+						normal = edgeNormal;
+					}
+				}
+				else
+					exit = std::min(exit, edgeTime);
 
-			//Set the proper data for a's collision event
-			Collision aToB;
-			aToB.a = a;
-			aToB.b = b;
-			aToB.type = type;
-			aToB.mtv = collision.mtv;
-			aToB.normal = collision.normal;
-			//Set the proper data for b's collision event
-			Collision bToA;
-			bToA.a = b;
-			bToA.b = a;
-			bToA.type = type;
-			bToA.normal = Vector2() - collision.normal;
-			bToA.mtv = Vector2() - collision.mtv;
+				if (enter > exit)
+					return false;
+			}
 
-			return aToB;
+			time = enter;
+			return true;
+		}
+
+		//Find a point where two touching polygons meet, normal is b's surface normal facing a
+		//Takes the middle of the overlap of the features of a and b closest to each other
+		Vector2 ContactPoint(const PolygonView& a, const Vector2& aOffset, const PolygonView& b, const Vector2& normal)
+		{
+			const Vector2 tangent = normal.LeftNormal();
+			double aDepth = INFINITY;
+			double bDepth = -INFINITY;
+			for (uint32_t i = 0; i < a.vertexCount; i++)
+				aDepth = std::min(aDepth, normal.Dot(a.vertices[i] + aOffset));
+			for (uint32_t i = 0; i < b.vertexCount; i++)
+				bDepth = std::max(bDepth, normal.Dot(b.vertices[i]));
+
+			//Range of the closest vertices of a and b along the contact surface
+			double aMin = INFINITY, aMax = -INFINITY, bMin = INFINITY, bMax = -INFINITY;
+			for (uint32_t i = 0; i < a.vertexCount; i++)
+			{
+				const Vector2 vertex = a.vertices[i] + aOffset;
+				if (normal.Dot(vertex) <= aDepth + epsilon)
+				{
+					aMin = std::min(aMin, tangent.Dot(vertex));
+					aMax = std::max(aMax, tangent.Dot(vertex));
+				}
+			}
+			for (uint32_t i = 0; i < b.vertexCount; i++)
+			{
+				if (normal.Dot(b.vertices[i]) >= bDepth - epsilon)
+				{
+					bMin = std::min(bMin, tangent.Dot(b.vertices[i]));
+					bMax = std::max(bMax, tangent.Dot(b.vertices[i]));
+				}
+			}
 
+			const double middle = (std::max(aMin, bMin) + std::min(aMax, bMax)) / 2;
+			return normal * bDepth + tangent * middle;
 		}
-		return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
-	}
 
-	///Check SAT intersection between two convex polygons, Expects Vertices to have Transforms applied
-	Collision CollisionSystem::SATIntersect(std::vector<Vector2> aVerts, std::vector<Vector2> bVerts)
-	{
-		//Calculate all axes to check
-		std::vector<Vector2> axes;
-		//For each vertice in a
-		for (int i = 0; i < aVerts.size(); i++)
+		//Vertices of a box query going clockwise
+		std::array<Vector2, 4> BoxVertices(const BoxQuery& query)
 		{
-			//Overflow nextVertice to beginning
-			int nextVertice = i < aVerts.size() - 1 ? i + 1 : 0;
-			//Calculate the normal vector to project the other polygon to (left normal because clockwise)
-			Vector2 axis = (aVerts[nextVertice] - aVerts[i]).LeftNormal();
+			const float angle = Radians(query.rotation);
+			const double cos = cosf(angle);
+			const double sin = sinf(angle);
+			std::array<Vector2, 4> vertices{
+				Vector2(-query.halfExtents.x, query.halfExtents.y), Vector2(query.halfExtents.x, query.halfExtents.y),
+				Vector2(query.halfExtents.x, -query.halfExtents.y), Vector2(-query.halfExtents.x, -query.halfExtents.y) };
+			for (Vector2& vertex : vertices)
+				vertex = Vector2(vertex.x * cos - vertex.y * sin, vertex.x * sin + vertex.y * cos) + query.center;
+			return vertices;
+		}
 
-			//If axis is not already in axes
-			if (axes.end() == find_if(axes.begin(), axes.end(), [axis](Vector2& vec) { return axis == vec || axis == Vector2() - vec; }))
-				axes.push_back(axis.Normalize());
+		//Bounds of points, going top, right, bottom, left
+		Bounds PointBounds(const Vector2* points, size_t pointCount, const Vector2& offset = Vector2())
+		{
+			Bounds bounds{ -INFINITY, -INFINITY, INFINITY, INFINITY };
+			for (size_t i = 0; i < pointCount; i++)
+			{
+				for (const Vector2& point : { points[i], points[i] + offset })
+				{
+					bounds[0] = std::max(bounds[0], (float)point.y);
+					bounds[1] = std::max(bounds[1], (float)point.x);
+					bounds[2] = std::min(bounds[2], (float)point.y);
+					bounds[3] = std::min(bounds[3], (float)point.x);
+				}
+			}
+			return bounds;
+		}
 
+		//Area the broadphase is searched in for each kind of query
+		Bounds QueryBounds(const Ray& ray)
+		{
+			const Vector2 points[2]{ ray.origin, ray.origin + ray.direction.Normalize() * ray.maxDistance };
+			return PointBounds(points, 2);
+		}
+		Bounds QueryBounds(const ShapeCastQuery& query)
+		{
+			Bounds bounds = PointBounds(query.polygon.data(), query.polygon.size(), query.direction.Normalize() * query.maxDistance);
+			bounds[0] += query.radius;
+			bounds[1] += query.radius;
+			bounds[2] -= query.radius;
+			bounds[3] -= query.radius;
+			return bounds;
 		}
-		//For each vertice in b
-		for (int i = 0; i < bVerts.size(); i++)
+		Bounds QueryBounds(const BoxQuery& query)
 		{
-			//Overflow nextVertice to beginning
-			int nextVertice = i < bVerts.size() - 1 ? i + 1 : 0;
-			//Calculate the normal vector to project the other polygon to (left normal because clockwise)
-			Vector2 axis = (bVerts[nextVertice] - bVerts[i]).LeftNormal();
+			const std::array<Vector2, 4> vertices = BoxVertices(query);
+			return PointBounds(vertices.data(), vertices.size());
+		}
 
-			//If axis is not already in axes
-			if (axes.end() == find_if(axes.begin(), axes.end(), [axis](Vector2& vec) { return axis == vec || axis == Vector2() - vec; }))
-				axes.push_back(axis.Normalize());
+		//Move points and directions between world space and a tilemap's local space
+		Vector2 TransformPoint(const glm::mat4& matrix, const Vector2& point)
+		{
+			const glm::vec4 transformed = matrix * glm::vec4(point.x, point.y, 0, 1);
+			return Vector2(transformed.x, transformed.y);
+		}
+		Vector2 TransformDirection(const glm::mat4& matrix, const Vector2& direction)
+		{
+			const glm::vec4 transformed = matrix * glm::vec4(direction.x, direction.y, 0, 0);
+			return Vector2(transformed.x, transformed.y);
+		}
+		//Normals need the inverse transpose to stay perpendicular to scaled surfaces
+		Vector2 LocalNormalToWorld(const glm::mat4& worldToLocal, const Vector2& normal)
+		{
+			return TransformDirection(glm::transpose(worldToLocal), normal).Normalize();
 		}
 
-		//Keep track of collision data and mtv axis and magnitude
-		Collision collision;
-		float minOverlap = INFINITY;
-		Vector2 minAxis;
+		//Center of a tile or a box of merged tiles in its tilemap's local space
+		Vector2 TileCenter(const Tilemap& tilemap, const MapLayer::ColliderBox& box)
+		{
+			return Vector2((box.x + box.width / 2.0) * tilemap.tileSize.x, -(box.y + box.height / 2.0) * tilemap.tileSize.y);
+		}
 
-		//For each necesary axis
-		for (Vector2& axis : axes)
+		//Vertices of a tile's collider or a box of merged tiles in its tilemap's local space
+		void TileVertices(const Tilemap& tilemap, const MapLayer::ColliderBox& box, std::vector<Vector2>& vertices)
 		{
-			//Project each vertice of a to axis and calculate it's bounds
-			float aMin = INFINITY;
-			float aMax = -INFINITY;
-			std::vector<float> aProjections;
-			for (Vector2& vertice : aVerts)
+			if (box.width == 1 && box.height == 1)
 			{
-				//Project to axis
-				float projection = axis.Dot(vertice);
-				aProjections.push_back(projection);
-
-				//Get min and max bounds
-				if (projection < aMin)
-					aMin = projection;
-				if (projection > aMax)
-					aMax = projection;
+				const std::span<const Vector2> collider = tilemap.GetTileCollider(box.gid);
+				vertices.assign(collider.begin(), collider.end());
 			}
-			//Project each vertice of b to axis and calculate it's bounds
-			float bMin = INFINITY;
-			float bMax = -INFINITY;
-			std::vector<float> bProjections;
-			for (Vector2& vertice : bVerts)
+			else
 			{
-				//Project to axis
-				float projection = axis.Dot(vertice);
-				bProjections.push_back(projection);
-
-				//Get min and max bounds
-				if (projection < bMin)
-					bMin = projection;
-				if (projection > bMax)
-					bMax = projection;
+				const double halfWidth = box.width * tilemap.tileSize.x / 2.0;
+				const double halfHeight = box.height * tilemap.tileSize.y / 2.0;
+				vertices = { Vector2(-halfWidth, halfHeight), Vector2(halfWidth, halfHeight), Vector2(halfWidth, -halfHeight), Vector2(-halfWidth, -halfHeight) };
 			}
 
-			//The maximum overlap of this axis
-			float maxAxisOverlap = -INFINITY;
-
-			//Did any a or b vertice intersect
-			bool hit = false;
+			const Vector2 center = TileCenter(tilemap, box);
+			for (Vector2& vertex : vertices)
+				vertex += center;
+		}
 
-			//Check a to b overlap
-			for (float aProjection : aProjections)
+		//Call visit(box, layer) for every box of merged tiles and every other collision tile in a rectangle of a tilemap's local space, layer is the index in mapLayers
+		//Tiles which aren't merged are visited as boxes of one tile, and a box only once at its first tile in the rectangle
+		template<typename Visit>
+		void ForEachTile(const Tilemap& tilemap, const Bounds& localBounds, Visit visit)
+		{
+			//Tile y coordinates grow downwards
+			const int64_t minX = (int64_t)std::floor(localBounds[3] / tilemap.tileSize.x);
+			const int64_t maxX = (int64_t)std::floor(localBounds[1] / tilemap.tileSize.x);
+			const int64_t minY = (int64_t)std::floor(-localBounds[0] / tilemap.tileSize.y);
+			const int64_t maxY = (int64_t)std::floor(-localBounds[2] / tilemap.tileSize.y);
+
+			//Only the tiles in the rectangle are visited, row by row through the row-major grid
+			for (uint32_t layerIndex = 0; layerIndex < tilemap.mapLayers.size(); layerIndex++)
 			{
-				//Vertice is intersecting b bounds
-				if (aProjection < bMax && aProjection > bMin)
+				const MapLayer* layer = tilemap.mapLayers[layerIndex];
+				if (!layer->hasCollision || layer->tiles.empty())
+					continue;
+				const bool merged = layer->tileBoxes.size() == layer->tiles.size();
+				const int64_t startX = std::max<int64_t>(minX, 0);
+				const int64_t endX = std::min<int64_t>(maxX, layer->width - 1);
+				const int64_t startY = std::max<int64_t>(minY, 0);
+				for (int64_t y = startY; y <= std::min<int64_t>(maxY, layer->height - 1); y++)
 				{
-					float overlap = std::min(abs(aProjection - bMin), abs(aProjection - bMax));
-
-					//Hit confirmed
-					hit = true;
-
-					//Get the maximum overlap on this axis
-					if (overlap > maxAxisOverlap)
-						maxAxisOverlap = overlap;
+					const uint32_t* row = layer->tiles.data() + y * layer->width;
+					const uint32_t* boxRow = merged ? layer->tileBoxes.data() + y * layer->width : nullptr;
+					for (int64_t x = startX; x <= endX; x++)
+					{
+						if (row[x] == 0)
+							continue;
+						if (boxRow && boxRow[x] != 0)
+						{
+							const MapLayer::ColliderBox& box = layer->colliderBoxes[boxRow[x] - 1];
+							if (x == std::max<int64_t>(box.x, startX) && y == std::max<int64_t>(box.y, startY))
+								visit(box, layerIndex);
+						}
+						else
+							visit(MapLayer::ColliderBox{ (uint32_t)x, (uint32_t)y, 1, 1, row[x] }, layerIndex);
+					}
 				}
 			}
-			//Check b to a overlap
-			for (float bProjection : bProjections)
+		}
+
+		//Call visit(x, y, time) for every cell of a width by height grid the segment start + time * delta (0-1) passes through, in order, until visit returns false
+		template<typename Visit>
+		void TraverseCells(const Vector2& start, const Vector2& delta, int64_t width, int64_t height, Visit visit)
+		{
+			//Clip the segment to the grid
+			double minTime = 0;
+			double maxTime = 1;
+			for (int axis = 0; axis < 2; axis++)
 			{
-				//Vertice is intersecting b bounds
-				if (bProjection < aMax && bProjection > aMin)
+				const double size = axis == 0 ? width : height;
+				if (delta[axis] == 0)
 				{
-					float overlap = std::min(abs(bProjection - aMin), abs(bProjection - aMax));
-
-					//Hit confirmed
-					hit = true;
-
-					//Get the maximum overlap on this axis
-					if (overlap > maxAxisOverlap)
-						maxAxisOverlap = overlap;
+					if (start[axis] < 0 || start[axis] > size)
+						return;
+					continue;
 				}
+
+				double enter = -start[axis] / delta[axis];
+				double exit = (size - start[axis]) / delta[axis];
+				if (enter > exit)
+					std::swap(enter, exit);
+				minTime = std::max(minTime, enter);
+				maxTime = std::min(maxTime, exit);
+				if (minTime > maxTime)
+					return;
 			}
 
-			//If any axis misses there is no collision
-			if (!hit)
+			//Step from cell to cell through whichever edge the segment crosses first
+			const Vector2 entry = start + delta * minTime;
+			int64_t cell[2]{ std::clamp<int64_t>((int64_t)std::floor(entry.x), 0, width - 1), std::clamp<int64_t>((int64_t)std::floor(entry.y), 0, height - 1) };
+			int64_t step[2];
+			double nextTime[2];
+			double stepTime[2];
+			for (int axis = 0; axis < 2; axis++)
 			{
-				collision.type = Collision::Type::miss;
-				return collision;
+				step[axis] = delta[axis] > 0 ? 1 : -1;
+				nextTime[axis] = delta[axis] != 0 ? (cell[axis] + (step[axis] > 0) - start[axis]) / delta[axis] : INFINITY;
+				stepTime[axis] = delta[axis] != 0 ? std::abs(1 / delta[axis]) : INFINITY;
 			}
 
-			//If this axis had the smallest overlap
-			if (maxAxisOverlap < minOverlap)
+			double time = minTime;
+			while (visit(cell[0], cell[1], time))
 			{
-				minOverlap = maxAxisOverlap;
-				minAxis = axis;
+				const int axis = nextTime[0] < nextTime[1] ? 0 : 1;
+				if (nextTime[axis] > maxTime)
+					return;
+				time = nextTime[axis];
+				cell[axis] += step[axis];
+				nextTime[axis] += stepTime[axis];
+				if (cell[axis] < 0 || cell[axis] >= (axis == 0 ? width : height))
+					return;
 			}
 		}
-
-		//Collided
-		collision.mtv = minAxis.Normalize() * minOverlap;
-		collision.normal = minAxis.Normalize();
-		collision.type = Collision::Type::collision;
-		return collision;
 	}
 
-	///Checks if a and b bounds are intersecting
-	bool CollisionSystem::AABBIntersect(ecs::Entity a, ecs::Entity b)
+	///Called every frame, detects collisions and dispatches their events to the callbacks
+	void CollisionSystem::Update()
 	{
-		//Get the bounds
-		std::array<float, 4>& aBounds = ecs::GetComponent<PolygonCollider>(a).bounds;
-		std::array<float, 4>& bBounds = ecs::GetComponent<PolygonCollider>(b).bounds;
+		DetectCollisions();
+
+		//Collect the events of every pair first, so callbacks can safely move or destroy entities
+		events.clear();
+		GenerateEvents(contactPairs);
+		GenerateEvents(tileContactPairs);
+		//Keep the order independent of the hash maps, a pair which began and ended keeps its begin first
+		std::stable_sort(events.begin(), events.end(), [](const Collision& lhs, const Collision& rhs)
+			{
+				if (lhs.a != rhs.a || lhs.b != rhs.b)
+					return lhs.a != rhs.a ? lhs.a < rhs.a : lhs.b < rhs.b;
+				return lhs.tileLayer != rhs.tileLayer ? lhs.tileLayer < rhs.tileLayer : lhs.tileIndex < rhs.tileIndex;
+			});
 
-		//Perform AABB intersect
-		return (aBounds[3] < bBounds[1] && aBounds[1] > bBounds[3] && aBounds[2] < bBounds[0] && aBounds[0] > bBounds[2]);
+		//Call a's and b's callbacks, tiles don't have callbacks
+		for (const Collision& event : events)
+		{
+			std::function<void(Collision)> callback;
+			if (ecs::EntityExists(event.a))
+				VisitCollider(event.a, [&callback](auto& collider) { callback = collider.callback; });
+			if (callback)
+				callback(event);
+
+			if (event.type == Collision::Type::tilemapCollision || event.type == Collision::Type::tilemapTrigger)
+				continue;
+			callback = nullptr;
+			if (ecs::EntityExists(event.b))
+				VisitCollider(event.b, [&callback](auto& collider) { callback = collider.callback; });
+			if (callback)
+				callback(event.Reversed());
+		}
+
+		//Draw the bounding box and collider
+		ForEachCollider([this](ecs::Entity entity)
+			{
+				bool visualise = false;
+				VisitCollider(entity, [&visualise](auto& collider) { visualise = collider.visualise; });
+				if (!visualise)
+					return;
+
+				//The vertices of the collider are already cached in world coordinates
+				const ColliderGeometry& cache = GetGeometry(entity);
+				const PolygonView polygon = ToPolygon(cache);
+
+				//Collider
+				std::vector<Vector2> colliderVerts;
+				if (cache.shape == Shape::polygon)
+					colliderVerts.assign(polygon.vertices, polygon.vertices + polygon.vertexCount);
+				else
+					colliderVerts = CapsuleOutline(polygon.vertices[0], polygon.vertices[polygon.vertexCount - 1], cache.radius);
+				debug::DrawPolygon(colliderVerts, Color::Red(), true, cache.position.z);
+				//AABB
+				const Bounds& bounds = cache.bounds;
+				std::vector<Vector2> boundingBoxVerts{
+					Vector2(bounds[3], bounds[0]), Vector2(bounds[1], bounds[0]),
+					Vector2(bounds[1], bounds[2]), Vector2(bounds[3], bounds[2]) };
+				debug::DrawPolygon(boundingBoxVerts, Color::Green(), true, cache.position.z);
+			});
 	}
 
-	///Update the AABB of the polygon collider
-	void CollisionSystem::UpdateAABB(ecs::Entity entity)
+	///Find the contacts of every collider which has moved since the last detection, and update the persistent contact pairs
+	void CollisionSystem::DetectCollisions()
 	{
-		PolygonCollider& collider = ecs::GetComponent<PolygonCollider>(entity);
+		InvalidateEditedTiles();
 
-		//Bounds go top, right, bottom, left
-		std::array<float, 4> bounds{ -INFINITY, -INFINITY, INFINITY, INFINITY };
+		//Refresh the geometry of colliders whose transform might have changed, UpdateAABB queues the ones which actually moved
+		ForEachCollider([this](ecs::Entity entity)
+			{
+				if (ecs::GetComponent<Transform>(entity).staleCache || !broadphase->Contains(entity))
+					UpdateAABB(entity);
+			});
+		//Removed colliders may have been queued before they were removed
+		std::erase_if(movedColliders, [this](ecs::Entity entity) { return !geometry.contains(entity); });
+		std::sort(movedColliders.begin(), movedColliders.end());
+		std::sort(removedColliders.begin(), removedColliders.end());
+
+		//Pairs with a moved or removed collider need to be found again, those that aren't stop touching
+		auto isStale = [this](ecs::Entity entity)
+			{
+				auto it = geometry.find(entity);
+				return it == geometry.end() || it->second.moved;
+			};
+		for (auto& [key, pair] : contactPairs)
+		{
+			if (isStale(key >> 32) || isStale((uint32_t)key))
+				pair.touching = false;
+		}
+		for (auto& [key, pair] : tileContactPairs)
+		{
+			if (isStale(key.entity))
+				pair.touching = false;
+		}
 
-		//Apply transforms to collider vertices
-		Transform globalTf = TransformSystem::GetGlobalTransform(entity);
-		if (collider.rotationOverride >= 0)
-			globalTf.rotation.z = collider.rotationOverride;
-		std::vector<Vector2> transformedVerts = TransformSystem::ApplyTransforms2D(collider.vertices, globalTf);
+		//Find the broadphase pairs of every moved collider, each pair only once
+		broadphasePairs.clear();
+		for (ecs::Entity a : movedColliders)
+		{
+			//Colliders on layers a doesn't interact with are rejected by the broadphase
+			const ColliderGeometry& cache = geometry[a];
+			candidates.clear();
+			broadphase->Query(cache.bounds, candidates, collisionMasks[cache.layer] | triggerMasks[cache.layer]);
+			for (ecs::Entity b : candidates)
+			{
+				if (a != b)
+					broadphasePairs.emplace_back(std::min(a, b), std::max(a, b));
+			}
+		}
+		std::sort(broadphasePairs.begin(), broadphasePairs.end());
+		broadphasePairs.erase(std::unique(broadphasePairs.begin(), broadphasePairs.end()), broadphasePairs.end());
+
+		//Narrowphase every pair once, spread over the thread pool. Each thread only reads the geometry cache and writes to its own buffer
+		ThreadPool& threadPool = GetThreadPool();
+		threadContacts.resize(threadPool.GetThreadCount());
+		for (std::vector<Collision>& buffer : threadContacts)
+			buffer.clear();
+		threadPool.ParallelFor(broadphasePairs.size(), narrowphaseChunkSize, [this](size_t begin, size_t end, unsigned int threadIndex)
+			{
+				std::vector<Collision>& buffer = threadContacts[threadIndex];
+				for (size_t i = begin; i < end; i++)
+				{
+					const auto& [a, b] = broadphasePairs[i];
+					const Collision collision = CollideGeometry(a, b, geometry.find(a)->second, geometry.find(b)->second);
+					if (collision.type != Collision::Type::miss)
+						buffer.push_back(collision);
+				}
+			});
 
-		//For each vertice calculate min and max bounds
-		for (const Vector2& transformedVert : transformedVerts)
+		//Merge the buffers back in pair order, so the contacts don't depend on the thread count or on which thread got which pairs
+		contacts.clear();
+		for (const std::vector<Collision>& buffer : threadContacts)
+			contacts.insert(contacts.end(), buffer.begin(), buffer.end());
+		std::sort(contacts.begin(), contacts.end(), [](const Collision& lhs, const Collision& rhs)
+			{
+				return lhs.a != rhs.a ? lhs.a < rhs.a : lhs.b < rhs.b;
+			});
+		for (const Collision& collision : contacts)
 		{
-			//Calculate bounds
-			//Top bound
-			if (transformedVert.y > bounds[0])
-				bounds[0] = transformedVert.y;
-			//Right bound
-			if (transformedVert.x > bounds[1])
-				bounds[1] = transformedVert.x;
-			//Bottom bound
-			if (transformedVert.y < bounds[2])
-				bounds[2] = transformedVert.y;
-			//Left bound
-			if (transformedVert.x < bounds[3])
-				bounds[3] = transformedVert.x;
+			ContactPair& pair = contactPairs[PairKey(collision.a, collision.b)];
+			pair.collision = collision;
+			pair.touching = true;
 		}
 
-		collider.bounds = bounds;
-	}
+		//Tilemap contacts of every moved collider
+		tilemapContacts.clear();
+		GatherQueryTilemaps();
+		if (!queryTilemaps.empty())
+		{
+			for (ecs::Entity entity : movedColliders)
+				CollideTiles(entity, geometry[entity], tilemapContacts);
+		}
+		for (const Collision& collision : tilemapContacts)
+		{
+			ContactPair& pair = tileContactPairs[TilePairKey{ collision.a, collision.b, collision.tileLayer, collision.tileIndex }];
+			pair.collision = collision;
+			pair.touching = true;
+		}
 
-	//Set the collision layer of a tile id
-	inline void CollisionSystem::SetTileCollisionLayer(unsigned int tileID, int layer)
-	{
-		tileIDTolayer[tileID] = layer;
-	}
-	//Get the collision layer of a tile id, defaults to 0
-	inline int CollisionSystem::GetTileCollisionLayer(unsigned int tileID)
-	{
-		return tileIDTolayer[tileID];
+		for (ecs::Entity entity : movedColliders)
+			geometry[entity].moved = false;
+		movedColliders.clear();
+		removedColliders.clear();
 	}
-	//Sets the interaction state between two layers
-	inline void CollisionSystem::SetLayerInteraction(int layer1, int layer2, LayerInteraction interaction)
+
+	///Queue the colliders around tiles changed with Tilemap::SetTiles for the next DetectCollisions and wake up their bodies
+	void CollisionSystem::InvalidateEditedTiles()
 	{
-		layerCollisionMatrix[layer1][layer2] = interaction;
-		layerCollisionMatrix[layer2][layer1] = interaction;
-	}
-	//Get the interaction type between two collision layers
-	inline CollisionSystem::LayerInteraction CollisionSystem::GetLayerInteraction(int layer1, int layer2)
+		//Every entity using a tilemap gets its rectangles, not only the first one to take them
+		std::vector<std::pair<Tilemap*, std::vector<Tilemap::TileRect>>> editedTilemaps;
+		for (ecs::Entity entity : ecs::GetSystem<TilemapCollisionSystem>()->entities)
+		{
+			Tilemap* tilemap = ecs::GetComponent<TilemapCollider>(entity).tilemap;
+			if (!tilemap || std::any_of(editedTilemaps.begin(), editedTilemaps.end(), [tilemap](const auto& edited) { return edited.first == tilemap; }))
+				continue;
+			std::vector<Tilemap::TileRect> rects;
+			tilemap->TakeEditedRects(rects);
+			if (!rects.empty())
+				editedTilemaps.emplace_back(tilemap, std::move(rects));
+		}
+		if (editedTilemaps.empty())
+			return;
+
+		for (ecs::Entity entity : ecs::GetSystem<TilemapCollisionSystem>()->entities)
+		{
+			const Tilemap* tilemap = ecs::GetComponent<TilemapCollider>(entity).tilemap;
+			auto edited = std::find_if(editedTilemaps.begin(), editedTilemaps.end(), [tilemap](const auto& edited) { return edited.first == tilemap; });
+			if (edited == editedTilemaps.end())
+				continue;
+
+			const glm::mat4 localToWorld = TransformSystem::GetGlobalTransformMatrix(entity);
+			for (const Tilemap::TileRect& rect : edited->second)
+			{
+				//A tile around the rectangle too, so colliders resting against the changed tiles are found. Tile y coordinates grow downwards
+				const float left = (float)(rect.start.x - 1) * tilemap->tileSize.x;
+				const float right = (float)(rect.end.x + 1) * tilemap->tileSize.x;
+				const float top = -(float)(rect.start.y - 1) * tilemap->tileSize.y;
+				const float bottom = -(float)(rect.end.y + 1) * tilemap->tileSize.y;
+				Bounds bounds{ -INFINITY, -INFINITY, INFINITY, INFINITY };
+				for (const glm::vec4& corner : { glm::vec4(left, top, 0, 1), glm::vec4(right, top, 0, 1), glm::vec4(right, bottom, 0, 1), glm::vec4(left, bottom, 0, 1) })
+				{
+					const glm::vec4 world = localToWorld * corner;
+					bounds = { std::max(bounds[0], world.y), std::max(bounds[1], world.x), std::min(bounds[2], world.y), std::min(bounds[3], world.x) };
+				}
+
+				candidates.clear();
+				broadphase->Query(bounds, candidates);
+				for (ecs::Entity candidate : candidates)
+				{
+					auto cache = geometry.find(candidate);
+					if (cache != geometry.end() && !cache->second.moved)
+					{
+						cache->second.moved = true;
+						movedColliders.push_back(candidate);
+					}
+					if (ecs::HasComponent<Rigidbody>(candidate))
+						PhysicsSystem::WakeUp(candidate);
+				}
+			}
+		}
+	}
+
+	///Get the entity contacts found by the last DetectCollisions, from the perspective of the smaller entity and sorted by entity
+	const std::vector<Collision>& CollisionSystem::GetContacts() const
+	{
+		return contacts;
+	}
+
+	///Get the tilemap contacts found by the last DetectCollisions, sorted by entity
+	const std::vector<Collision>& CollisionSystem::GetTilemapContacts() const
+	{
+		return tilemapContacts;
+	}
+
+	///Get the latest contact between two touching entities, including pairs which weren't tested again because neither moved. Returns null if they aren't touching
+	const Collision* CollisionSystem::GetContact(ecs::Entity a, ecs::Entity b) const
+	{
+		auto it = contactPairs.find(PairKey(a, b));
+		return it != contactPairs.end() && it->second.touching ? &it->second.collision : nullptr;
+	}
+
+	///Hash a tile pair, mixing the fields so the neighbouring tiles a collider touches spread over the buckets
+	size_t CollisionSystem::TilePairKeyHash::operator()(const TilePairKey& key) const
+	{
+		uint64_t hash = ((uint64_t)key.entity << 32 | key.tilemap) * 0x9E3779B97F4A7C15ull;
+		hash ^= ((uint64_t)key.layer << 32 | key.tile) + 0x632BE59BD9B4E019ull + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+
+	///Append the begin, stay and end events of the pairs to events, and forget the pairs which have ended
+	template<typename Pairs>
+	void CollisionSystem::GenerateEvents(Pairs& pairs)
+	{
+		for (auto it = pairs.begin(); it != pairs.end();)
+		{
+			ContactPair& pair = it->second;
+			Collision event = pair.collision;
+
+			//Pairs which touched in between frames still get a begin event
+			if (!pair.reported)
+			{
+				event.state = Collision::State::begin;
+				events.push_back(event);
+				pair.reported = true;
+			}
+			else if (pair.touching)
+			{
+				event.state = Collision::State::stay;
+				events.push_back(event);
+			}
+
+			if (!pair.touching)
+			{
+				event.state = Collision::State::end;
+				events.push_back(event);
+				it = pairs.erase(it);
+			}
+			else
+				it++;
+		}
+	}
+
+	///Destructor for the PolygonCollider component, removes the entity from the broadphase and geometry cache
+	void CollisionSystem::OnColliderRemoved(ecs::Entity entity, PolygonCollider& collider)
+	{
+		RemoveCollider(entity);
+	}
+
+	///Destructor for the CircleCollider component, removes the entity from the broadphase and geometry cache
+	void CollisionSystem::OnCircleColliderRemoved(ecs::Entity entity, CircleCollider& collider)
+	{
+		RemoveCollider(entity);
+	}
+
+	///Destructor for the CapsuleCollider component, removes the entity from the broadphase and geometry cache
+	void CollisionSystem::OnCapsuleColliderRemoved(ecs::Entity entity, CapsuleCollider& collider)
+	{
+		RemoveCollider(entity);
+	}
+
+	///Does the entity have a polygon, circle or capsule collider
+	bool CollisionSystem::HasCollider(ecs::Entity entity)
+	{
+		return ecs::HasComponent<PolygonCollider>(entity) || ecs::HasComponent<CircleCollider>(entity) || ecs::HasComponent<CapsuleCollider>(entity);
+	}
+
+	///Remove a collider of any type from the broadphase and geometry cache
+	void CollisionSystem::RemoveCollider(ecs::Entity entity)
+	{
+		std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+		collisionSystem->broadphase->Remove(entity);
+		collisionSystem->removedColliders.push_back(entity);
+
+		auto it = collisionSystem->geometry.find(entity);
+		if (it != collisionSystem->geometry.end())
+		{
+			collisionSystem->unusedGeometry += it->second.capacity;
+			collisionSystem->geometry.erase(it);
+		}
+	}
+
+	///Checks collision between entity a and every other entity and tilemap, Returns the collisions from the perspective of a. Does not call callbacks
+	std::vector<Collision> CollisionSystem::CheckCollision(ecs::Entity a)
+	{
+		//Check tilemap collision
+		std::vector<Collision> collisions = CheckTilemapCollision(a);
+
+		//Get the entities whose bounds might overlap a and whose layers interact with a's from the broadphase
+		const ColliderGeometry& aGeometry = GetGeometry(a);
+		const int layer = aGeometry.layer;
+		const Bounds bounds = aGeometry.bounds;
+		candidates.clear();
+		broadphase->Query(bounds, candidates, collisionMasks[layer] | triggerMasks[layer]);
+		//Sort so that the results don't depend on the broadphase in use
+		std::sort(candidates.begin(), candidates.end());
+
+		//For each potentially colliding entity
+		for (ecs::Entity b : candidates)
+		{
+			//Don't collide with self
+			if (a == b)
+				continue;
+
+			Collision collision = CheckEntityCollision(a, b);
+			if (collision.type != Collision::Type::miss)
+				collisions.push_back(collision);
+		}
+
+		return collisions;
+	}
+
+	///Checks for collision between the collision tiles of every tilemap and an entity, one collision per box of merged tiles or other tile. Does not call callbacks
+	std::vector<Collision> CollisionSystem::CheckTilemapCollision(ecs::Entity entity)
+	{
+		std::vector<Collision> collisions;
+		if (!HasCollider(entity))
+			return collisions;
+
+		GatherQueryTilemaps();
+		CollideTiles(entity, GetGeometry(entity), collisions);
+		return collisions;
+	}
+
+	///Append the collisions between a collider and the tiles of the gathered tilemaps, one per box of merged tiles or other tile from the perspective of the collider
+	void CollisionSystem::CollideTiles(ecs::Entity entity, const ColliderGeometry& cache, std::vector<Collision>& collisions) const
+	{
+		const uint32_t layerBit = 1u << cache.layer;
+		const Vector2* points = geometryVertices.data() + cache.offset;
+
+		std::vector<Vector2> localPoints;
+		std::vector<Vector2> tileVertices;
+		for (const QueryTilemap& map : queryTilemaps)
+		{
+			if (map.entity == entity)
+				continue;
+
+			//Test in the tilemap's local space, where the tiles are axis aligned and only the tiles under the collider's bounds are visited
+			const Tilemap& tilemap = *map.tilemap;
+			localPoints.resize(cache.vertexCount);
+			for (uint32_t i = 0; i < cache.vertexCount; i++)
+				localPoints[i] = TransformPoint(map.worldToLocal, points[i]);
+			PolygonAxes localAxes;
+			const PolygonView localPolygon = localAxes.View(localPoints.data(), cache.shape == Shape::polygon ? cache.vertexCount : 0);
+			const Vector2 localCenter = TransformPoint(map.worldToLocal, cache.position);
+			//Circles and capsules stay round as long as the tilemap is scaled evenly
+			const double localRadius = TransformDirection(map.worldToLocal, Vector2(cache.radius, 0)).Length();
+			Bounds localBounds = PointBounds(localPoints.data(), localPoints.size());
+			localBounds[0] += localRadius;
+			localBounds[1] += localRadius;
+			localBounds[2] -= localRadius;
+			localBounds[3] -= localRadius;
+
+			ForEachTile(tilemap, localBounds, [&](const MapLayer::ColliderBox& box, uint32_t layer)
+				{
+					//Comply with the layer matrix
+					const uint32_t gid = box.gid;
+					const int tileLayer = GetTileCollisionLayer(gid);
+					const bool trigger = cache.trigger || IsTileTrigger(gid);
+					if (!((trigger ? triggerMasks[tileLayer] : collisionMasks[tileLayer]) & layerBit))
+						return;
+
+					TileVertices(tilemap, box, tileVertices);
+					PolygonAxes tileAxes;
+					const PolygonView tile = tileAxes.View(tileVertices.data(), tileVertices.size());
+					Collision collision;
+					if (cache.shape == Shape::polygon)
+					{
+						collision = SATIntersect(localPolygon, tile);
+						//If the mtv is facing in to the tile, flip it
+						if (collision.type != Collision::Type::miss && (localCenter - TileCenter(tilemap, box)).Dot(collision.mtv) < 0)
+							collision.mtv = Vector2() - collision.mtv;
+					}
+					else
+						collision = CapsulePolygonIntersect(localPoints[0], localPoints[cache.vertexCount - 1], localRadius, tile);
+					if (collision.type == Collision::Type::miss)
+						return;
+
+					//Back to world space, the mtv and normal push the collider out of the tile
+					const Vector2 mtv = TransformDirection(map.localToWorld, collision.mtv);
+					collisions.push_back(Collision{
+						.type = trigger ? Collision::Type::tilemapTrigger : Collision::Type::tilemapCollision,
+						.a = entity,
+						.b = map.entity,
+						.tileGID = gid,
+						.tileLayer = layer,
+						.tileIndex = box.y * tilemap.mapLayers[layer]->width + box.x,
+						.point = TransformPoint(map.localToWorld, collision.point),
+						.normal = mtv.Normalize(),
+						.mtv = mtv });
+				});
+		}
+	}
+
+	///Check Entity-Entity collision. Does not call callbacks
+	Collision CollisionSystem::CheckEntityCollision(ecs::Entity a, ecs::Entity b)
+	{
+		//Get the cached world space geometry of a and b
+		const ColliderGeometry& aGeometry = GetGeometry(a);
+		const ColliderGeometry& bGeometry = GetGeometry(b);
+		return CollideGeometry(a, b, aGeometry, bGeometry);
+	}
+
+	///Check collision between the cached geometry of two colliders. Only reads the cache, so pairs can be checked from several threads at once
+	Collision CollisionSystem::CollideGeometry(ecs::Entity a, ecs::Entity b, const ColliderGeometry& aGeometry, const ColliderGeometry& bGeometry) const
+	{
+		//Check AABB collision first because it's cheaper
+		const Bounds& aBounds = aGeometry.bounds;
+		const Bounds& bBounds = bGeometry.bounds;
+		if (!(aBounds[3] < bBounds[1] && aBounds[1] > bBounds[3] && aBounds[2] < bBounds[0] && aBounds[0] > bBounds[2]))
+			return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
+
+		//If collision layer matrix specifies to ignore, return miss
+		const uint32_t bLayerBit = 1u << bGeometry.layer;
+		if (!((collisionMasks[aGeometry.layer] | triggerMasks[aGeometry.layer]) & bLayerBit))
+			return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
+
+		//Check SAT or closed form collision, depending on the shapes
+		Collision collision = IntersectGeometry(aGeometry, bGeometry);
+
+		//If there was a collision
+		if (collision.type != Collision::Type::miss)
+		{
+			Collision::Type type = aGeometry.trigger || bGeometry.trigger ? Collision::Type::trigger : Collision::Type::collision;
+
+			//Comply with the layer matrix
+			const uint32_t typeMask = type == Collision::Type::trigger ? triggerMasks[aGeometry.layer] : collisionMasks[aGeometry.layer];
+			if (!(typeMask & bLayerBit))
+				return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
+
+			//Set the proper data for a's collision event
+			Collision aToB;
+			aToB.a = a;
+			aToB.b = b;
+			aToB.type = type;
+			aToB.point = collision.point;
+			aToB.mtv = collision.mtv;
+			aToB.normal = collision.normal;
+
+			return aToB;
+
+		}
+		return Collision{ .type = Collision::Type::miss, .a = a, .b = b };
+	}
+
+	///Intersect the cached geometry of two colliders of any shape, the mtv pushes a out of b
+	Collision CollisionSystem::IntersectGeometry(const ColliderGeometry& a, const ColliderGeometry& b) const
+	{
+		//Circles and capsules have closed form tests
+		const Vector2* aPoints = geometryVertices.data() + a.offset;
+		const Vector2* bPoints = geometryVertices.data() + b.offset;
+		if (a.shape != Shape::polygon && b.shape != Shape::polygon)
+			return CapsuleIntersect(aPoints[0], aPoints[a.vertexCount - 1], a.radius, bPoints[0], bPoints[b.vertexCount - 1], b.radius);
+		if (a.shape != Shape::polygon)
+			return CapsulePolygonIntersect(aPoints[0], aPoints[a.vertexCount - 1], a.radius, ToPolygon(b));
+		if (b.shape != Shape::polygon)
+			return CapsulePolygonIntersect(bPoints[0], bPoints[b.vertexCount - 1], b.radius, ToPolygon(a)).Reversed();
+
+		Collision collision = SATIntersect(ToPolygon(a), ToPolygon(b));
+		//If the mtv is facing in to the other collider from a's pov, flip it
+		Vector3 directionAtoB = a.position - b.position;
+		if (collision.type != Collision::Type::miss && directionAtoB.Dot(collision.mtv) < 0)
+			collision.mtv = Vector2() - collision.mtv;
+		return collision;
+	}
+
+	///Check SAT intersection between two convex polygons, Expects Vertices to have Transforms applied
+	Collision CollisionSystem::SATIntersect(const std::vector<Vector2>& aVerts, const std::vector<Vector2>& bVerts)
+	{
+		//Calculate the axes of both polygons, small polygons use fixed size buffers so nothing is allocated
+		std::array<Vector2, fixedPolygonCapacity> aFixedAxes;
+		std::array<Vector2, fixedPolygonCapacity> bFixedAxes;
+		std::vector<Vector2> aLargeAxes;
+		std::vector<Vector2> bLargeAxes;
+		Vector2* aAxes = aFixedAxes.data();
+		Vector2* bAxes = bFixedAxes.data();
+		if (aVerts.size() > fixedPolygonCapacity)
+		{
+			aLargeAxes.resize(aVerts.size());
+			aAxes = aLargeAxes.data();
+		}
+		if (bVerts.size() > fixedPolygonCapacity)
+		{
+			bLargeAxes.resize(bVerts.size());
+			bAxes = bLargeAxes.data();
+		}
+
+		const PolygonView a{ aVerts.data(), (uint32_t)aVerts.size(), aAxes, CalculateAxes(aVerts.data(), aVerts.size(), aAxes) };
+		const PolygonView b{ bVerts.data(), (uint32_t)bVerts.size(), bAxes, CalculateAxes(bVerts.data(), bVerts.size(), bAxes) };
+
+		return SATIntersect(a, b);
+	}
+
+	///Check SAT intersection between two convex polygons with precalculated axes. Does not allocate
+	Collision CollisionSystem::SATIntersect(const PolygonView& a, const PolygonView& b)
+	{
+		//Keep track of collision data and mtv axis and magnitude
+		Collision collision;
+		collision.type = Collision::Type::miss;
+		double minOverlap = INFINITY;
+		Vector2 minAxis;
+
+		//For each axis of a, and each axis of b which isn't parallel to an axis of a
+		for (uint32_t i = 0; i < a.axisCount + b.axisCount; i++)
+		{
+			const Vector2& axis = i < a.axisCount ? a.axes[i] : b.axes[i - a.axisCount];
+			if (i >= a.axisCount && ContainsParallelAxis(a.axes, a.axisCount, axis))
+				continue;
+
+			//Project both polygons to axis
+			double aMin, aMax, bMin, bMax;
+			ProjectPolygon(a.vertices, a.vertexCount, axis, aMin, aMax);
+			ProjectPolygon(b.vertices, b.vertexCount, axis, bMin, bMax);
+
+			//If any axis separates the projections there is no collision
+			const double overlap = std::min(aMax - bMin, bMax - aMin);
+			if (overlap <= 0)
+				return collision;
+
+			//If this axis had the smallest overlap
+			if (overlap < minOverlap)
+			{
+				minOverlap = overlap;
+				minAxis = axis;
+			}
+		}
+
+		//Degenerate polygons without any axes never collide
+		if (minOverlap == INFINITY)
+			return collision;
+
+		//Collided
+		collision.mtv = minAxis * minOverlap;
+		collision.normal = minAxis;
+		collision.type = Collision::Type::collision;
+		return collision;
+	}
+
+	///Find when convex polygon a moving by velocity first touches convex polygon b
+	bool CollisionSystem::SweptSATIntersect(const PolygonView& a, const Vector2& velocity, const PolygonView& b, double& time, Vector2& normal)
+	{
+		//On every axis the projections overlap during an interval of time, the polygons touch when all the intervals overlap
+		double enter = -INFINITY;
+		double exit = INFINITY;
+		bool hasAxis = false;
+		for (uint32_t i = 0; i < a.axisCount + b.axisCount; i++)
+		{
+			const Vector2& axis = i < a.axisCount ? a.axes[i] : b.axes[i - a.axisCount];
+			if (i >= a.axisCount && ContainsParallelAxis(a.axes, a.axisCount, axis))
+				continue;
+			hasAxis = true;
+
+			double aMin, aMax, bMin, bMax;
+			ProjectPolygon(a.vertices, a.vertexCount, axis, aMin, aMax);
+			ProjectPolygon(b.vertices, b.vertexCount, axis, bMin, bMax);
+			const double speed = velocity.Dot(axis);
+
+			//Not moving on this axis, so the projections either always or never overlap
+			if (std::abs(speed) < epsilon * epsilon)
+			{
+				if (aMax <= bMin || bMax <= aMin)
+					return false;
+				continue;
+			}
+
+			double axisEnter = (bMin - aMax) / speed;
+			double axisExit = (bMax - aMin) / speed;
+			if (axisEnter > axisExit)
+				std::swap(axisEnter, axisExit);
+
+			//The last axis to start overlapping is the one they touch on, facing against the movement
+			if (axisEnter > enter)
+			{
+				enter = axisEnter;
+				normal = speed > 0 ? Vector2() - axis : axis;
+			}
+			exit = std::min(exit, axisExit);
+			if (enter > exit || exit <= 0 || enter > 1)
+				return false;
+		}
+
+		//Degenerate polygons without any axes never collide
+		if (!hasAxis || enter == -INFINITY)
+			return false;
+
+		//Already overlapping at the start
+		if (enter < 0)
+		{
+			enter = 0;
+			normal = Vector2() - velocity.Normalize();
+		}
+		time = enter;
+		return true;
+	}
+
+	///Check intersection between two capsules, a circle is a capsule whose start and end are the same point
+	Collision CollisionSystem::CapsuleIntersect(const Vector2& aStart, const Vector2& aEnd, double aRadius, const Vector2& bStart, const Vector2& bEnd, double bRadius)
+	{
+		Collision collision;
+		collision.type = Collision::Type::miss;
+
+		//Capsules touch when the closest points of their segments are within both radii
+		Vector2 aClosest, bClosest;
+		ClosestPointsOnSegments(aStart, aEnd, bStart, bEnd, aClosest, bClosest);
+		const double differenceX = aClosest.x - bClosest.x;
+		const double differenceY = aClosest.y - bClosest.y;
+		const double distanceSquared = differenceX * differenceX + differenceY * differenceY;
+		const double radius = aRadius + bRadius;
+		if (distanceSquared >= radius * radius)
+			return collision;
+
+		const double distance = std::sqrt(distanceSquared);
+		collision.type = Collision::Type::collision;
+		if (distance > epsilon)
+		{
+			const double normalX = differenceX / distance;
+			const double normalY = differenceY / distance;
+			const double depth = radius - distance;
+			collision.normal.x = normalX;
+			collision.normal.y = normalY;
+			collision.mtv.x = normalX * depth;
+			collision.mtv.y = normalY * depth;
+			collision.point.x = bClosest.x + normalX * bRadius;
+			collision.point.y = bClosest.y + normalY * bRadius;
+			return collision;
+		}
+
+		//Segments which cross have no direction between them, push a out sideways along whichever segment normal overlaps the least
+		const Vector2 aPoints[2]{ aStart, aEnd };
+		const Vector2 bPoints[2]{ bStart, bEnd };
+		double minOverlap = INFINITY;
+		Vector2 minNormal;
+		for (const Vector2& segment : { aEnd - aStart, bEnd - bStart })
+		{
+			if (segment.Dot(segment) == 0)
+				continue;
+
+			const Vector2 axis = segment.LeftNormal();
+			double aMin, aMax, bMin, bMax;
+			ProjectPolygon(aPoints, 2, axis, aMin, aMax);
+			ProjectPolygon(bPoints, 2, axis, bMin, bMax);
+			if (bMax - aMin + radius < minOverlap)
+			{
+				minOverlap = bMax - aMin + radius;
+				minNormal = axis;
+			}
+			if (aMax - bMin + radius < minOverlap)
+			{
+				minOverlap = aMax - bMin + radius;
+				minNormal = Vector2() - axis;
+			}
+		}
+
+		//Circles at the same position can go any way
+		if (minOverlap == INFINITY)
+		{
+			minOverlap = radius;
+			minNormal = Vector2(0, 1);
+		}
+
+		collision.normal = minNormal;
+		collision.mtv = minNormal * minOverlap;
+		collision.point = bClosest;
+		return collision;
+	}
+
+	///Check intersection between a capsule or circle and a convex polygon
+	Collision CollisionSystem::CapsulePolygonIntersect(const Vector2& start, const Vector2& end, double radius, const PolygonView& polygon)
+	{
+		Collision collision;
+		collision.type = Collision::Type::miss;
+
+		//While the segment is outside the polygon, the closest points give the exact contact
+		Vector2 segmentClosest, polygonClosest;
+		const double distance = SegmentPolygonDistance(start, end, polygon.vertices, polygon.vertexCount, segmentClosest, polygonClosest);
+		if (distance >= radius)
+			return collision;
+		if (distance > epsilon)
+		{
+			const Vector2 normal = (segmentClosest - polygonClosest) / distance;
+			collision.type = Collision::Type::collision;
+			collision.normal = normal;
+			collision.mtv = normal * (radius - distance);
+			collision.point = polygonClosest;
+			return collision;
+		}
+
+		//The segment is in the polygon, push it out along the axis with the least overlap like SAT, with the segment widened by the radius
+		const Vector2 segmentPoints[2]{ start, end };
+		const Vector2 segment = end - start;
+		const bool hasSegmentAxis = segment.Dot(segment) > 0;
+		double minOverlap = INFINITY;
+		Vector2 minNormal;
+		for (uint32_t i = 0; i < polygon.axisCount + hasSegmentAxis; i++)
+		{
+			const Vector2 axis = i < polygon.axisCount ? polygon.axes[i] : segment.LeftNormal();
+
+			double polygonMin, polygonMax, segmentMin, segmentMax;
+			ProjectPolygon(polygon.vertices, polygon.vertexCount, axis, polygonMin, polygonMax);
+			ProjectPolygon(segmentPoints, 2, axis, segmentMin, segmentMax);
+			segmentMin -= radius;
+			segmentMax += radius;
+
+			//Push the segment out of whichever side of the polygon is closer
+			if (segmentMax - polygonMin < minOverlap)
+			{
+				minOverlap = segmentMax - polygonMin;
+				minNormal = Vector2() - axis;
+			}
+			if (polygonMax - segmentMin < minOverlap)
+			{
+				minOverlap = polygonMax - segmentMin;
+				minNormal = axis;
+			}
+		}
+
+		//Degenerate polygons without any axes never collide
+		if (minOverlap == INFINITY)
+			return collision;
+
+		collision.type = Collision::Type::collision;
+		collision.normal = minNormal;
+		collision.mtv = minNormal * minOverlap;
+		//Deepest end of the segment
+		collision.point = (minNormal.Dot(start) < minNormal.Dot(end) ? start : end) - minNormal * radius;
+		return collision;
+	}
+
+	///Checks if a and b bounds are intersecting
+	bool CollisionSystem::AABBIntersect(ecs::Entity a, ecs::Entity b)
+	{
+		//Get the bounds
+		std::array<float, 4> aBounds{};
+		std::array<float, 4> bBounds{};
+		VisitCollider(a, [&aBounds](auto& collider) { aBounds = collider.bounds; });
+		VisitCollider(b, [&bBounds](auto& collider) { bBounds = collider.bounds; });
+
+		//Perform AABB intersect
+		return (aBounds[3] < bBounds[1] && aBounds[1] > bBounds[3] && aBounds[2] < bBounds[0] && aBounds[0] > bBounds[2]);
+	}
+
+	///Update the AABB and cached world space geometry of the collider, and its place in the broadphase
+	bool CollisionSystem::UpdateAABB(ecs::Entity entity)
+	{
+		std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+		Transform globalTf = TransformSystem::GetGlobalTransform(entity);
+		std::vector<Vector2>& transformedVerts = collisionSystem->geometryScratch;
+		std::vector<Vector2>& shapePoints = collisionSystem->shapeScratch;
+
+		//Apply transforms to the collider's vertices, or the points of its circle or capsule
+		Shape shape = Shape::polygon;
+		double radius = 0;
+		int colliderLayer = 0;
+		bool trigger = false;
+		std::array<float, 4>* colliderBounds = nullptr;
+		if (ecs::HasComponent<PolygonCollider>(entity))
+		{
+			PolygonCollider& collider = ecs::GetComponent<PolygonCollider>(entity);
+			if (collider.rotationOverride >= 0)
+				globalTf.rotation.z = collider.rotationOverride;
+			transformedVerts.resize(collider.vertices.size());
+			TransformSystem::ApplyTransforms2D(collider.vertices, globalTf, transformedVerts.data());
+			colliderLayer = collider.layer;
+			trigger = collider.trigger;
+			colliderBounds = &collider.bounds;
+		}
+		else if (ecs::HasComponent<CircleCollider>(entity))
+		{
+			CircleCollider& collider = ecs::GetComponent<CircleCollider>(entity);
+			shapePoints.assign(1, collider.center);
+			shape = Shape::circle;
+			radius = collider.radius;
+			colliderLayer = collider.layer;
+			trigger = collider.trigger;
+			colliderBounds = &collider.bounds;
+		}
+		else if (ecs::HasComponent<CapsuleCollider>(entity))
+		{
+			CapsuleCollider& collider = ecs::GetComponent<CapsuleCollider>(entity);
+			if (collider.rotationOverride >= 0)
+				globalTf.rotation.z = collider.rotationOverride;
+			shapePoints.assign({ collider.start, collider.end });
+			shape = Shape::capsule;
+			radius = collider.radius;
+			colliderLayer = collider.layer;
+			trigger = collider.trigger;
+			colliderBounds = &collider.bounds;
+		}
+		else
+			return false;
+
+		if (shape != Shape::polygon)
+		{
+			//Circles can't be stretched, so the radius uses the larger scale
+			transformedVerts.resize(shapePoints.size());
+			TransformSystem::ApplyTransforms2D(shapePoints, globalTf, transformedVerts.data());
+			radius *= std::max(std::abs(globalTf.scale.x), std::abs(globalTf.scale.y));
+		}
+		const uint32_t vertexCount = transformedVerts.size();
+
+		//Layers outside of the matrix fall back to layer 0
+		int layer = colliderLayer;
+		if (layer < 0 || layer >= layerCount)
+		{
+			debug::LogWarning("Collider layer " + std::to_string(layer) + " is out of range, using layer 0");
+			layer = 0;
+		}
+
+		//Nothing to do if the collider hasn't actually moved or changed layers
+		//Compared exactly, Vector2::operator== allows an epsilon so slow drift would never refresh the cache
+		auto it = collisionSystem->geometry.find(entity);
+		if (it != collisionSystem->geometry.end() && it->second.vertexCount == vertexCount && it->second.layer == layer && it->second.trigger == trigger &&
+			it->second.shape == shape && it->second.radius == radius &&
+			collisionSystem->broadphase->Contains(entity) &&
+			std::equal(transformedVerts.begin(), transformedVerts.end(), collisionSystem->geometryVertices.begin() + it->second.offset,
+				[](const Vector2& a, const Vector2& b) { return a.x == b.x && a.y == b.y; }))
+		{
+			it->second.position = globalTf.position;
+			return false;
+		}
+
+		//Find room in the geometry buffers, colliders which grow are moved to the end
+		ColliderGeometry& cache = collisionSystem->geometry[entity];
+		if (vertexCount > cache.capacity)
+		{
+			collisionSystem->unusedGeometry += cache.capacity;
+			if (collisionSystem->unusedGeometry > collisionSystem->geometryVertices.size() / 2)
+				collisionSystem->CompactGeometry();
+
+			cache.offset = collisionSystem->geometryVertices.size();
+			cache.capacity = vertexCount;
+			collisionSystem->geometryVertices.resize(cache.offset + vertexCount);
+			collisionSystem->geometryAxes.resize(cache.offset + vertexCount);
+		}
+		cache.shape = shape;
+		cache.radius = radius;
+		cache.vertexCount = vertexCount;
+		cache.layer = layer;
+		cache.trigger = trigger;
+		cache.position = globalTf.position;
+		std::copy(transformedVerts.begin(), transformedVerts.end(), collisionSystem->geometryVertices.begin() + cache.offset);
+		cache.axisCount = shape == Shape::polygon ? CalculateAxes(transformedVerts.data(), vertexCount, collisionSystem->geometryAxes.data() + cache.offset) : 0;
+
+		//Queue the collider for the next collision detection
+		if (!cache.moved)
+		{
+			cache.moved = true;
+			collisionSystem->movedColliders.push_back(entity);
+		}
+
+		//Bounds go top, right, bottom, left
+		std::array<float, 4> bounds{ -INFINITY, -INFINITY, INFINITY, INFINITY };
+
+		//For each vertice calculate min and max bounds
+		for (const Vector2& transformedVert : transformedVerts)
+		{
+			//Calculate bounds
+			//Top bound
+			if (transformedVert.y > bounds[0])
+				bounds[0] = transformedVert.y;
+			//Right bound
+			if (transformedVert.x > bounds[1])
+				bounds[1] = transformedVert.x;
+			//Bottom bound
+			if (transformedVert.y < bounds[2])
+				bounds[2] = transformedVert.y;
+			//Left bound
+			if (transformedVert.x < bounds[3])
+				bounds[3] = transformedVert.x;
+		}
+
+		//Round colliders reach radius past their points
+		bounds[0] += radius;
+		bounds[1] += radius;
+		bounds[2] -= radius;
+		bounds[3] -= radius;
+
+		cache.bounds = bounds;
+		*colliderBounds = bounds;
+		collisionSystem->broadphase->Update(entity, bounds, 1u << layer);
+		return true;
+	}
+
+	///Get the world space vertices and axes of a collider, valid until the next UpdateAABB
+	PolygonView CollisionSystem::GetWorldPolygon(ecs::Entity entity)
+	{
+		return ToPolygon(GetGeometry(entity));
+	}
+
+	///Set the shape and filter of query to cast the collider of entity, on its layer and ignoring itself. The direction and distance are left alone
+	void CollisionSystem::GetColliderCast(ecs::Entity entity, ShapeCastQuery& query)
+	{
+		const ColliderGeometry& cache = GetGeometry(entity);
+		const Vector2* vertices = geometryVertices.data() + cache.offset;
+		query.polygon.assign(vertices, vertices + cache.vertexCount);
+		query.radius = cache.shape == Shape::polygon ? 0 : cache.radius;
+		query.filter = QueryFilter{ .layer = cache.layer, .ignore = entity };
+	}
+
+	///Find the closest collider or tile a ray hits, returns false if it hits nothing
+	bool CollisionSystem::Raycast(const Ray& ray, QueryHit& hit)
+	{
+		const ResolvedFilter filter = ResolveFilter(ray.filter);
+		GatherQueryTilemaps();
+		queryCandidates.clear();
+		GatherQueryCandidates(QueryBounds(ray), filter);
+
+		batchHits.clear();
+		RayTest(ray, filter, queryCandidates.data(), queryCandidates.size(), true, batchHits);
+		hit = batchHits.empty() ? QueryHit() : batchHits[0];
+		return hit.hit;
+	}
+
+	///Find every collider and tile a ray hits, sorted by distance
+	void CollisionSystem::RaycastAll(const Ray& ray, std::vector<QueryHit>& hits)
+	{
+		const ResolvedFilter filter = ResolveFilter(ray.filter);
+		GatherQueryTilemaps();
+		queryCandidates.clear();
+		GatherQueryCandidates(QueryBounds(ray), filter);
+
+		hits.clear();
+		RayTest(ray, filter, queryCandidates.data(), queryCandidates.size(), false, hits);
+	}
+
+	///Find the first collider or tile a polygon, circle or capsule hits when moved, returns false if it hits nothing
+	bool CollisionSystem::ShapeCast(const ShapeCastQuery& query, QueryHit& hit)
+	{
+		const ResolvedFilter filter = ResolveFilter(query.filter);
+		GatherQueryTilemaps();
+		queryCandidates.clear();
+		GatherQueryCandidates(QueryBounds(query), filter);
+
+		batchHits.clear();
+		ShapeCastTest(query, filter, queryCandidates.data(), queryCandidates.size(), true, batchHits);
+		hit = batchHits.empty() ? QueryHit() : batchHits[0];
+		return hit.hit;
+	}
+
+	///Find every collider and tile a polygon, circle or capsule hits when moved, sorted by distance
+	void CollisionSystem::ShapeCastAll(const ShapeCastQuery& query, std::vector<QueryHit>& hits)
+	{
+		const ResolvedFilter filter = ResolveFilter(query.filter);
+		GatherQueryTilemaps();
+		queryCandidates.clear();
+		GatherQueryCandidates(QueryBounds(query), filter);
+
+		hits.clear();
+		ShapeCastTest(query, filter, queryCandidates.data(), queryCandidates.size(), false, hits);
+	}
+
+	///Find every collider and tile overlapping a box
+	void CollisionSystem::OverlapBox(const BoxQuery& query, std::vector<QueryHit>& hits)
+	{
+		const ResolvedFilter filter = ResolveFilter(query.filter);
+		GatherQueryTilemaps();
+		queryCandidates.clear();
+		GatherQueryCandidates(QueryBounds(query), filter);
+
+		hits.clear();
+		OverlapBoxTest(query, filter, queryCandidates.data(), queryCandidates.size(), hits);
+	}
+
+	///Batched Raycast, hits[i] is the closest hit of rays[i]
+	void CollisionSystem::RaycastBatch(const std::vector<Ray>& rays, std::vector<QueryHit>& hits, bool parallel)
+	{
+		RunQueryBatch(rays, batchHits, batchOffsets, parallel,
+			[this](const Ray& ray, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, std::vector<QueryHit>& queryHits)
+			{
+				RayTest(ray, filter, candidates, candidateCount, true, queryHits);
+			});
+
+		hits.assign(rays.size(), QueryHit());
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			if (batchOffsets[i + 1] > batchOffsets[i])
+				hits[i] = batchHits[batchOffsets[i]];
+		}
+	}
+
+	///Batched ShapeCast, hits[i] is the first hit of queries[i]
+	void CollisionSystem::ShapeCastBatch(const std::vector<ShapeCastQuery>& queries, std::vector<QueryHit>& hits, bool parallel)
+	{
+		RunQueryBatch(queries, batchHits, batchOffsets, parallel,
+			[this](const ShapeCastQuery& query, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, std::vector<QueryHit>& queryHits)
+			{
+				ShapeCastTest(query, filter, candidates, candidateCount, true, queryHits);
+			});
+
+		hits.assign(queries.size(), QueryHit());
+		for (size_t i = 0; i < queries.size(); i++)
+		{
+			if (batchOffsets[i + 1] > batchOffsets[i])
+				hits[i] = batchHits[batchOffsets[i]];
+		}
+	}
+
+	///Batched RaycastAll, the hits of rays[i] are hits[offsets[i]] up to hits[offsets[i + 1]]
+	void CollisionSystem::RaycastAllBatch(const std::vector<Ray>& rays, std::vector<QueryHit>& hits, std::vector<uint32_t>& offsets, bool parallel)
+	{
+		RunQueryBatch(rays, hits, offsets, parallel,
+			[this](const Ray& ray, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, std::vector<QueryHit>& queryHits)
+			{
+				RayTest(ray, filter, candidates, candidateCount, false, queryHits);
+			});
+	}
+
+	///Batched OverlapBox, the hits of queries[i] are hits[offsets[i]] up to hits[offsets[i + 1]]
+	void CollisionSystem::OverlapBoxBatch(const std::vector<BoxQuery>& queries, std::vector<QueryHit>& hits, std::vector<uint32_t>& offsets, bool parallel)
+	{
+		RunQueryBatch(queries, hits, offsets, parallel,
+			[this](const BoxQuery& query, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, std::vector<QueryHit>& queryHits)
+			{
+				OverlapBoxTest(query, filter, candidates, candidateCount, queryHits);
+			});
+	}
+
+	///Change the broadphase used to find potential collisions, every collider is moved to the new broadphase
+	void CollisionSystem::SetBroadphase(BroadphaseType type)
+	{
+		std::unique_ptr<Broadphase> newBroadphase;
+		switch (type)
+		{
+		case BroadphaseType::bruteForce:
+			newBroadphase = std::make_unique<BruteForceBroadphase>();
+			break;
+		case BroadphaseType::aabbTree:
+			newBroadphase = std::make_unique<AABBTree>();
+			break;
+		case BroadphaseType::spatialHash:
+			newBroadphase = std::make_unique<SpatialHashGrid>();
+			break;
+		case BroadphaseType::sweepAndPrune:
+			newBroadphase = std::make_unique<SweepAndPrune>();
+			break;
+		}
+
+		//Move every collider which has valid bounds
+		ForEachCollider([&](ecs::Entity entity)
+			{
+				if (broadphase->Contains(entity))
+					newBroadphase->Update(entity, geometry[entity].bounds, 1u << geometry[entity].layer);
+			});
+
+		broadphase = std::move(newBroadphase);
+		broadphaseType = type;
+	}
+
+	///Get the type of the broadphase currently in use
+	CollisionSystem::BroadphaseType CollisionSystem::GetBroadphaseType() const
+	{
+		return broadphaseType;
+	}
+
+	///Get the broadphase currently in use, useful for tweaking its settings
+	Broadphase& CollisionSystem::GetBroadphase()
+	{
+		return *broadphase;
+	}
+
+	///Call visit on every entity with a polygon, circle or capsule collider
+	template<typename Visit>
+	void CollisionSystem::ForEachCollider(Visit visit)
+	{
+		for (ecs::Entity entity : entities)
+			visit(entity);
+		for (ecs::Entity entity : ecs::GetSystem<CircleCollisionSystem>()->entities)
+			visit(entity);
+		for (ecs::Entity entity : ecs::GetSystem<CapsuleCollisionSystem>()->entities)
+			visit(entity);
+	}
+
+	///Get the cached geometry of a collider, caching it first if it hasn't been yet
+	const CollisionSystem::ColliderGeometry& CollisionSystem::GetGeometry(ecs::Entity entity)
+	{
+		auto it = geometry.find(entity);
+		if (it != geometry.end())
+			return it->second;
+
+		UpdateAABB(entity);
+		return geometry[entity];
+	}
+
+	///Make a polygon view of cached geometry
+	PolygonView CollisionSystem::ToPolygon(const ColliderGeometry& cache) const
+	{
+		return PolygonView{ geometryVertices.data() + cache.offset, cache.vertexCount, geometryAxes.data() + cache.offset, cache.axisCount };
+	}
+
+	///Move every collider's geometry to the start of the buffers, removing the gaps left by removed or grown colliders
+	void CollisionSystem::CompactGeometry()
+	{
+		std::vector<Vector2> vertices;
+		std::vector<Vector2> axes;
+		vertices.reserve(geometryVertices.size() - unusedGeometry);
+		axes.reserve(geometryAxes.size() - unusedGeometry);
+
+		for (auto& [entity, cache] : geometry)
+		{
+			const uint32_t offset = vertices.size();
+			vertices.insert(vertices.end(), geometryVertices.begin() + cache.offset, geometryVertices.begin() + cache.offset + cache.capacity);
+			axes.insert(axes.end(), geometryAxes.begin() + cache.offset, geometryAxes.begin() + cache.offset + cache.capacity);
+			cache.offset = offset;
+		}
+
+		geometryVertices = std::move(vertices);
+		geometryAxes = std::move(axes);
+		unusedGeometry = 0;
+	}
+
+	///Resolve a query's filter against the layer matrix
+	CollisionSystem::ResolvedFilter CollisionSystem::ResolveFilter(const QueryFilter& filter) const
+	{
+		int layer = filter.layer;
+		if (layer < 0 || layer >= layerCount)
+		{
+			debug::LogWarning("Query layer " + std::to_string(layer) + " is out of range, using layer 0");
+			layer = 0;
+		}
+
+		const uint32_t broadphaseMask = collisionMasks[layer] | (filter.triggers ? triggerMasks[layer] : 0);
+		return ResolvedFilter{ layer, broadphaseMask, filter.triggers, filter.ignore };
+	}
+
+	///Can a query hit a collider or tile on layer
+	bool CollisionSystem::FilterAccepts(const ResolvedFilter& filter, int layer, bool trigger) const
+	{
+		const uint32_t layerBit = 1u << layer;
+		if (trigger)
+			return filter.triggers && (triggerMasks[filter.layer] & layerBit);
+		return collisionMasks[filter.layer] & layerBit;
+	}
+
+	///Collect the tilemaps for the next queries and tile collision checks
+	void CollisionSystem::GatherQueryTilemaps()
+	{
+		queryTilemaps.clear();
+		for (ecs::Entity entity : ecs::GetSystem<TilemapCollisionSystem>()->entities)
+		{
+			const Tilemap* tilemap = ecs::GetComponent<TilemapCollider>(entity).tilemap;
+			if (!tilemap)
+				continue;
+
+			const glm::mat4 localToWorld = TransformSystem::GetGlobalTransformMatrix(entity);
+			queryTilemaps.push_back(QueryTilemap{ entity, tilemap, localToWorld, glm::inverse(localToWorld) });
+		}
+		std::sort(queryTilemaps.begin(), queryTilemaps.end(), [](const QueryTilemap& lhs, const QueryTilemap& rhs) { return lhs.entity < rhs.entity; });
+	}
+
+	///Append the colliders inside bounds which the filter accepts to queryCandidates
+	void CollisionSystem::GatherQueryCandidates(const Bounds& bounds, const ResolvedFilter& filter)
+	{
+		candidates.clear();
+		broadphase->Query(bounds, candidates, filter.broadphaseMask);
+		//Sort so that the results don't depend on the broadphase in use
+		std::sort(candidates.begin(), candidates.end());
+
+		for (ecs::Entity entity : candidates)
+		{
+			auto it = geometry.find(entity);
+			if (entity != filter.ignore && it != geometry.end() && FilterAccepts(filter, it->second.layer, it->second.trigger))
+				queryCandidates.push_back(entity);
+		}
+	}
+
+	///Test a ray against candidates and the gathered tilemaps
+	void CollisionSystem::RayTest(const Ray& ray, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, bool closestOnly, std::vector<QueryHit>& hits) const
+	{
+		const Vector2 direction = ray.direction.Normalize();
+		if (!(ray.direction.Length() > 0) || !(ray.maxDistance > 0))
+			return;
+		const Vector2 delta = direction * ray.maxDistance;
+
+		const size_t firstHit = hits.size();
+		double closestTime = INFINITY;
+		auto addHit = [&](double time, const QueryHit& hit)
+			{
+				if (!closestOnly)
+					hits.push_back(hit);
+				else if (time < closestTime)
+				{
+					hits.resize(firstHit);
+					hits.push_back(hit);
+				}
+				closestTime = std::min(closestTime, time);
+			};
+
+		for (size_t i = 0; i < candidateCount; i++)
+		{
+			const ColliderGeometry& cache = geometry.find(candidates[i])->second;
+			const Vector2* vertices = geometryVertices.data() + cache.offset;
+			double time;
+			Vector2 normal;
+			const bool hit = cache.shape == Shape::polygon ? RayPolygon(ray.origin, delta, vertices, cache.vertexCount, time, normal) :
+				RayCapsule(ray.origin, delta, vertices[0], vertices[cache.vertexCount - 1], cache.radius, time, normal);
+			if (!hit)
+				continue;
+
+			//Rays starting inside a collider hit it at their origin, facing back along the ray
+			if (normal.x == 0 && normal.y == 0)
+				normal = Vector2() - direction;
+			addHit(time, QueryHit{ true, candidates[i], 0, ray.origin + delta * time, normal, time * ray.maxDistance });
+		}
+
+		//Walk the tiles along the ray in each tilemap's local space, the fraction of the ray travelled is the same in both spaces
+		std::vector<Vector2> tileVertices;
+		for (const QueryTilemap& map : queryTilemaps)
+		{
+			if (map.entity == filter.ignore)
+				continue;
+
+			const Tilemap& tilemap = *map.tilemap;
+			const Vector2 localOrigin = TransformPoint(map.worldToLocal, ray.origin);
+			const Vector2 localDelta = TransformPoint(map.worldToLocal, ray.origin + delta) - localOrigin;
+			//Tile y coordinates grow downwards
+			const Vector2 cellOrigin(localOrigin.x / tilemap.tileSize.x, -localOrigin.y / tilemap.tileSize.y);
+			const Vector2 cellDelta(localDelta.x / tilemap.tileSize.x, -localDelta.y / tilemap.tileSize.y);
+
+			for (const MapLayer* layer : tilemap.mapLayers)
+			{
+				if (!layer->hasCollision || layer->tiles.empty())
+					continue;
+
+				TraverseCells(cellOrigin, cellDelta, layer->width, layer->height, [&](int64_t x, int64_t y, double cellTime)
+					{
+						//Tiles further than the closest hit can't be closer
+						if (closestOnly && cellTime > closestTime)
+							return false;
+
+						const uint32_t gid = layer->GetColliderGID(x, y);
+						if (gid == 0 || !FilterAccepts(filter, GetTileCollisionLayer(gid), IsTileTrigger(gid)))
+							return true;
+
+						TileVertices(tilemap, MapLayer::ColliderBox{ (uint32_t)x, (uint32_t)y, 1, 1, gid }, tileVertices);
+						double time;
+						Vector2 normal;
+						if (RayPolygon(localOrigin, localDelta, tileVertices.data(), tileVertices.size(), time, normal))
+						{
+							normal = normal.x == 0 && normal.y == 0 ? Vector2() - direction : LocalNormalToWorld(map.worldToLocal, normal);
+							addHit(time, QueryHit{ true, map.entity, gid, ray.origin + delta * time, normal, time * ray.maxDistance });
+						}
+						return true;
+					});
+			}
+		}
+
+		//Closest first, ties keep the order they were found in
+		if (!closestOnly)
+			std::stable_sort(hits.begin() + firstHit, hits.end(), [](const QueryHit& lhs, const QueryHit& rhs) { return lhs.distance < rhs.distance; });
+	}
+
+	///Test a shape cast against candidates and the gathered tilemaps, hits are appended and only the first one if closestOnly is set
+	void CollisionSystem::ShapeCastTest(const ShapeCastQuery& query, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, bool closestOnly, std::vector<QueryHit>& hits) const
+	{
+		if (!(query.direction.Length() > 0) || !(query.maxDistance > 0) || query.polygon.empty())
+			return;
+		const Vector2 velocity = query.direction.Normalize() * query.maxDistance;
+
+		//Circles and capsules are cast with their center or segment, which has no axes
+		const bool round = query.radius > 0;
+		PolygonAxes shapeAxes;
+		const PolygonView shape = shapeAxes.View(query.polygon.data(), round ? 0 : query.polygon.size());
+		const Vector2& roundStart = query.polygon.front();
+		const Vector2& roundEnd = query.polygon.back();
+
+		const size_t firstHit = hits.size();
+		double closestTime = INFINITY;
+		auto addHit = [&](double time, const QueryHit& hit)
+			{
+				if (!closestOnly)
+					hits.push_back(hit);
+				else if (time < closestTime)
+				{
+					hits.resize(firstHit);
+					hits.push_back(hit);
+				}
+				closestTime = std::min(closestTime, time);
+			};
+
+		for (size_t i = 0; i < candidateCount; i++)
+		{
+			const ColliderGeometry& cache = geometry.find(candidates[i])->second;
+			const PolygonView other = ToPolygon(cache);
+			double time;
+			Vector2 normal;
+			Vector2 point;
+			if (round)
+			{
+				const bool hit = cache.shape == Shape::polygon ? SweptCapsulePolygon(roundStart, roundEnd, query.radius, velocity, other, time, normal, point) :
+					SweptCapsuleCapsule(roundStart, roundEnd, query.radius, velocity, other.vertices[0], other.vertices[other.vertexCount - 1], cache.radius, time, normal, point);
+				if (hit)
+					addHit(time, QueryHit{ true, candidates[i], 0, point, normal, time * query.maxDistance });
+			}
+			else if (cache.shape != Shape::polygon)
+			{
+				if (SweptPolygonCapsule(shape, velocity, other.vertices[0], other.vertices[other.vertexCount - 1], cache.radius, time, normal, point))
+					addHit(time, QueryHit{ true, candidates[i], 0, point + velocity * time, normal, time * query.maxDistance });
+			}
+			else if (SweptSATIntersect(shape, velocity, other, time, normal))
+				addHit(time, QueryHit{ true, candidates[i], 0, ContactPoint(shape, velocity * time, other, normal), normal, time * query.maxDistance });
+		}
+
+		//Cast the shape in each tilemap's local space
+		std::vector<Vector2> localShapeVertices;
+		std::vector<Vector2> tileVertices;
+		for (const QueryTilemap& map : queryTilemaps)
+		{
+			if (map.entity == filter.ignore)
+				continue;
+
+			localShapeVertices.resize(query.polygon.size());
+			for (size_t i = 0; i < query.polygon.size(); i++)
+				localShapeVertices[i] = TransformPoint(map.worldToLocal, query.polygon[i]);
+			const Vector2 localVelocity = TransformDirection(map.worldToLocal, velocity);
+			PolygonAxes localShapeAxes;
+			const PolygonView localShape = localShapeAxes.View(localShapeVertices.data(), round ? 0 : localShapeVertices.size());
+			//Circles and capsules stay round as long as the tilemap is scaled evenly
+			const double localRadius = TransformDirection(map.worldToLocal, Vector2(query.radius, 0)).Length();
+			Bounds localBounds = PointBounds(localShapeVertices.data(), localShapeVertices.size(), localVelocity);
+			localBounds[0] += localRadius;
+			localBounds[1] += localRadius;
+			localBounds[2] -= localRadius;
+			localBounds[3] -= localRadius;
+
+			ForEachTile(*map.tilemap, localBounds, [&](const MapLayer::ColliderBox& box, uint32_t)
+				{
+					const uint32_t gid = box.gid;
+					if (!FilterAccepts(filter, GetTileCollisionLayer(gid), IsTileTrigger(gid)))
+						return;
+
+					TileVertices(*map.tilemap, box, tileVertices);
+					PolygonAxes tileAxes;
+					const PolygonView tile = tileAxes.View(tileVertices.data(), tileVertices.size());
+					double time;
+					Vector2 normal;
+					Vector2 localPoint;
+					const bool hit = round ? SweptCapsulePolygon(localShapeVertices.front(), localShapeVertices.back(), localRadius, localVelocity, tile, time, normal, localPoint) :
+						SweptSATIntersect(localShape, localVelocity, tile, time, normal);
+					if (hit && (!closestOnly || time < closestTime))
+					{
+						const Vector2 point = TransformPoint(map.localToWorld, round ? localPoint : ContactPoint(localShape, localVelocity * time, tile, normal));
+						normal = time == 0 ? Vector2() - velocity.Normalize() : LocalNormalToWorld(map.worldToLocal, normal);
+						addHit(time, QueryHit{ true, map.entity, gid, point, normal, time * query.maxDistance });
+					}
+				});
+		}
+
+		//Closest first, ties keep the order they were found in
+		if (!closestOnly)
+			std::stable_sort(hits.begin() + firstHit, hits.end(), [](const QueryHit& lhs, const QueryHit& rhs) { return lhs.distance < rhs.distance; });
+	}
+
+	///Test a box against candidates and the gathered tilemaps
+	void CollisionSystem::OverlapBoxTest(const BoxQuery& query, const ResolvedFilter& filter, const ecs::Entity* candidates, size_t candidateCount, std::vector<QueryHit>& hits) const
+	{
+		const std::array<Vector2, 4> boxVertices = BoxVertices(query);
+		PolygonAxes boxAxes;
+		const PolygonView box = boxAxes.View(boxVertices.data(), boxVertices.size());
+
+		for (size_t i = 0; i < candidateCount; i++)
+		{
+			const ColliderGeometry& cache = geometry.find(candidates[i])->second;
+			const PolygonView other = ToPolygon(cache);
+			if (cache.shape != Shape::polygon)
+			{
+				//The mtv pushes the capsule out of the box, so reverse it
+				Collision collision = CapsulePolygonIntersect(other.vertices[0], other.vertices[other.vertexCount - 1], cache.radius, box);
+				if (collision.type != Collision::Type::miss)
+					hits.push_back(QueryHit{ true, candidates[i], 0, collision.point, Vector2() - collision.normal, Vector2(collision.mtv).Length() });
+				continue;
+			}
+
+			Collision collision = SATIntersect(box, other);
+			if (collision.type == Collision::Type::miss)
+				continue;
+
+			//Push the box away from the collider
+			Vector2 normal = Vector2(collision.mtv).Normalize();
+			if ((query.center - cache.position).Dot(normal) < 0)
+				normal = Vector2() - normal;
+			hits.push_back(QueryHit{ true, candidates[i], 0, ContactPoint(box, Vector2(), other, normal), normal, Vector2(collision.mtv).Length() });
+		}
+
+		//Overlap the box in each tilemap's local space
+		std::array<Vector2, 4> localBoxVertices;
+		std::vector<Vector2> tileVertices;
+		for (const QueryTilemap& map : queryTilemaps)
+		{
+			if (map.entity == filter.ignore)
+				continue;
+
+			for (size_t i = 0; i < boxVertices.size(); i++)
+				localBoxVertices[i] = TransformPoint(map.worldToLocal, boxVertices[i]);
+			PolygonAxes localBoxAxes;
+			const PolygonView localBox = localBoxAxes.View(localBoxVertices.data(), localBoxVertices.size());
+			const Vector2 localCenter = TransformPoint(map.worldToLocal, query.center);
+
+			ForEachTile(*map.tilemap, PointBounds(localBoxVertices.data(), localBoxVertices.size()), [&](const MapLayer::ColliderBox& box, uint32_t)
+				{
+					const uint32_t gid = box.gid;
+					if (!FilterAccepts(filter, GetTileCollisionLayer(gid), IsTileTrigger(gid)))
+						return;
+
+					TileVertices(*map.tilemap, box, tileVertices);
+					PolygonAxes tileAxes;
+					const PolygonView tile = tileAxes.View(tileVertices.data(), tileVertices.size());
+					Collision collision = SATIntersect(localBox, tile);
+					if (collision.type == Collision::Type::miss)
+						return;
+
+					Vector2 localMtv = collision.mtv;
+					if ((localCenter - TileCenter(*map.tilemap, box)).Dot(localMtv) < 0)
+						localMtv = Vector2() - localMtv;
+					const Vector2 mtv = TransformDirection(map.localToWorld, localMtv);
+					hits.push_back(QueryHit{ true, map.entity, gid, TransformPoint(map.localToWorld, ContactPoint(localBox, Vector2(), tile, localMtv.Normalize())), mtv.Normalize(), mtv.Length() });
+				});
+		}
+	}
+
+	///Run a test over a batch of queries, collecting the hits in query order
+	template<typename Query, typename Test>
+	void CollisionSystem::RunQueryBatch(const std::vector<Query>& queries, std::vector<QueryHit>& hits, std::vector<uint32_t>& offsets, bool parallel, Test test)
+	{
+		//The broadphase can only be searched by one thread, so find the candidates of every query first
+		GatherQueryTilemaps();
+		queryCandidates.clear();
+		queryCandidateOffsets.assign(1, 0);
+		queryFilters.clear();
+		for (const Query& query : queries)
+		{
+			queryFilters.push_back(ResolveFilter(query.filter));
+			GatherQueryCandidates(QueryBounds(query), queryFilters.back());
+			queryCandidateOffsets.push_back(queryCandidates.size());
+		}
+
+		//Test the queries, each thread appends to its own buffer
+		ThreadPool& threadPool = GetThreadPool();
+		threadQueryHits.resize(std::max<size_t>(threadQueryHits.size(), threadPool.GetThreadCount()));
+		for (auto& buffer : threadQueryHits)
+			buffer.clear();
+		auto testRange = [&](size_t begin, size_t end, unsigned int threadIndex)
+			{
+				std::vector<QueryHit> queryHits;
+				for (size_t i = begin; i < end; i++)
+				{
+					queryHits.clear();
+					const uint32_t firstCandidate = queryCandidateOffsets[i];
+					test(queries[i], queryFilters[i], queryCandidates.data() + firstCandidate, queryCandidateOffsets[i + 1] - firstCandidate, queryHits);
+					for (const QueryHit& hit : queryHits)
+						threadQueryHits[threadIndex].emplace_back(i, hit);
+				}
+			};
+		if (parallel)
+			threadPool.ParallelFor(queries.size(), queryChunkSize, testRange);
+		else
+			testRange(0, queries.size(), 0);
+
+		//Place the hits by query, the hits of one query all come from one thread and are already in order
+		offsets.assign(queries.size() + 1, 0);
+		for (const auto& buffer : threadQueryHits)
+		{
+			for (const auto& [query, hit] : buffer)
+				offsets[query + 1]++;
+		}
+		for (size_t i = 0; i < queries.size(); i++)
+			offsets[i + 1] += offsets[i];
+
+		hits.resize(offsets.back());
+		std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+		for (const auto& buffer : threadQueryHits)
+		{
+			for (const auto& [query, hit] : buffer)
+				hits[next[query]++] = hit;
+		}
+	}
+
+	///Set the collision layer of a tile id
+	void CollisionSystem::SetTileCollisionLayer(unsigned int tileID, int layer)
+	{
+		if (layer < 0 || layer >= layerCount)
+		{
+			debug::LogWarning("Tile collision layer " + std::to_string(layer) + " is out of range");
+			return;
+		}
+
+		if (tileID >= tileIDToLayer.size())
+			tileIDToLayer.resize(tileID + 1, 0);
+		tileIDToLayer[tileID] = layer;
+	}
+
+	///Get the collision layer of a tile id, defaults to 0
+	int CollisionSystem::GetTileCollisionLayer(unsigned int tileID) const
+	{
+		return tileID < tileIDToLayer.size() ? tileIDToLayer[tileID] : 0;
+	}
+
+	///Set whether a tile id only acts as a trigger
+	void CollisionSystem::SetTileTrigger(unsigned int tileID, bool trigger)
+	{
+		if (tileID >= tileIDToTrigger.size())
+			tileIDToTrigger.resize(tileID + 1, false);
+		tileIDToTrigger[tileID] = trigger;
+	}
+
+	///Does a tile id only act as a trigger, defaults to false
+	bool CollisionSystem::IsTileTrigger(unsigned int tileID) const
+	{
+		return tileID < tileIDToTrigger.size() && tileIDToTrigger[tileID];
+	}
+
+	///Sets the interaction state between two layers
+	void CollisionSystem::SetLayerInteraction(int layer1, int layer2, LayerInteraction interaction)
+	{
+		if (layer1 < 0 || layer1 >= layerCount || layer2 < 0 || layer2 >= layerCount)
+		{
+			debug::LogWarning("Collision layers " + std::to_string(layer1) + " and " + std::to_string(layer2) + " are out of range");
+			return;
+		}
+
+		const bool collisions = interaction == LayerInteraction::all || interaction == LayerInteraction::collisions;
+		const bool triggers = interaction == LayerInteraction::all || interaction == LayerInteraction::triggers;
+
+		//The matrix is symmetric
+		auto setBit = [](uint32_t& mask, int layer, bool set)
+			{
+				if (set)
+					mask |= 1u << layer;
+				else
+					mask &= ~(1u << layer);
+			};
+		setBit(collisionMasks[layer1], layer2, collisions);
+		setBit(collisionMasks[layer2], layer1, collisions);
+		setBit(triggerMasks[layer1], layer2, triggers);
+		setBit(triggerMasks[layer2], layer1, triggers);
+
+		//Contacts between the two layers need to be found again
+		for (auto& [entity, cache] : geometry)
+		{
+			if ((cache.layer == layer1 || cache.layer == layer2) && !cache.moved)
+			{
+				cache.moved = true;
+				movedColliders.push_back(entity);
+			}
+		}
+	}
+
+	///Get the interaction type between two collision layers
+	CollisionSystem::LayerInteraction CollisionSystem::GetLayerInteraction(int layer1, int layer2) const
 	{
-		//Default is all, this is added automatically
-		return layerCollisionMatrix[layer1][layer2];
+		//Layers outside of the matrix interact with everything, same as layers which haven't been set
+		if (layer1 < 0 || layer1 >= layerCount || layer2 < 0 || layer2 >= layerCount)
+			return LayerInteraction::all;
+
+		const bool collisions = collisionMasks[layer1] & (1u << layer2);
+		const bool triggers = triggerMasks[layer1] & (1u << layer2);
+		if (collisions && triggers)
+			return LayerInteraction::all;
+		if (collisions)
+			return LayerInteraction::collisions;
+		if (triggers)
+			return LayerInteraction::triggers;
+		return LayerInteraction::none;
 	}
-}
\ No newline at end of file
+}
@@ -1,38 +1,492 @@
 #include "Physics.h"
 
+#include <bit>
+#include <cmath>
 #include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNE_PHYSICS_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define UNE_PHYSICS_NEON
+#include <arm_neon.h>
+#endif
 
 #include "ECS.h"
 #include "Transform.h"
 #include "Collision.h"
 #include "Tilemap.h"
 #include "utils/Timing.h"
+#include "utils/ThreadPool.h"
 
 namespace une
 {
-	///Update the physics system, call this every frame
+	namespace
+	{
+		//Add gravity and apply drag to the packed velocities, gravityStep is the gravity times the step time
+		void ApplyForces(float* velocityX, float* velocityY, float* velocityZ, const float* gravityFactor, const float* drag, const float gravityStep[3], float stepTime, size_t count)
+		{
+			float* velocities[3] = { velocityX, velocityY, velocityZ };
+			size_t i = 0;
+
+			//Four bodies at a time
+#if defined(UNE_PHYSICS_SSE)
+			const __m128 gravity[3] = { _mm_set1_ps(gravityStep[0]), _mm_set1_ps(gravityStep[1]), _mm_set1_ps(gravityStep[2]) };
+			const __m128 time = _mm_set1_ps(stepTime);
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 factor = _mm_loadu_ps(gravityFactor + i);
+				const __m128 dragStep = _mm_mul_ps(_mm_loadu_ps(drag + i), time);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					__m128 v = _mm_add_ps(_mm_loadu_ps(velocities[axis] + i), _mm_mul_ps(gravity[axis], factor));
+					v = _mm_sub_ps(v, _mm_mul_ps(v, dragStep));
+					_mm_storeu_ps(velocities[axis] + i, v);
+				}
+			}
+#elif defined(UNE_PHYSICS_NEON)
+			const float32x4_t gravity[3] = { vdupq_n_f32(gravityStep[0]), vdupq_n_f32(gravityStep[1]), vdupq_n_f32(gravityStep[2]) };
+			const float32x4_t time = vdupq_n_f32(stepTime);
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4_t factor = vld1q_f32(gravityFactor + i);
+				const float32x4_t dragStep = vmulq_f32(vld1q_f32(drag + i), time);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					float32x4_t v = vaddq_f32(vld1q_f32(velocities[axis] + i), vmulq_f32(gravity[axis], factor));
+					v = vsubq_f32(v, vmulq_f32(v, dragStep));
+					vst1q_f32(velocities[axis] + i, v);
+				}
+			}
+#endif
+
+			//Remaining bodies
+			for (; i < count; i++)
+			{
+				const float dragStep = drag[i] * stepTime;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const float v = velocities[axis][i] + gravityStep[axis] * gravityFactor[i];
+					velocities[axis][i] = v - v * dragStep;
+				}
+			}
+		}
+
+		//Move the packed positions by the packed velocities, positions stay doubles so bodies far from the origin keep their precision
+		void IntegrateMovement(double* positionX, double* positionY, double* positionZ, const float* velocityX, const float* velocityY, const float* velocityZ, double stepTime, size_t count)
+		{
+			double* positions[3] = { positionX, positionY, positionZ };
+			const float* velocities[3] = { velocityX, velocityY, velocityZ };
+			size_t i = 0;
+
+			//Four bodies at a time, as two pairs of doubles
+#if defined(UNE_PHYSICS_SSE)
+			const __m128d time = _mm_set1_pd(stepTime);
+			for (; i + 4 <= count; i += 4)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const __m128 v = _mm_loadu_ps(velocities[axis] + i);
+					const __m128d low = _mm_mul_pd(_mm_cvtps_pd(v), time);
+					const __m128d high = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), time);
+					_mm_storeu_pd(positions[axis] + i, _mm_add_pd(_mm_loadu_pd(positions[axis] + i), low));
+					_mm_storeu_pd(positions[axis] + i + 2, _mm_add_pd(_mm_loadu_pd(positions[axis] + i + 2), high));
+				}
+			}
+#elif defined(UNE_PHYSICS_NEON)
+			const float64x2_t time = vdupq_n_f64(stepTime);
+			for (; i + 4 <= count; i += 4)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const float32x4_t v = vld1q_f32(velocities[axis] + i);
+					const float64x2_t low = vmulq_f64(vcvt_f64_f32(vget_low_f32(v)), time);
+					const float64x2_t high = vmulq_f64(vcvt_high_f64_f32(v), time);
+					vst1q_f64(positions[axis] + i, vaddq_f64(vld1q_f64(positions[axis] + i), low));
+					vst1q_f64(positions[axis] + i + 2, vaddq_f64(vld1q_f64(positions[axis] + i + 2), high));
+				}
+			}
+#endif
+
+			//Remaining bodies
+			for (; i < count; i++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+					positions[axis][i] += velocities[axis][i] * stepTime;
+			}
+		}
+
+		//Get a bit for each of the four bodies starting at x, y and z which has a velocity
+		uint32_t MovingMask(const float* x, const float* y, const float* z)
+		{
+#if defined(UNE_PHYSICS_SSE)
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 still = _mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(_mm_loadu_ps(x), zero), _mm_cmpeq_ps(_mm_loadu_ps(y), zero)), _mm_cmpeq_ps(_mm_loadu_ps(z), zero));
+			return ~_mm_movemask_ps(still) & 0xf;
+#elif defined(UNE_PHYSICS_NEON)
+			const uint32x4_t still = vandq_u32(vandq_u32(vceqzq_f32(vld1q_f32(x)), vceqzq_f32(vld1q_f32(y))), vceqzq_f32(vld1q_f32(z)));
+			const uint32x4_t bits = { 1, 2, 4, 8 };
+			return vaddvq_u32(vbicq_u32(bits, still));
+#else
+			uint32_t mask = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				if (x[i] != 0 || y[i] != 0 || z[i] != 0)
+					mask |= 1 << i;
+			}
+			return mask;
+#endif
+		}
+
+		//Remove the velocity going into a surface, and bounce it back if it hit faster than restitutionThreshold
+		Vector3 BounceVelocity(const Vector3& velocity, const Vector3& normal, float restitution, float restitutionThreshold)
+		{
+			const double speed = velocity.Dot(normal);
+			if (speed >= 0)
+				return velocity;
+			const double bounce = -speed < restitutionThreshold ? 0 : restitution;
+			return velocity - normal * (speed * (1 + bounce));
+		}
+
+		//A point of a clipped edge, and where it came from
+		struct ClipVertex
+		{
+			Vector2 position;
+			uint32_t feature;
+		};
+
+		//Keep the part of the segment in front of the plane dot(normal, point) = offset, points made by clipping get clipFeature
+		//Returns the amount of points left
+		int ClipSegment(const ClipVertex in[2], ClipVertex out[2], const Vector2& normal, double offset, uint32_t clipFeature)
+		{
+			const double distance0 = normal.x * in[0].position.x + normal.y * in[0].position.y - offset;
+			const double distance1 = normal.x * in[1].position.x + normal.y * in[1].position.y - offset;
+
+			int count = 0;
+			if (distance0 >= 0)
+				out[count++] = in[0];
+			if (distance1 >= 0)
+				out[count++] = in[1];
+			//The points are on different sides, add the point where the segment crosses the plane
+			if (distance0 * distance1 < 0)
+			{
+				const double t = distance0 / (distance0 - distance1);
+				out[count++] = ClipVertex{ Vector2(in[0].position.x + (in[1].position.x - in[0].position.x) * t,
+					in[0].position.y + (in[1].position.y - in[0].position.y) * t), clipFeature };
+			}
+			return count;
+		}
+
+		//Outward normal of the edge starting from vertex i of a clockwise polygon
+		Vector2 EdgeNormal(const PolygonView& polygon, uint32_t i)
+		{
+			const Vector2& vertex = polygon.vertices[i];
+			const Vector2& next = polygon.vertices[i < polygon.vertexCount - 1 ? i + 1 : 0];
+			return (next - vertex).LeftNormal();
+		}
+
+		//Edge of a polygon whose normal points the most towards direction
+		uint32_t FacingEdge(const PolygonView& polygon, const Vector2& direction, double& alignment)
+		{
+			uint32_t best = 0;
+			alignment = -INFINITY;
+			for (uint32_t i = 0; i < polygon.vertexCount; i++)
+			{
+				const double dot = EdgeNormal(polygon, i).Dot(direction);
+				if (dot > alignment)
+				{
+					alignment = dot;
+					best = i;
+				}
+			}
+			return best;
+		}
+
+		//Find where two overlapping polygons touch, normal pushes a out of b. Returns the amount of points, 0 if the polygons don't share an edge
+		//The edge of one polygon facing the other is the reference, and the other polygon's most opposing edge is clipped to its sides
+		uint8_t ClipPolygons(const PolygonView& a, const PolygonView& b, const Vector2& normal, std::array<ManifoldPoint, 2>& points)
+		{
+			if (a.vertexCount < 3 || b.vertexCount < 3)
+				return 0;
+
+			double alignmentA, alignmentB;
+			const uint32_t edgeA = FacingEdge(a, Vector2() - normal, alignmentA);
+			const uint32_t edgeB = FacingEdge(b, normal, alignmentB);
+
+			//Prefer b as the reference so the points don't jump between the polygons when the edges are almost parallel
+			const bool flip = alignmentA > alignmentB + 0.001;
+			const PolygonView& reference = flip ? a : b;
+			const PolygonView& incident = flip ? b : a;
+			const uint32_t referenceEdge = flip ? edgeA : edgeB;
+			const Vector2 referenceNormal = EdgeNormal(reference, referenceEdge);
+
+			double alignment;
+			const uint32_t incidentEdge = FacingEdge(incident, Vector2() - referenceNormal, alignment);
+			const ClipVertex edge[2] = {
+				{ incident.vertices[incidentEdge], 0 },
+				{ incident.vertices[incidentEdge < incident.vertexCount - 1 ? incidentEdge + 1 : 0], 1 } };
+
+			//Clip the incident edge to the sides of the reference edge
+			const Vector2& start = reference.vertices[referenceEdge];
+			const Vector2& end = reference.vertices[referenceEdge < reference.vertexCount - 1 ? referenceEdge + 1 : 0];
+			const Vector2 tangent = (end - start).Normalize();
+			ClipVertex clipped[2];
+			ClipVertex result[2];
+			if (ClipSegment(edge, clipped, tangent, tangent.Dot(start), 2) < 2)
+				return 0;
+			if (ClipSegment(clipped, result, Vector2() - tangent, -tangent.Dot(end), 3) < 2)
+				return 0;
+
+			//Keep the points which are behind the reference edge
+			uint8_t count = 0;
+			for (const ClipVertex& vertex : result)
+			{
+				const double separation = (vertex.position - start).Dot(referenceNormal);
+				if (separation > epsilon)
+					continue;
+
+				points[count] = ManifoldPoint{ .position = vertex.position, .depth = -separation,
+					.id = (uint32_t)flip | (referenceEdge & 0x3ff) << 1 | (incidentEdge & 0x3ff) << 11 | vertex.feature << 21 };
+				count++;
+			}
+			return count;
+		}
+	}
+
+	///Update the physics system, call this every frame. Runs as many ticks as the time since the last frame needs
 	void PhysicsSystem::Update()
 	{
-		//For each entity
+		const double tickTime = 1 / tickRate;
+		accumulator = manualTicks ? 0 : accumulator + deltaTime;
+		for (int i = 0; i < maxTicksPerFrame && accumulator >= tickTime; i++)
+		{
+			Tick(tickTime);
+			accumulator -= tickTime;
+		}
+		//Frames too slow to catch up with slow the simulation down
+		if (accumulator >= tickTime)
+			accumulator = std::fmod(accumulator, tickTime);
+
+		//Draw the bodies between their last two ticks. They lag up to a tick behind, but never jump ahead of the simulation
+		const double alpha = GetInterpolationAlpha();
+		UpdatePackedPointers();
+		for (size_t i = 0; i < packedRigidbodies.size(); i++)
+		{
+			const Rigidbody& rigidbody = *packedRigidbodies[i];
+			Transform& transform = *packedTransforms[i];
+			if (!rigidbody.interpolate || !rigidbody.ticked)
+			{
+				transform.renderPositionOffset = Vector3();
+				transform.renderRotationOffset = Vector3();
+				continue;
+			}
+
+			transform.renderPositionOffset = (rigidbody.previousPosition - transform.position) * (1 - alpha);
+			//Rotate the short way around
+			const Vector3 rotation = rigidbody.previousRotation - transform.rotation;
+			transform.renderRotationOffset = Vector3(std::remainder(rotation.x, 360.0), std::remainder(rotation.y, 360.0), std::remainder(rotation.z, 360.0)) * (1 - alpha);
+		}
+	}
+
+	///Simulate tickTime seconds, Update calls this with 1 / tickRate
+	void PhysicsSystem::Tick(double tickTime)
+	{
+		if (!removedBodies.empty())
+		{
+			std::sort(removedBodies.begin(), removedBodies.end());
+			std::erase_if(manifolds, [this](const ContactManifold& manifold)
+				{
+					return std::binary_search(removedBodies.begin(), removedBodies.end(), manifold.a) || std::binary_search(removedBodies.begin(), removedBodies.end(), manifold.b);
+				});
+			removedBodies.clear();
+		}
+
+		//Bodies around changed tiles wake up before they are packed
+		ecs::GetSystem<CollisionSystem>()->InvalidateEditedTiles();
+		PackBodies();
+
+		//Split the movement into steps, every entity moves before collisions are solved
+		//Forces are applied every step, and the contacts found in the previous step hold the bodies in place before they move
+		const double stepTime = tickTime / step;
+		for (int i = 0; i < step; i++)
+		{
+			//Tilemap collisions, ccd bounces and position correction of the last step change the bodies outside of the packed arrays
+			if (i > 0)
+				LoadBodies();
+			IntegrateForces(stepTime);
+			StoreVelocities();
+
+			SolveVelocities();
+			IntegratePositions(stepTime);
+
+			ResolveContacts(false);
+		}
+
+		UpdateSleep();
+	}
+
+	///Look up the components of every body again if they may have moved in memory
+	void PhysicsSystem::UpdatePackedPointers()
+	{
+		//Components only move when one of the same type is added or removed, which is also the only way bodies join or leave the system
+		//The versions only grow, so the sum of the collider versions changes whenever any of them does
+		const uint64_t rigidbodyVersion = ecs::GetComponentVersion<Rigidbody>();
+		const uint64_t transformVersion = ecs::GetComponentVersion<Transform>();
+		const uint64_t colliderVersion = ecs::GetComponentVersion<PolygonCollider>() + ecs::GetComponentVersion<CircleCollider>() + ecs::GetComponentVersion<CapsuleCollider>();
+		if (rigidbodyVersion == packedRigidbodyVersion && transformVersion == packedTransformVersion && colliderVersion == packedColliderVersion)
+			return;
+		packedRigidbodyVersion = rigidbodyVersion;
+		packedTransformVersion = transformVersion;
+		packedColliderVersion = colliderVersion;
+
+		//Bodies are always simulated in entity order, the order of the entity list depends on what has been added and removed before
+		packedEntities.clear();
 		for (const ecs::Entity entity : entities)
+			packedEntities.push_back(entity);
+		std::sort(packedEntities.begin(), packedEntities.end());
+		packedRigidbodies.clear();
+		packedTransforms.clear();
+		packedCollider.clear();
+		for (const ecs::Entity entity : packedEntities)
 		{
-			//Get required components
-			Transform& transform = ecs::GetComponent<Transform>(entity);
 			Rigidbody& rigidbody = ecs::GetComponent<Rigidbody>(entity);
+			rigidbody.packedBody = packedRigidbodies.size();
+			packedRigidbodies.push_back(&rigidbody);
+			packedTransforms.push_back(&ecs::GetComponent<Transform>(entity));
+			packedCollider.push_back(CollisionSystem::HasCollider(entity));
+		}
+	}
 
-			//Don't apply outside forces to kinematic rigidbodies
-			if (!rigidbody.kinematic)
+	///Pack the state of every body into arrays. Sleeping bodies which were moved by hand wake up
+	void PhysicsSystem::PackBodies()
+	{
+		UpdatePackedPointers();
+		const size_t count = packedRigidbodies.size();
+		packedVelocityX.resize(count);
+		packedVelocityY.resize(count);
+		packedVelocityZ.resize(count);
+		packedPositionX.resize(count);
+		packedPositionY.resize(count);
+		packedPositionZ.resize(count);
+		packedGravityFactor.resize(count);
+		packedDrag.resize(count);
+		packedDynamic.resize(count);
+		packedSweep.resize(count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			Rigidbody& rigidbody = *packedRigidbodies[i];
+			const Transform& transform = *packedTransforms[i];
+			//Sleeping bodies which were moved or given velocity by hand wake up
+			if (rigidbody.sleeping && (transform.position != rigidbody.previousPosition || transform.rotation != rigidbody.previousRotation || rigidbody.velocity.Length() != 0))
 			{
-				//Add gravity
-				rigidbody.velocity += gravity * rigidbody.mass * rigidbody.gravityScale * cappedDeltaTime;
-				//Apply drag
-				rigidbody.velocity -= rigidbody.velocity * rigidbody.drag * cappedDeltaTime;
+				rigidbody.sleeping = false;
+				rigidbody.stillTicks = 0;
 			}
-			if ((rigidbody.velocity * cappedDeltaTime).Length() != 0)
+			if (!rigidbody.sleeping)
 			{
-				//Integrate position
-				Move(entity, rigidbody.velocity * cappedDeltaTime, step);
+				rigidbody.previousPosition = transform.position;
+				rigidbody.previousRotation = transform.rotation;
+				rigidbody.ticked = true;
 			}
+
+			const bool dynamic = !rigidbody.kinematic && !rigidbody.sleeping;
+			packedVelocityX[i] = rigidbody.velocity.x;
+			packedVelocityY[i] = rigidbody.velocity.y;
+			packedVelocityZ[i] = rigidbody.velocity.z;
+			packedPositionX[i] = transform.position.x;
+			packedPositionY[i] = transform.position.y;
+			packedPositionZ[i] = transform.position.z;
+			packedGravityFactor[i] = dynamic ? rigidbody.mass * rigidbody.gravityScale : 0;
+			packedDrag[i] = dynamic ? rigidbody.drag : 0;
+			packedDynamic[i] = dynamic;
+			packedSweep[i] = dynamic && rigidbody.ccd && packedCollider[i];
+		}
+	}
+
+	///Apply gravity and drag to the packed velocities
+	void PhysicsSystem::IntegrateForces(double stepTime)
+	{
+		const float gravityStep[3] = { (float)(gravity.x * stepTime), (float)(gravity.y * stepTime), (float)(gravity.z * stepTime) };
+		ApplyForces(packedVelocityX.data(), packedVelocityY.data(), packedVelocityZ.data(), packedGravityFactor.data(), packedDrag.data(), gravityStep, stepTime, packedRigidbodies.size());
+	}
+
+	///Move the bodies which have velocity, ccd bodies are swept. Only the bodies which move are tested for collisions
+	void PhysicsSystem::IntegratePositions(double stepTime)
+	{
+		//The solver only changed the velocities of the bodies in the manifolds
+		for (const ManifoldBodies& bodies : manifoldBodies)
+		{
+			if (bodies.inverseMassA > 0)
+			{
+				packedVelocityX[bodies.a->packedBody] = bodies.a->velocity.x;
+				packedVelocityY[bodies.a->packedBody] = bodies.a->velocity.y;
+			}
+			if (bodies.inverseMassB > 0)
+			{
+				packedVelocityX[bodies.b->packedBody] = bodies.b->velocity.x;
+				packedVelocityY[bodies.b->packedBody] = bodies.b->velocity.y;
+			}
+		}
+
+		IntegrateMovement(packedPositionX.data(), packedPositionY.data(), packedPositionZ.data(), packedVelocityX.data(), packedVelocityY.data(), packedVelocityZ.data(), stepTime, packedRigidbodies.size());
+
+		auto move = [this, stepTime](size_t body)
+			{
+				Transform& transform = *packedTransforms[body];
+				//Fast bodies are swept so they can't pass through anything between steps, the bodies before them have already moved
+				if (packedSweep[body])
+				{
+					const Vector3 movement = SweepMovement(packedEntities[body], Vector3(packedVelocityX[body] * stepTime, packedVelocityY[body] * stepTime, packedVelocityZ[body] * stepTime));
+					packedPositionX[body] = transform.position.x + movement.x;
+					packedPositionY[body] = transform.position.y + movement.y;
+					packedPositionZ[body] = transform.position.z + movement.z;
+				}
+
+				//Same as TransformSystem::Translate without looking the transform up
+				transform.position = Vector3(packedPositionX[body], packedPositionY[body], packedPositionZ[body]);
+				transform.staleCache = true;
+			};
+
+		//Skip the bodies without velocity four at a time, they don't need to be touched at all
+		const size_t count = packedRigidbodies.size();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			for (uint32_t mask = MovingMask(&packedVelocityX[i], &packedVelocityY[i], &packedVelocityZ[i]); mask; mask &= mask - 1)
+				move(i + std::countr_zero(mask));
+		}
+		for (; i < count; i++)
+		{
+			if (packedVelocityX[i] != 0 || packedVelocityY[i] != 0 || packedVelocityZ[i] != 0)
+				move(i);
+		}
+	}
+
+	///Copy the velocities and positions from the rigidbodies and transforms to the packed arrays
+	void PhysicsSystem::LoadBodies()
+	{
+		for (size_t i = 0; i < packedRigidbodies.size(); i++)
+		{
+			const Vector3& velocity = packedRigidbodies[i]->velocity;
+			packedVelocityX[i] = velocity.x;
+			packedVelocityY[i] = velocity.y;
+			packedVelocityZ[i] = velocity.z;
+			const Vector3& position = packedTransforms[i]->position;
+			packedPositionX[i] = position.x;
+			packedPositionY[i] = position.y;
+			packedPositionZ[i] = position.z;
+		}
+	}
+
+	///Copy the velocities of the bodies forces move from the packed arrays to the rigidbodies
+	void PhysicsSystem::StoreVelocities()
+	{
+		for (size_t i = 0; i < packedRigidbodies.size(); i++)
+		{
+			if (packedDynamic[i])
+				packedRigidbodies[i]->velocity = Vector3(packedVelocityX[i], packedVelocityY[i], packedVelocityZ[i]);
 		}
 	}
 
@@ -58,10 +512,21 @@ namespace une
 		{
 			Rigidbody& rbb = ecs::GetComponent<Rigidbody>(collision.b);
 
-			//Calculate new velocities
-			float j = -(1 + (rba.restitution + rbb.restitution) / 2) * (rba.velocity - rbb.velocity).Dot(collision.normal) / collision.normal.Dot(collision.normal * (1 / rba.mass + 1 / rbb.mass));
-			rba.velocity = rba.velocity + collision.normal * (j / rba.mass);
-			rbb.velocity = rbb.velocity - collision.normal * (j / rbb.mass);
+			//Kinematic bodies have infinite mass like in the contact solver, and sleeping bodies wake up before they are pushed
+			const double aInverseMass = rba.kinematic ? 0 : 1 / rba.mass;
+			const double bInverseMass = rbb.kinematic ? 0 : 1 / rbb.mass;
+			if (aInverseMass + bInverseMass > 0)
+			{
+				if (aInverseMass > 0 && rba.sleeping)
+					WakeUp(collision.a);
+				if (bInverseMass > 0 && rbb.sleeping)
+					WakeUp(collision.b);
+
+				//Calculate new velocities
+				float j = -(1 + (rba.restitution + rbb.restitution) / 2) * (rba.velocity - rbb.velocity).Dot(collision.normal) / collision.normal.Dot(collision.normal * (aInverseMass + bInverseMass));
+				rba.velocity = rba.velocity + collision.normal * (j * aInverseMass);
+				rbb.velocity = rbb.velocity - collision.normal * (j * bInverseMass);
+			}
 
 			//Move the entity by the minimum translation vector to make sure it is out of the collision
 			TransformSystem::Translate(collision.a, collision.mtv);
@@ -72,55 +537,551 @@ namespace une
 		return -1;
 	}
 
-	///Solve a collision between an entity and a tilemap, Returns 0 on success, >0 on trigger, and <0 on failure
+	///Detect the collisions of everything that has moved and solve them
+	void PhysicsSystem::SolveCollisions()
+	{
+		ecs::GetSystem<PhysicsSystem>()->ResolveContacts(true);
+	}
+
+	///Solve the collisions between an entity and the tiles it overlaps, Returns 0 on success, >0 on trigger, and <0 on failure
 	int PhysicsSystem::SolveTilemapCollision(std::vector<Collision> collisions)
 	{
 		//No collision, nothing needs to be done
 		if (collisions.empty())
 			return 0;
 
-		//Trigger, nothing needs to be done. Return >0 on trigger
-		if (collisions.front().type == Collision::Type::trigger || collisions.front().type == Collision::Type::tilemapTrigger)
-			return 1;
-		//Nothing needs to be done. Return 0 on success
-		if (collisions.front().type == Collision::Type::miss)
+		//Triggers and misses don't push anything. Return >0 if there were only triggers
+		const ecs::Entity a = collisions.front().a;
+		const bool trigger = std::any_of(collisions.begin(), collisions.end(), [](const Collision& collision) { return collision.type == Collision::Type::tilemapTrigger; });
+		auto notSolid = [](const Collision& collision) { return collision.type != Collision::Type::tilemapCollision; };
+		std::erase_if(collisions, notSolid);
+		if (collisions.empty())
+			return trigger ? 1 : 0;
+
+		//Only rigidbodies are pushed out of tiles, and kinematic ones are moved by hand
+		if (!ecs::HasComponent<Rigidbody>(a))
+			return -1;
+		Rigidbody& rigidbody = ecs::GetComponent<Rigidbody>(a);
+		if (rigidbody.kinematic)
 			return 0;
 
-		ecs::Entity a = collisions.front().a;
-		Collision maxIntersect = Collision{ .mtv = Vector2(0) };
+		//Push the entity out of the deepest tile and test again. Floors and walls made of many tiles are all pushed out of by the first push
+		constexpr int maxPushes = 4;
+		std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+		const float restitutionThreshold = ecs::GetSystem<PhysicsSystem>()->restitutionThreshold;
+		for (int push = 0; push < maxPushes && !collisions.empty(); push++)
+		{
+			const Collision& deepest = *std::max_element(collisions.begin(), collisions.end(), [](const Collision& lhs, const Collision& rhs)
+				{
+					return lhs.mtv.Length() < rhs.mtv.Length();
+				});
+			TransformSystem::Translate(a, deepest.mtv);
+			rigidbody.velocity = BounceVelocity(rigidbody.velocity, deepest.normal, rigidbody.restitution, restitutionThreshold);
+
+			CollisionSystem::UpdateAABB(a);
+			collisions = collisionSystem->CheckTilemapCollision(a);
+			std::erase_if(collisions, notSolid);
+		}
+
+		return 0;
+	}
+
+	///How far the frame is between the latest tick and the next one (0-1), the rendered transforms are interpolated by this
+	double PhysicsSystem::GetInterpolationAlpha() const
+	{
+		if (manualTicks)
+			return 1;
+		return accumulator * tickRate;
+	}
+
+	///Destructor for the Rigidbody component, stops interpolating the transform and drops the manifolds of the body before the next tick
+	void PhysicsSystem::OnRigidbodyRemoved(ecs::Entity entity, Rigidbody& rigidbody)
+	{
+		ecs::GetSystem<PhysicsSystem>()->removedBodies.push_back(entity);
+
+		if (!ecs::HasComponent<Transform>(entity))
+			return;
 
-		//Find the largest collision
-		for (Collision& collision : collisions)
+		Transform& transform = ecs::GetComponent<Transform>(entity);
+		transform.renderPositionOffset = Vector3();
+		transform.renderRotationOffset = Vector3();
+	}
+
+	///Get the contacts solved in the latest step, sorted by entity
+	const std::vector<ContactManifold>& PhysicsSystem::GetManifolds() const
+	{
+		return manifolds;
+	}
+
+	///Get a hash of the bodies and manifolds the next tick depends on, compare it between machines every tick to find desyncs
+	uint64_t PhysicsSystem::GetStateHash()
+	{
+		uint64_t hash = 14695981039346656037ull;
+		auto mix = [&hash](uint64_t value)
+			{
+				hash = (std::rotl(hash, 5) ^ value) * 1099511628211ull;
+			};
+		auto mixVector = [&mix](const Vector3& vector)
+			{
+				mix(std::bit_cast<uint64_t>(vector.x));
+				mix(std::bit_cast<uint64_t>(vector.y));
+				mix(std::bit_cast<uint64_t>(vector.z));
+			};
+
+		UpdatePackedPointers();
+		for (size_t i = 0; i < packedRigidbodies.size(); i++)
+		{
+			const Rigidbody& rigidbody = *packedRigidbodies[i];
+			const Transform& transform = *packedTransforms[i];
+			mix(((uint64_t)packedEntities[i] << 32) | ((uint64_t)rigidbody.sleeping << 31) | rigidbody.stillTicks);
+			mixVector(transform.position);
+			mixVector(transform.rotation);
+			mixVector(rigidbody.velocity);
+		}
+
+		//The impulses are carried over to the next tick, and the manifolds of sleeping bodies are kept as they are instead of being rebuilt
+		for (const ContactManifold& manifold : manifolds)
+		{
+			mix(((uint64_t)manifold.a << 32) | manifold.b);
+			mixVector(Vector3(manifold.normal.x, manifold.normal.y, manifold.bounceVelocity));
+			for (uint8_t j = 0; j < manifold.pointCount; j++)
+			{
+				const ManifoldPoint& point = manifold.points[j];
+				mix(point.id);
+				mixVector(Vector3(point.position.x, point.position.y, point.depth));
+				mix(std::bit_cast<uint64_t>(point.normalImpulse));
+			}
+		}
+		return hash;
+	}
+
+	///Detect the collisions of everything that has moved, push overlapping bodies apart and solve the tilemap collisions
+	void PhysicsSystem::ResolveContacts(bool solveVelocities)
+	{
+		std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+		collisionSystem->DetectCollisions();
+
+		UpdateManifolds(*collisionSystem);
+		if (solveVelocities)
+			SolveVelocities();
+		CorrectPositions();
+
+		//Solve the tilemap collisions of each entity together, contacts are sorted by entity
+		const std::vector<Collision>& tilemapContacts = collisionSystem->GetTilemapContacts();
+		for (auto first = tilemapContacts.begin(); first != tilemapContacts.end();)
+		{
+			auto last = std::find_if(first, tilemapContacts.end(), [first](const Collision& contact) { return contact.a != first->a; });
+			SolveTilemapCollision(std::vector<Collision>(first, last));
+			first = last;
+		}
+	}
+
+
+	///Rebuild the manifolds from the latest contacts, keeping the impulses of the points which persist
+	void PhysicsSystem::UpdateManifolds(CollisionSystem& collisionSystem)
+	{
+		std::swap(manifolds, previousManifolds);
+		manifolds.clear();
+
+		//Both lists are sorted by pair, so walk them together
+		const std::vector<Collision>& contacts = collisionSystem.GetContacts();
+		auto contact = contacts.begin();
+		auto previous = previousManifolds.cbegin();
+		while (contact != contacts.end() || previous != previousManifolds.cend())
 		{
-			if (collision.mtv.Length() > maxIntersect.mtv.Length())
-			{/*
-				if (tileProperties.contains(collision.b))
+			const uint64_t contactKey = contact != contacts.end() ? PairKey(contact->a, contact->b) : UINT64_MAX;
+			const uint64_t previousKey = previous != previousManifolds.cend() ? PairKey(previous->a, previous->b) : UINT64_MAX;
+
+			if (contactKey <= previousKey)
+			{
+				if (contact->type == Collision::Type::collision)
+					AddManifold(collisionSystem, *contact, contactKey == previousKey ? &*previous : nullptr);
+				if (contactKey == previousKey)
+					previous++;
+				contact++;
+			}
+			else
+			{
+				//Pairs which weren't tested again are rebuilt from their latest contact, it may have been found outside of the physics steps
+				//Pairs which are asleep can't have changed, so they are kept as they are
+				const Collision* latest = collisionSystem.GetContact(previous->a, previous->b);
+				if (latest && latest->type == Collision::Type::collision)
 				{
-					//If the tile is set to be a trigger
-					if (!tileProperties[collision.b].trigger)
-						maxIntersect = collision;
+					const Rigidbody* rba = ecs::HasComponent<Rigidbody>(previous->a) ? &ecs::GetComponent<Rigidbody>(previous->a) : nullptr;
+					const Rigidbody* rbb = ecs::HasComponent<Rigidbody>(previous->b) ? &ecs::GetComponent<Rigidbody>(previous->b) : nullptr;
+					if (rba && rbb && (rba->sleeping || rba->kinematic) && (rbb->sleeping || rbb->kinematic) && !(rba->kinematic && rbb->kinematic))
+						manifolds.push_back(*previous);
+					else
+						AddManifold(collisionSystem, *latest, &*previous);
 				}
-				else
+				previous++;
+			}
+		}
+	}
+
+	///Add the manifold of a contact between two rigidbodies, previous is the manifold of the same pair from the last step or null
+	void PhysicsSystem::AddManifold(CollisionSystem& collisionSystem, const Collision& contact, const ContactManifold* previous)
+	{
+		if (!ecs::HasComponent<Rigidbody>(contact.a) || !ecs::HasComponent<Rigidbody>(contact.b))
+			return;
+		const Rigidbody& rba = ecs::GetComponent<Rigidbody>(contact.a);
+		const Rigidbody& rbb = ecs::GetComponent<Rigidbody>(contact.b);
+		if (rba.kinematic && rbb.kinematic)
+			return;
+
+		ContactManifold manifold{ .a = contact.a, .b = contact.b };
+		const Vector2 mtv(contact.mtv.x, contact.mtv.y);
+		const double depth = mtv.Length();
+		if (depth > epsilon)
+		{
+			manifold.normal = mtv / depth;
+		}
+		else
+		{
+			//Only just touching, point the normal from b to a
+			const Vector3 offset = ecs::GetComponent<Transform>(contact.a).position - ecs::GetComponent<Transform>(contact.b).position;
+			manifold.normal = Vector2(contact.normal.x, contact.normal.y).Normalize();
+			if (manifold.normal.Dot(Vector2(offset.x, offset.y)) < 0)
+				manifold.normal = Vector2() - manifold.normal;
+		}
+
+		//Polygons touching along an edge get a point at both ends of the shared part, everything else touches at one point
+		if (ecs::HasComponent<PolygonCollider>(contact.a) && ecs::HasComponent<PolygonCollider>(contact.b))
+			manifold.pointCount = ClipPolygons(collisionSystem.GetWorldPolygon(contact.a), collisionSystem.GetWorldPolygon(contact.b), manifold.normal, manifold.points);
+		if (manifold.pointCount == 0)
+		{
+			manifold.points[0] = ManifoldPoint{ .position = Vector2(contact.point.x, contact.point.y), .depth = depth };
+			manifold.pointCount = 1;
+		}
+
+		//Points which were there last step start from their old impulse
+		if (previous)
+		{
+			for (uint8_t i = 0; i < manifold.pointCount; i++)
+			{
+				for (uint8_t j = 0; j < previous->pointCount; j++)
 				{
-					maxIntersect = collision;
-				}*/
+					if (manifold.points[i].id == previous->points[j].id)
+						manifold.points[i].normalImpulse = previous->points[j].normalImpulse;
+				}
 			}
 		}
-		//Solve the largest collision
-		if (maxIntersect.type == Collision::Type::tilemapCollision)
+
+		//Bounce if they are approaching fast enough, before the old impulses change the velocities
+		const double approachVelocity = (rba.velocity - rbb.velocity).Dot(manifold.normal);
+		if (approachVelocity < -restitutionThreshold)
+			manifold.bounceVelocity = -(rba.restitution + rbb.restitution) / 2 * approachVelocity;
+
+		manifolds.push_back(manifold);
+	}
+
+	///Apply the impulses of the last step and solve the velocities of the bodies in the manifolds
+	void PhysicsSystem::SolveVelocities()
+	{
+		//Islands share no moving body, so each batch can be solved on its own thread and the result doesn't depend on the thread count
+		BuildSolverIslands();
+		GetThreadPool().ParallelFor(solverBatches.size() - 1, 1, [this](size_t begin, size_t end, unsigned int)
+			{
+				for (size_t batch = begin; batch < end; batch++)
+					SolveIslandVelocities(solverBatches[batch], solverBatches[batch + 1]);
+			});
+
+		//Only bounce once
+		for (ContactManifold& manifold : manifolds)
+			manifold.bounceVelocity = 0;
+	}
+
+	///Push the bodies of the manifolds apart by part of their overlap, split by their masses
+	void PhysicsSystem::CorrectPositions()
+	{
+		BuildSolverIslands();
+		GetThreadPool().ParallelFor(solverBatches.size() - 1, 1, [this](size_t begin, size_t end, unsigned int)
+			{
+				for (size_t batch = begin; batch < end; batch++)
+					CorrectIslandPositions(solverBatches[batch], solverBatches[batch + 1]);
+			});
+	}
+
+	///Gather the bodies of the manifolds and group the manifolds into islands which share no moving body, batching the small islands together
+	void PhysicsSystem::BuildSolverIslands()
+	{
+		//Gather the bodies once, the solver only touches their velocities and positions
+		manifoldBodies.clear();
+		for (const ContactManifold& manifold : manifolds)
 		{
-			TransformSystem::Translate(a, maxIntersect.mtv);
+			Rigidbody& rba = ecs::GetComponent<Rigidbody>(manifold.a);
+			Rigidbody& rbb = ecs::GetComponent<Rigidbody>(manifold.b);
+			//Sleeping bodies stay where they are until the end of the tick, when the island wakes up
+			manifoldBodies.push_back(ManifoldBodies{ &rba, &rbb, &ecs::GetComponent<Transform>(manifold.a), &ecs::GetComponent<Transform>(manifold.b),
+				rba.kinematic || rba.sleeping ? 0 : 1.0 / rba.mass, rbb.kinematic || rbb.sleeping ? 0 : 1.0 / rbb.mass });
 		}
 
-		//Check collision again
-		collisions = ecs::GetSystem<CollisionSystem>()->CheckTilemapCollision(a);
+		//Number the bodies which can move. The others are never written to, so every island can share them
+		constexpr uint32_t noBody = UINT32_MAX;
+		for (const ManifoldBodies& bodies : manifoldBodies)
+		{
+			bodies.a->solverBody = noBody;
+			bodies.b->solverBody = noBody;
+		}
+		solverParents.clear();
+		for (const ManifoldBodies& bodies : manifoldBodies)
+		{
+			if (bodies.inverseMassA > 0 && bodies.a->solverBody == noBody)
+			{
+				bodies.a->solverBody = solverParents.size();
+				solverParents.push_back(solverParents.size());
+			}
+			if (bodies.inverseMassB > 0 && bodies.b->solverBody == noBody)
+			{
+				bodies.b->solverBody = solverParents.size();
+				solverParents.push_back(solverParents.size());
+			}
+		}
 
-		//Calculate new velocities
-		Rigidbody& rba = ecs::GetComponent<Rigidbody>(a);
-		Vector3 newAVeclocity = rba.velocity - maxIntersect.normal * 2 * rba.velocity.Dot(maxIntersect.normal);
-		rba.velocity = newAVeclocity * rba.restitution;
+		//Join the moving bodies which touch
+		for (const ManifoldBodies& bodies : manifoldBodies)
+		{
+			if (bodies.inverseMassA == 0 || bodies.inverseMassB == 0)
+				continue;
+			const uint32_t rootA = FindIsland(solverParents, bodies.a->solverBody);
+			const uint32_t rootB = FindIsland(solverParents, bodies.b->solverBody);
+			if (rootA != rootB)
+				solverParents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+		}
 
-		return 0;
+		//Island of a manifold, manifolds without a moving body aren't solved at all
+		auto manifoldIsland = [this](const ManifoldBodies& bodies)
+			{
+				if (bodies.inverseMassA > 0)
+					return FindIsland(solverParents, bodies.a->solverBody);
+				if (bodies.inverseMassB > 0)
+					return FindIsland(solverParents, bodies.b->solverBody);
+				return noBody;
+			};
+
+		//Count the manifolds of each island and turn the counts into where each island starts. Large islands get a batch of their own
+		solverIslandSizes.assign(solverParents.size(), 0);
+		for (const ManifoldBodies& bodies : manifoldBodies)
+		{
+			const uint32_t island = manifoldIsland(bodies);
+			if (island != noBody)
+				solverIslandSizes[island]++;
+		}
+		solverBatches.clear();
+		uint32_t start = 0;
+		uint32_t batchSize = 0;
+		for (uint32_t& islandStart : solverIslandSizes)
+		{
+			const uint32_t islandSize = islandStart;
+			islandStart = start;
+			if (islandSize == 0)
+				continue;
+
+			if (batchSize == 0 || islandSize >= islandBatchSize)
+			{
+				solverBatches.push_back(start);
+				batchSize = 0;
+			}
+			start += islandSize;
+			batchSize += islandSize;
+			if (batchSize >= islandBatchSize)
+				batchSize = 0;
+		}
+		solverBatches.push_back(start);
+
+		//Counting sort keeps the manifolds of each island in the order the serial solver would visit them
+		solverOrder.resize(start);
+		for (uint32_t i = 0; i < manifoldBodies.size(); i++)
+		{
+			const uint32_t island = manifoldIsland(manifoldBodies[i]);
+			if (island != noBody)
+				solverOrder[solverIslandSizes[island]++] = i;
+		}
+	}
+
+	///Solve the velocities of the manifolds in solverOrder[begin, end)
+	void PhysicsSystem::SolveIslandVelocities(size_t begin, size_t end)
+	{
+		//Apply an impulse along the normal of a manifold. Bodies which can't move may be shared with other islands, so they aren't written to
+		auto applyImpulse = [](const ContactManifold& manifold, const ManifoldBodies& bodies, double impulse)
+			{
+				if (bodies.inverseMassA > 0)
+				{
+					bodies.a->velocity.x += manifold.normal.x * impulse * bodies.inverseMassA;
+					bodies.a->velocity.y += manifold.normal.y * impulse * bodies.inverseMassA;
+				}
+				if (bodies.inverseMassB > 0)
+				{
+					bodies.b->velocity.x -= manifold.normal.x * impulse * bodies.inverseMassB;
+					bodies.b->velocity.y -= manifold.normal.y * impulse * bodies.inverseMassB;
+				}
+			};
+
+		//Warm start from the impulses of the last step, a resting body is held up before the iterations start
+		for (size_t k = begin; k < end; k++)
+		{
+			const uint32_t i = solverOrder[k];
+			for (uint8_t j = 0; j < manifolds[i].pointCount; j++)
+				applyImpulse(manifolds[i], manifoldBodies[i], manifolds[i].points[j].normalImpulse);
+		}
+
+		//Sequential impulses, every point pushes until the bodies stop approaching. The total impulse of a point can never pull
+		for (int iteration = 0; iteration < velocityIterations; iteration++)
+		{
+			for (size_t k = begin; k < end; k++)
+			{
+				ContactManifold& manifold = manifolds[solverOrder[k]];
+				const ManifoldBodies& bodies = manifoldBodies[solverOrder[k]];
+				const double normalMass = 1 / (bodies.inverseMassA + bodies.inverseMassB);
+				for (uint8_t j = 0; j < manifold.pointCount; j++)
+				{
+					const double normalVelocity = (bodies.a->velocity.x - bodies.b->velocity.x) * manifold.normal.x + (bodies.a->velocity.y - bodies.b->velocity.y) * manifold.normal.y;
+					double& total = manifold.points[j].normalImpulse;
+					const double newTotal = std::max(total + (manifold.bounceVelocity - normalVelocity) * normalMass, 0.0);
+					applyImpulse(manifold, bodies, newTotal - total);
+					total = newTotal;
+				}
+			}
+		}
+	}
+
+	///Correct the positions of the manifolds in solverOrder[begin, end)
+	void PhysicsSystem::CorrectIslandPositions(size_t begin, size_t end)
+	{
+		for (size_t k = begin; k < end; k++)
+		{
+			const ContactManifold& manifold = manifolds[solverOrder[k]];
+			const ManifoldBodies& bodies = manifoldBodies[solverOrder[k]];
+
+			double depth = 0;
+			for (uint8_t j = 0; j < manifold.pointCount; j++)
+				depth = std::max(depth, manifold.points[j].depth);
+			const double correction = std::max(depth - allowedPenetration, 0.0) * positionCorrection / (bodies.inverseMassA + bodies.inverseMassB);
+			if (correction <= 0)
+				continue;
+
+			//Same as TransformSystem::Translate, without looking the transforms up again
+			if (bodies.inverseMassA > 0)
+			{
+				bodies.transformA->position += Vector3(manifold.normal * (correction * bodies.inverseMassA));
+				bodies.transformA->staleCache = true;
+			}
+			if (bodies.inverseMassB > 0)
+			{
+				bodies.transformB->position += Vector3(manifold.normal * (-correction * bodies.inverseMassB));
+				bodies.transformB->staleCache = true;
+			}
+		}
+	}
+
+	///Group the bodies into islands which touch each other and put the islands which have been still long enough to sleep
+	void PhysicsSystem::UpdateSleep()
+	{
+		//Every packed body starts as its own island. Kinematic bodies never join one, otherwise everything resting on the same ground would be one island
+		constexpr uint32_t kinematicBody = UINT32_MAX;
+		const uint32_t bodyCount = packedRigidbodies.size();
+		islandParents.resize(bodyCount);
+		bodyStillTicks.resize(bodyCount);
+		for (uint32_t i = 0; i < bodyCount; i++)
+		{
+			islandParents[i] = i;
+			Rigidbody& rigidbody = *packedRigidbodies[i];
+			if (rigidbody.kinematic)
+			{
+				bodyStillTicks[i] = kinematicBody;
+				continue;
+			}
+
+			if (!rigidbody.sleeping)
+			{
+				if (!rigidbody.canSleep || rigidbody.velocity.Length() > sleepVelocity)
+					rigidbody.stillTicks = 0;
+				else if (rigidbody.stillTicks < ticksToSleep)
+					rigidbody.stillTicks++;
+			}
+			bodyStillTicks[i] = rigidbody.stillTicks;
+		}
+
+		//Join the bodies which touch, moving kinematic bodies wake up what they touch instead
+		//Bodies which are still being pushed apart aren't still either, otherwise they would sleep overlapping
+		auto notStill = [this](Rigidbody& rigidbody)
+			{
+				rigidbody.stillTicks = 0;
+				bodyStillTicks[rigidbody.packedBody] = 0;
+			};
+		for (const ContactManifold& manifold : manifolds)
+		{
+			Rigidbody& rba = ecs::GetComponent<Rigidbody>(manifold.a);
+			Rigidbody& rbb = ecs::GetComponent<Rigidbody>(manifold.b);
+			double depth = 0;
+			for (uint8_t i = 0; i < manifold.pointCount; i++)
+				depth = std::max(depth, manifold.points[i].depth);
+			if (depth > allowedPenetration * 2)
+			{
+				if (!rba.kinematic && !rba.sleeping)
+					notStill(rba);
+				if (!rbb.kinematic && !rbb.sleeping)
+					notStill(rbb);
+			}
+
+			if (!rba.kinematic && !rbb.kinematic)
+			{
+				const uint32_t rootA = FindIsland(islandParents, rba.packedBody);
+				const uint32_t rootB = FindIsland(islandParents, rbb.packedBody);
+				if (rootA != rootB)
+					islandParents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+			}
+			else if (!rba.kinematic && rbb.velocity.Length() != 0)
+			{
+				notStill(rba);
+			}
+			else if (!rbb.kinematic && rba.velocity.Length() != 0)
+			{
+				notStill(rbb);
+			}
+		}
+
+		//An island sleeps once every body in it has been still for long enough, and wakes up as soon as one of them moves
+		islandStillTicks.assign(bodyCount, ticksToSleep);
+		for (uint32_t i = 0; i < bodyCount; i++)
+		{
+			if (bodyStillTicks[i] == kinematicBody)
+				continue;
+			uint32_t& stillTicks = islandStillTicks[FindIsland(islandParents, i)];
+			stillTicks = std::min(stillTicks, bodyStillTicks[i]);
+		}
+		//Only the bodies which fall asleep or wake up are touched
+		for (uint32_t i = 0; i < bodyCount; i++)
+		{
+			if (bodyStillTicks[i] == kinematicBody)
+				continue;
+
+			const bool sleep = islandStillTicks[FindIsland(islandParents, i)] >= ticksToSleep;
+			const bool sleeping = !packedDynamic[i];
+			if (sleep == sleeping)
+				continue;
+
+			Rigidbody& rigidbody = *packedRigidbodies[i];
+			rigidbody.sleeping = sleep;
+			if (sleep)
+			{
+				//Asleep bodies are drawn where they stopped
+				rigidbody.velocity = Vector3();
+				rigidbody.previousPosition = packedTransforms[i]->position;
+				rigidbody.previousRotation = packedTransforms[i]->rotation;
+			}
+		}
+	}
+
+	///Find the island of a body in a union-find, halving the path on the way
+	uint32_t PhysicsSystem::FindIsland(std::vector<uint32_t>& parents, uint32_t body)
+	{
+		while (parents[body] != body)
+		{
+			parents[body] = parents[parents[body]];
+			body = parents[body];
+		}
+		return body;
 	}
 
 
@@ -129,20 +1090,21 @@ namespace une
 	///Move an entity while checking for collision, assuming entity has collider
 	void PhysicsSystem::Move(ecs::Entity entity, Vector3 amount, int steps)
 	{
-		Transform& transform = ecs::GetComponent<Transform>(entity);
-		transform.staleCache = true;
+		if (ecs::HasComponent<Rigidbody>(entity))
+			WakeUp(entity);
 
 		//Split the movement into steps
+		std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
 		for (int i = 0; i < steps; i++)
 		{
 			TransformSystem::Translate(entity, amount / steps);
 
-			//Check collision if entity has collider
-			if (ecs::HasComponent<PolygonCollider>(entity))
+			//Check collision if entity has collider, only the moved entity's contacts are solved. The manifolds are left to the next tick
+			if (CollisionSystem::HasCollider(entity))
 			{
 				CollisionSystem::UpdateAABB(entity);
 				//Check entity and tilemap collision
-				std::vector<Collision> collisions = ecs::GetSystem<CollisionSystem>()->CheckCollision(entity);
+				std::vector<Collision> collisions = collisionSystem->CheckCollision(entity);
 				std::vector<Collision> tilemapCollisions;
 
 				//Solve each entity collision
@@ -162,9 +1124,52 @@ namespace une
 		}
 	}
 
+	///Shorten the movement of a ccd entity to where it first hits a rigidbody or tile, and bounce it off what it hit
+	Vector3 PhysicsSystem::SweepMovement(ecs::Entity entity, Vector3 movement)
+	{
+		//Distance kept from the surface hit, so the next sweep doesn't start touching it
+		constexpr double skin = 0.01;
+
+		const Vector2 movement2D(movement.x, movement.y);
+		const double distance = movement2D.Length();
+		if (distance == 0)
+			return movement;
+
+		//Sweep the collider's current shape along the movement, the broadphase is searched with the swept bounds
+		std::shared_ptr<CollisionSystem> collisionSystem = ecs::GetSystem<CollisionSystem>();
+		CollisionSystem::UpdateAABB(entity);
+		collisionSystem->GetColliderCast(entity, sweepQuery);
+		sweepQuery.direction = movement2D;
+		sweepQuery.maxDistance = distance;
+		collisionSystem->ShapeCastAll(sweepQuery, sweepHits);
+
+		for (const QueryHit& hit : sweepHits)
+		{
+			//Colliders without rigidbodies aren't solved by the discrete step either, the body passes through them
+			if (hit.tileGID == 0 && !ecs::HasComponent<Rigidbody>(hit.entity))
+				continue;
+			//Bodies which already touch something are left to the discrete step
+			if (hit.distance == 0)
+				return movement;
+
+			Rigidbody& rigidbody = ecs::GetComponent<Rigidbody>(entity);
+			if (hit.tileGID != 0)
+				//Bounce off the tile the same way SolveTilemapCollision does
+				rigidbody.velocity = BounceVelocity(rigidbody.velocity, hit.normal, rigidbody.restitution, restitutionThreshold);
+			else
+				SimpleSolveCollision(Collision{ .type = Collision::Type::collision, .a = entity, .b = hit.entity, .point = hit.point, .normal = hit.normal, .mtv = Vector2() });
+
+			//Stop just before the hit, the rest of the movement is dropped
+			const Vector2 stop = movement2D * (std::max(hit.distance - skin, 0.0) / distance);
+			return Vector3(stop.x, stop.y, movement.z);
+		}
+		return movement;
+	}
+
 	///Add an impulse to entity, does not include deltaTime
 	inline void PhysicsSystem::Impulse(ecs::Entity entity, Vector3 velocity)
 	{
+		WakeUp(entity);
 		Rigidbody& rigidbody = ecs::GetComponent<Rigidbody>(entity);
 		rigidbody.velocity += velocity * rigidbody.mass;
 	}
@@ -175,7 +1180,16 @@ namespace une
 		//Physics dt is capped at 20 fps, less than that will slow down physics to stop impercision
 		float cappedDt = std::min(une::deltaTime, 1.0 / 20.0);
 
+		WakeUp(entity);
 		Rigidbody& rigidbody = ecs::GetComponent<Rigidbody>(entity);
 		rigidbody.velocity += velocity * cappedDt * rigidbody.mass;
 	}
+
+	///Wake up a sleeping body, the bodies touching it wake up at the end of the tick
+	void PhysicsSystem::WakeUp(ecs::Entity entity)
+	{
+		Rigidbody& rigidbody = ecs::GetComponent<Rigidbody>(entity);
+		rigidbody.sleeping = false;
+		rigidbody.stillTicks = 0;
+	}
 }
\ No newline at end of file
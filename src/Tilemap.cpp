@@ -1,9 +1,19 @@
 #include "Tilemap.h"
 
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <type_traits>
 
 #include "tmxlite/Map.hpp"
 #include "tmxlite/TileLayer.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
 
 #include "Vector.h"
 #include "debug/Logging.h"
@@ -12,165 +22,698 @@
 #include "renderer/gl/Texture.h"
 #include "renderer/gl/Window.h"
 #include "utils/ResourceManagement.h"
+#include "utils/ThreadPool.h"
 
 namespace une
 {
-	MapLayer::MapLayer(const tmx::Map* map, uint32_t i, const std::vector<Texture*>& textures, std::unordered_map<std::string, tmx::Property> layerProperties)
+	namespace
+	{
+		//Index of the tileset containing a gid, or the amount of tilesets if none does. Tilesets are ordered by their first gid
+		uint32_t FindTileset(const std::vector<TilesetRange>& tilesets, uint32_t gid)
+		{
+			const auto next = std::upper_bound(tilesets.begin(), tilesets.end(), gid, [](uint32_t gid, const TilesetRange& range)
+				{
+					return gid < range.firstGID;
+				});
+			if (next == tilesets.begin() || gid > std::prev(next)->lastGID)
+				return tilesets.size();
+			return std::prev(next) - tilesets.begin();
+		}
+
+		//Bytes of lookup textures UploadChunk adds for built chunk data
+		size_t LookupBytes(const MapLayer::ChunkData& data)
+		{
+			size_t bytes = 0;
+			for (const std::vector<uint16_t>& lookup : data.lookups)
+				bytes += lookup.size() * sizeof(uint16_t);
+			return bytes;
+		}
+
+		//Start of every cooked map, the version changes whenever the layout does
+		constexpr char cookedMagic[4] = { 'U', 'N', 'M', 'P' };
+		constexpr uint32_t cookedVersion = 3;
+
+		//Appends values to a cooked map in memory, arrays are stored as their length followed by their elements
+		struct CookedWriter
+		{
+			template<typename T>
+			void Write(const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be cooked");
+				const char* bytes = reinterpret_cast<const char*>(&value);
+				data.insert(data.end(), bytes, bytes + sizeof(T));
+			}
+			template<typename T>
+			void WriteArray(const std::vector<T>& values)
+			{
+				static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be cooked");
+				Write((uint64_t)values.size());
+				const char* bytes = reinterpret_cast<const char*>(values.data());
+				data.insert(data.end(), bytes, bytes + values.size() * sizeof(T));
+			}
+			void WriteString(const std::string& value)
+			{
+				Write((uint32_t)value.size());
+				data.insert(data.end(), value.begin(), value.end());
+			}
+
+			std::vector<char> data;
+		};
+
+		//Reads values from a cooked map in memory, every read fails once the data runs out
+		class CookedReader
+		{
+		public:
+			explicit CookedReader(const std::vector<char>& data) : data(data) {}
+
+			template<typename T>
+			bool Read(T& value)
+			{
+				if (sizeof(T) > data.size() - head)
+					return false;
+				memcpy(&value, data.data() + head, sizeof(T));
+				head += sizeof(T);
+				return true;
+			}
+			template<typename T>
+			bool ReadArray(std::vector<T>& values)
+			{
+				uint64_t count = 0;
+				if (!Read(count) || count > (data.size() - head) / sizeof(T))
+					return false;
+				values.resize(count);
+				if (count > 0)
+					memcpy(values.data(), data.data() + head, count * sizeof(T));
+				head += count * sizeof(T);
+				return true;
+			}
+			bool ReadString(std::string& value)
+			{
+				uint32_t size = 0;
+				if (!Read(size) || size > data.size() - head)
+					return false;
+				value.assign(data.data() + head, size);
+				head += size;
+				return true;
+			}
+
+		private:
+			const std::vector<char>& data;
+			size_t head = 0;
+		};
+
+		//Paths of the external .tsx tilesets a tmx map uses. tmxlite doesn't keep them, so they're read from the map's tileset elements
+		std::vector<std::string> ExternalTilesetPaths(const std::string& tmxPath)
+		{
+			std::ifstream file(tmxPath, std::ios::binary);
+			const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			const std::filesystem::path directory = std::filesystem::path(tmxPath).parent_path();
+			std::vector<std::string> paths;
+			for (size_t start = text.find("<tileset"); start != std::string::npos; start = text.find("<tileset", start + 1))
+			{
+				//Only the element's own attributes, an embedded tileset's image also has a source
+				const size_t end = text.find('>', start);
+				const size_t source = text.find("source=\"", start);
+				if (source == std::string::npos || source > end)
+					continue;
+				const size_t begin = source + sizeof("source=\"") - 1;
+				const size_t close = text.find('"', begin);
+				if (close < end)
+					paths.push_back((directory / text.substr(begin, close - begin)).lexically_normal().string());
+			}
+			return paths;
+		}
+
+		//Last write time of a file as a number which can be cooked, older than any file if it can't be read
+		//The clock's epoch can be in the future, so 0 isn't older than every file
+		int64_t WriteTime(const std::string& path)
+		{
+			std::error_code error;
+			const std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+			return error ? std::numeric_limits<int64_t>::min() : (int64_t)time.time_since_epoch().count();
+		}
+
+		//Path stored in a cooked map, relative to the cooked map's directory when possible
+		std::string CookedPath(const std::string& path, const std::filesystem::path& directory)
+		{
+			std::error_code error;
+			const std::filesystem::path relative = std::filesystem::relative(path, directory.empty() ? "." : directory, error);
+			return error || relative.empty() ? path : relative.generic_string();
+		}
+
+		//Layer properties of these types are kept in cooked maps, the rest are only available when loading the tmx
+		bool IsCookableProperty(const tmx::Property& property)
+		{
+			const tmx::Property::Type type = property.getType();
+			return type == tmx::Property::Type::Boolean || type == tmx::Property::Type::Float || type == tmx::Property::Type::Int
+				|| type == tmx::Property::Type::String || type == tmx::Property::Type::File;
+		}
+		void WriteProperty(CookedWriter& writer, const tmx::Property& property)
+		{
+			writer.Write((uint8_t)property.getType());
+			switch (property.getType())
+			{
+			case tmx::Property::Type::Boolean:
+				writer.Write((uint8_t)property.getBoolValue());
+				break;
+			case tmx::Property::Type::Float:
+				writer.Write(property.getFloatValue());
+				break;
+			case tmx::Property::Type::Int:
+				writer.Write((int32_t)property.getIntValue());
+				break;
+			case tmx::Property::Type::File:
+				writer.WriteString(property.getFileValue());
+				break;
+			default:
+				writer.WriteString(property.getStringValue());
+				break;
+			}
+		}
+		bool ReadProperty(CookedReader& reader, tmx::Property::Type type, tmx::Property& property)
+		{
+			uint8_t boolValue = 0;
+			float floatValue = 0;
+			int32_t intValue = 0;
+			std::string stringValue;
+			switch (type)
+			{
+			case tmx::Property::Type::Boolean:
+				return reader.Read(boolValue) && (property = tmx::Property::fromBoolean(boolValue), true);
+			case tmx::Property::Type::Float:
+				return reader.Read(floatValue) && (property = tmx::Property::fromFloat(floatValue), true);
+			case tmx::Property::Type::Int:
+				return reader.Read(intValue) && (property = tmx::Property::fromInt(intValue), true);
+			case tmx::Property::Type::File:
+				return reader.ReadString(stringValue) && (property = tmx::Property::fromFile(stringValue), true);
+			case tmx::Property::Type::String:
+				return reader.ReadString(stringValue) && (property = tmx::Property::fromString(stringValue), true);
+			default:
+				return false;
+			}
+		}
+
+		//Do the tile colliders read from a cooked map stay inside the vertices and tilesets
+		template<typename TileData>
+		bool ValidateCookedTiles(const std::vector<TileData>& tileData, const std::vector<Vector2>& colliderVertices, size_t tilesetCount)
+		{
+			if (colliderVertices.size() < 4)
+				return false;
+			for (const TileData& data : tileData)
+			{
+				if ((uint64_t)data.colliderOffset + data.colliderCount > colliderVertices.size() || (data.flags != 0 && data.tileset >= tilesetCount))
+					return false;
+			}
+			return true;
+		}
+
+		//Do the arrays read from a cooked layer fit together, so nothing reads outside of them later
+		bool ValidateCookedLayer(const MapLayer& layer, size_t tilesetCount)
+		{
+			if (layer.tiles.size() != (size_t)layer.width * layer.height || layer.flipFlags.size() != layer.tiles.size())
+				return false;
+			for (const MapLayer::ColliderBox& box : layer.colliderBoxes)
+			{
+				if (box.width == 0 || box.height == 0 || (uint64_t)box.x + box.width > layer.width || (uint64_t)box.y + box.height > layer.height)
+					return false;
+			}
+
+			if (layer.bakedChunks.empty())
+				return true;
+			if (layer.bakedChunks.size() != (size_t)layer.chunkColumns * layer.chunkRows)
+				return false;
+			for (uint32_t chunk = 0; chunk < layer.bakedChunks.size(); chunk++)
+			{
+				const MapLayer::BakedChunk& baked = layer.bakedChunks[chunk];
+				const uint64_t chunkX = (chunk % layer.chunkColumns) * (uint64_t)layer.chunkSize;
+				const uint64_t chunkY = (chunk / layer.chunkColumns) * (uint64_t)layer.chunkSize;
+				const uint64_t lookupSize = std::min<uint64_t>(layer.chunkSize, layer.width - chunkX) * std::min<uint64_t>(layer.chunkSize, layer.height - chunkY) * 2;
+				if ((uint64_t)baked.firstTileset + baked.tilesetCount > layer.bakedTilesets.size()
+					|| baked.lookupOffset + baked.tilesetCount * lookupSize > layer.bakedLookups.size())
+					return false;
+			}
+			for (uint32_t tileset : layer.bakedTilesets)
+			{
+				if (tileset >= tilesetCount)
+					return false;
+			}
+			return true;
+		}
+
+		//Tiled coordinates of the top left tile and the size in tiles of an infinite map, covering the chunks of every layer
+		void InfiniteMapBounds(const tmx::Map* map, Vector2Int& offset, Vector2Int& size)
+		{
+			int64_t minX = INT64_MAX, minY = INT64_MAX, maxX = INT64_MIN, maxY = INT64_MIN;
+			for (const auto& layer : map->getLayers())
+			{
+				if (layer->getType() != tmx::Layer::Type::Tile)
+					continue;
+				for (const tmx::TileLayer::Chunk& chunk : layer->getLayerAs<tmx::TileLayer>().getChunks())
+				{
+					minX = std::min<int64_t>(minX, chunk.position.x);
+					minY = std::min<int64_t>(minY, chunk.position.y);
+					maxX = std::max<int64_t>(maxX, chunk.position.x + chunk.size.x);
+					maxY = std::max<int64_t>(maxY, chunk.position.y + chunk.size.y);
+				}
+			}
+
+			if (minX > maxX)
+			{
+				offset = Vector2Int(0, 0);
+				size = Vector2Int(0, 0);
+				return;
+			}
+			offset = Vector2Int(minX, minY);
+			size = Vector2Int(maxX - minX, maxY - minY);
+		}
+	}
+
+	MapLayer::MapLayer(const tmx::Map* map, uint32_t i, const std::vector<TilesetRange>& tilesets, std::unordered_map<std::string, tmx::Property> layerProperties, uint32_t chunkSize)
 	{
-		tilesetTextures = textures;
 		index = i;
 		properties = layerProperties;
+		this->tilesets = &tilesets;
+		this->chunkSize = std::max(chunkSize, 1u);
 
 		//Set some properties
 		enabled = map->getLayers()[i]->getVisible();
 		//If layer has a specified z offset set it here
 		if (properties.contains("zoffset"))
 			zOffset = properties["zoffset"].getFloatValue();
-
-		//If the layer has collision enabled give it a collider
+		//If the layer has collision enabled its tiles are colliders
 		if (properties.contains("collision"))
+			hasCollision = properties["collision"].getBoolValue();
+
+		const auto& layers = map->getLayers();
+		if (index >= layers.size() || layers[index]->getType() != tmx::Layer::Type::Tile)
+		{
+			debug::LogWarning("Invalid tilemap layer index or layer type, layer will be empty");
+			return;
+		}
+
+		//Keep the GIDs and flip flags, the chunks' lookup textures are built from them when they are loaded
+		const tmx::TileLayer& tileLayer = layers[index]->getLayerAs<tmx::TileLayer>();
+		if (map->isInfinite())
 		{
-			if (properties["collision"].getBoolValue())
+			//Tiled's chunks are copied into the same grid, starting from the top left chunk of the whole map
+			Vector2Int offset, size;
+			InfiniteMapBounds(map, offset, size);
+			width = size.x;
+			height = size.y;
+			tiles.resize((size_t)width * height, 0);
+			flipFlags.resize(tiles.size(), 0);
+			for (const tmx::TileLayer::Chunk& chunk : tileLayer.getChunks())
 			{
-				//Get the tile GIDs
-				auto& tiles = map->getLayers()[i]->getLayerAs<tmx::TileLayer>().getTiles();
-				hasCollision = true;
-				//Transfer the tile GIDs to the 2D collision vector
-				collider.resize(map->getTileCount().x);
-				for (int x = 0; x < map->getTileCount().x; x++)
+				for (int y = 0; y < chunk.size.y; y++)
 				{
-					collider[x].resize(map->getTileCount().y);
-					for (int y = 0; y < map->getTileCount().y; y++)
+					for (int x = 0; x < chunk.size.x; x++)
 					{
-						collider[x][y] = tiles[y * collider.size() + x].ID;
+						const tmx::TileLayer::Tile& tile = chunk.tiles[y * chunk.size.x + x];
+						const size_t destination = (size_t)(chunk.position.y - offset.y + y) * width + (chunk.position.x - offset.x + x);
+						tiles[destination] = tile.ID;
+						flipFlags[destination] = tile.flipFlags;
 					}
 				}
 			}
 		}
+		else
+		{
+			//Tiled stores the tiles in the same row-major order
+			width = map->getTileCount().x;
+			height = map->getTileCount().y;
+			const auto& layerTiles = tileLayer.getTiles();
+			tiles.resize(std::min<size_t>((size_t)width * height, layerTiles.size()));
+			flipFlags.resize(tiles.size());
+			for (size_t tile = 0; tile < tiles.size(); tile++)
+			{
+				tiles[tile] = layerTiles[tile].ID;
+				flipFlags[tile] = layerTiles[tile].flipFlags;
+			}
+			tiles.resize((size_t)width * height, 0);
+			flipFlags.resize(tiles.size(), 0);
+		}
 
-		CreateSubsets(map);
+		chunkColumns = (width + this->chunkSize - 1) / this->chunkSize;
+		chunkRows = (height + this->chunkSize - 1) / this->chunkSize;
+		chunks.resize((size_t)chunkColumns * chunkRows);
+	}
+
+	MapLayer::MapLayer(uint32_t i, const std::vector<TilesetRange>& tilesets, uint32_t width, uint32_t height, uint32_t chunkSize)
+	{
+		index = i;
+		this->tilesets = &tilesets;
+		this->width = width;
+		this->height = height;
+		this->chunkSize = std::max(chunkSize, 1u);
+		tiles.resize((size_t)width * height, 0);
+		flipFlags.resize(tiles.size(), 0);
+
+		chunkColumns = (width + this->chunkSize - 1) / this->chunkSize;
+		chunkRows = (height + this->chunkSize - 1) / this->chunkSize;
+		chunks.resize((size_t)chunkColumns * chunkRows);
 	}
 
 	MapLayer::~MapLayer()
 	{
-		for (auto& ss: subsets)
+		for (uint32_t chunk = 0; chunk < chunks.size(); chunk++)
+			UnloadChunk(chunk);
+	}
+
+	//Size of a chunk in tiles, the chunks on the right and bottom edges may be smaller
+	Vector2Int MapLayer::ChunkSize(uint32_t chunk) const
+	{
+		const uint32_t x = (chunk % chunkColumns) * chunkSize;
+		const uint32_t y = (chunk / chunkColumns) * chunkSize;
+		return Vector2Int(std::min(chunkSize, width - x), std::min(chunkSize, height - y));
+	}
+
+	//Fill the lookup data of a chunk. Only reads the layer, so chunks can be built on several threads at once
+	void MapLayer::BuildChunk(uint32_t chunk, ChunkData& data) const
+	{
+		data.chunk = chunk;
+		data.tilesets.clear();
+		data.lookups.clear();
+
+		const Vector2Int size = ChunkSize(chunk);
+		if (!bakedChunks.empty())
 		{
-			delete ss.lookup;
+			//Cooked maps already have the lookup data
+			const BakedChunk& baked = bakedChunks[chunk];
+			const size_t lookupSize = size.x * size.y * 2;
+			for (uint32_t i = 0; i < baked.tilesetCount; i++)
+			{
+				const uint16_t* lookup = bakedLookups.data() + baked.lookupOffset + i * lookupSize;
+				data.tilesets.push_back(bakedTilesets[baked.firstTileset + i]);
+				data.lookups.emplace_back(lookup, lookup + lookupSize);
+			}
+			return;
+		}
+
+		const size_t firstTile = (size_t)(chunk / chunkColumns) * chunkSize * width + (chunk % chunkColumns) * chunkSize;
+		const size_t lookupSize = size.x * size.y * 2;
+		//One lookup texture for each tileset this chunk uses, made when the first tile of the tileset is found
+		std::vector<uint32_t> tilesetLookups(tilesets->size(), UINT32_MAX);
+		std::vector<std::vector<uint16_t>> lookups;
+		uint32_t tileset = 0;
+		for (int64_t y = 0; y < size.y; y++)
+		{
+			for (int64_t x = 0; x < size.x; x++)
+			{
+				const size_t tile = firstTile + y * width + x;
+				const uint32_t gid = tiles[tile];
+				if (gid == 0)
+					continue;
+
+				//Neighbouring tiles are usually from the same tileset
+				if (tileset >= tilesets->size() || gid < (*tilesets)[tileset].firstGID || gid > (*tilesets)[tileset].lastGID)
+				{
+					tileset = FindTileset(*tilesets, gid);
+					if (tileset >= tilesets->size())
+						continue;
+				}
+				if (tilesetLookups[tileset] == UINT32_MAX)
+				{
+					tilesetLookups[tileset] = lookups.size();
+					//UINT16_MAX aka 65535 is no tile
+					lookups.emplace_back(lookupSize, UINT16_MAX);
+				}
+
+				//Red channel is used for tile ids relative to the tileset, green for flip flags
+				std::vector<uint16_t>& lookup = lookups[tilesetLookups[tileset]];
+				lookup[(y * size.x + x) * 2] = gid - (*tilesets)[tileset].firstGID;
+				lookup[(y * size.x + x) * 2 + 1] = flipFlags[tile];
+			}
+		}
+
+		//In the order of the tilesets, so the subsets are always drawn in the same order
+		for (uint32_t i = 0; i < tilesets->size(); i++)
+		{
+			if (tilesetLookups[i] != UINT32_MAX)
+			{
+				data.tilesets.push_back(i);
+				data.lookups.push_back(std::move(lookups[tilesetLookups[i]]));
+			}
 		}
 	}
 
-	//Draw a quad for each subset in this layer
-	void MapLayer::DrawSubsets(int tilesetSizeLoc)
+	//Create the lookup textures of a chunk from built data, returns the bytes of lookup textures added
+	size_t MapLayer::UploadChunk(const ChunkData& data)
 	{
-		for (const auto& ss: subsets)
-		{
-			glUniform2ui(tilesetSizeLoc, ss.columns, ss.rows);
+		UnloadChunk(data.chunk);
 
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, ss.texture->ID());
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, ss.lookup->ID());
+		const Vector2Int size = ChunkSize(data.chunk);
+		std::vector<Subset>& subsets = chunks[data.chunk];
+		for (size_t i = 0; i < data.tilesets.size(); i++)
+		{
+			//This is a special texture so we set it up here
+			GLuint tex;
+			glGenTextures(1, &tex);
+			glBindTexture(GL_TEXTURE_2D, tex);
+			//Only nearest works
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			//Give the lookup table data
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16UI, size.x, size.y, 0, GL_RG_INTEGER, GL_UNSIGNED_SHORT, data.lookups[i].data());
+			glBindTexture(GL_TEXTURE_2D, 0);
 
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			const TilesetRange& range = (*tilesets)[data.tilesets[i]];
+			subsets.push_back(Subset{ data.tilesets[i], range.columns, range.rows, range.texture, new Texture(tex, size) });
 		}
+		return subsets.size() * size.x * size.y * 2 * sizeof(uint16_t);
 	}
 
-	//Create a subset for each tilseset this layer uses
-	void MapLayer::CreateSubsets(const tmx::Map* map)
+	//Delete the lookup textures of a chunk, returns the bytes freed
+	size_t MapLayer::UnloadChunk(uint32_t chunk)
 	{
-		const auto& layers = map->getLayers();
-		if (index >= layers.size() || layers[index]->getType() != tmx::Layer::Type::Tile)
+		const Vector2Int size = ChunkSize(chunk);
+		const size_t bytes = chunks[chunk].size() * size.x * size.y * 2 * sizeof(uint16_t);
+		for (Subset& subset : chunks[chunk])
+			delete subset.lookup;
+		chunks[chunk].clear();
+		return bytes;
+	}
+
+	//Change a tile, the loaded chunks are updated by UpdateDirtyChunks. Doesn't update the collider boxes
+	void MapLayer::SetTile(uint32_t x, uint32_t y, uint32_t gid, uint8_t flip)
+	{
+		const size_t tile = (size_t)y * width + x;
+		tiles[tile] = gid;
+		flipFlags[tile] = flip;
+
+		//The baked lookups no longer match the tiles
+		if (!bakedChunks.empty())
 		{
-			debug::LogWarning("Invalid tilemap layer index or layer type, layer will be empty");
+			bakedChunks.clear();
+			bakedTilesets.clear();
+			bakedLookups.clear();
+		}
+
+		const uint32_t chunk = (y / chunkSize) * chunkColumns + x / chunkSize;
+		if (dirtyRects.empty())
+			dirtyRects.resize(chunks.size());
+
+		const Vector2Int pos(x % chunkSize, y % chunkSize);
+		DirtyRect& rect = dirtyRects[chunk];
+		if (rect.start.x >= rect.end.x)
+		{
+			rect = DirtyRect{ pos, pos + Vector2Int(1, 1) };
+			dirtyChunks.push_back(chunk);
 			return;
 		}
+		rect.start = Vector2Int(std::min(rect.start.x, pos.x), std::min(rect.start.y, pos.y));
+		rect.end = Vector2Int(std::max(rect.end.x, pos.x + 1), std::max(rect.end.y, pos.y + 1));
+	}
 
-		const tmx::Vector2u& mapSize = map->getTileCount();
-		const auto& tiles = layers[index]->getLayerAs<tmx::TileLayer>().getTiles();
-		//Go through all tilesets in the map
-		for (int i = 0; i < map->getTilesets().size(); i++)
+	//Upload the tiles changed since the last call to the lookup textures of the loaded chunks, only the changed rectangle of each chunk
+	int64_t MapLayer::UpdateDirtyChunks(const std::vector<bool>& loadedChunks)
+	{
+		int64_t bytes = 0;
+		std::vector<uint32_t> rectTilesets;
+		std::vector<uint16_t> lookup;
+		for (uint32_t chunk : dirtyChunks)
 		{
-			const tmx::Tileset& ts = map->getTilesets()[i];
-			std::vector<uint16_t> lookupData;
-			bool tsUsed = false;
+			const DirtyRect rect = dirtyRects[chunk];
+			dirtyRects[chunk] = DirtyRect{};
+			//Chunks which aren't loaded are built from the changed tiles when they are
+			if (!loadedChunks[chunk])
+				continue;
+			std::vector<Subset>& subsets = chunks[chunk];
 
-			//Check each tile ID to see if it falls in the current tile set
-			for (const tmx::TileLayer::Tile& tile : tiles)
+			//Find the tileset of every changed tile once
+			const size_t firstTile = (size_t)(chunk / chunkColumns) * chunkSize * width + (chunk % chunkColumns) * chunkSize;
+			const Vector2Int size = rect.end - rect.start;
+			rectTilesets.assign(size.x * size.y, UINT32_MAX);
+			bool newTileset = false;
+			uint32_t tileset = 0;
+			for (int64_t y = 0; y < size.y; y++)
 			{
-				if (tile.ID >= ts.getFirstGID() && tile.ID <= ts.getLastGID())
+				for (int64_t x = 0; x < size.x; x++)
 				{
-					//Make sure to index relative to the tileset
-					uint16_t id = tile.ID - ts.getFirstGID();
-					//Red channel is used for tile ids
-					lookupData.push_back(id);
-					//Green channel is used for flip flags
-					lookupData.push_back(tile.flipFlags);
-					tsUsed = true;
+					const uint32_t gid = tiles[firstTile + (rect.start.y + y) * width + rect.start.x + x];
+					if (gid == 0)
+						continue;
+					if (tileset >= tilesets->size() || gid < (*tilesets)[tileset].firstGID || gid > (*tilesets)[tileset].lastGID)
+					{
+						tileset = FindTileset(*tilesets, gid);
+						if (tileset >= tilesets->size())
+							continue;
+					}
+					rectTilesets[y * size.x + x] = tileset;
+					newTileset = newTileset || std::none_of(subsets.begin(), subsets.end(), [tileset](const Subset& subset) { return subset.tileset == tileset; });
 				}
-				else
+			}
+
+			//A new tileset needs a new lookup texture, so the whole chunk is built again
+			if (newTileset)
+			{
+				ChunkData data;
+				BuildChunk(chunk, data);
+				bytes -= UnloadChunk(chunk);
+				bytes += UploadChunk(data);
+				continue;
+			}
+
+			//Otherwise only the changed rectangle of each lookup texture is replaced
+			for (const Subset& subset : subsets)
+			{
+				//UINT16_MAX aka 65535 is no tile
+				lookup.assign(size.x * size.y * 2, UINT16_MAX);
+				for (int64_t y = 0; y < size.y; y++)
 				{
-					//UINT16_MAX aka 65535 is no tile
-					lookupData.push_back(UINT16_MAX);
-					lookupData.push_back(UINT16_MAX);
+					for (int64_t x = 0; x < size.x; x++)
+					{
+						if (rectTilesets[y * size.x + x] != subset.tileset)
+							continue;
+						//Red channel is used for tile ids relative to the tileset, green for flip flags
+						const size_t tile = firstTile + (rect.start.y + y) * width + rect.start.x + x;
+						lookup[(y * size.x + x) * 2] = tiles[tile] - (*tilesets)[subset.tileset].firstGID;
+						lookup[(y * size.x + x) * 2 + 1] = flipFlags[tile];
+					}
 				}
+
+				glBindTexture(GL_TEXTURE_2D, subset.lookup->ID());
+				glTexSubImage2D(GL_TEXTURE_2D, 0, rect.start.x, rect.start.y, size.x, size.y, GL_RG_INTEGER, GL_UNSIGNED_SHORT, lookup.data());
 			}
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		dirtyChunks.clear();
+		return bytes;
+	}
 
-			//If we have some data for this tile set, create the resources
-			if (tsUsed)
+	//Draw a quad for each subset of the loaded chunks from start up to but not including end, in chunk coordinates
+	void MapLayer::DrawChunks(Vector2Int start, Vector2Int end, const glm::mat4& model, Vector2Int tileSize, int modelLoc, int tilesetSizeLoc) const
+	{
+		for (int64_t y = std::max<int64_t>(start.y, 0); y < std::min<int64_t>(end.y, chunkRows); y++)
+		{
+			for (int64_t x = std::max<int64_t>(start.x, 0); x < std::min<int64_t>(end.x, chunkColumns); x++)
 			{
-				//This is a special texture so we set it up here
-				GLuint tex;
-				glGenTextures(1, &tex);
-				glBindTexture(GL_TEXTURE_2D, tex);
-				//Only nearest works
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-				//Give the lookup table data
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16UI, mapSize.x, mapSize.y, 0, GL_RG_INTEGER, GL_UNSIGNED_SHORT, lookupData.data());
-				glBindTexture(GL_TEXTURE_2D, 0);
+				const uint32_t chunk = y * chunkColumns + x;
+				if (chunks[chunk].empty())
+					continue;
+
+				//Stretch the unit quad over the chunk, the first row of tiles is at the top of the layer
+				const Vector2Int size = ChunkSize(chunk);
+				glm::mat4 chunkModel = glm::translate(model, glm::vec3(x * chunkSize * tileSize.x, ((int64_t)height - y * chunkSize - size.y) * tileSize.y, 0));
+				chunkModel = glm::scale(chunkModel, glm::vec3(size.x * tileSize.x, size.y * tileSize.y, 1));
+				glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(chunkModel));
+
+				for (const Subset& ss : chunks[chunk])
+				{
+					glUniform2ui(tilesetSizeLoc, ss.columns, ss.rows);
 
-				//Add the subset
-				Subset subset{
-					ts.getColumnCount(),
-					ts.getTileCount() / ts.getColumnCount(),
-					tilesetTextures[i],
-					new Texture(tex, {mapSize.x, mapSize.y})
-				};
-				subsets.push_back(subset);
+					glActiveTexture(GL_TEXTURE0);
+					glBindTexture(GL_TEXTURE_2D, ss.texture->ID());
+					glActiveTexture(GL_TEXTURE1);
+					glBindTexture(GL_TEXTURE_2D, ss.lookup->ID());
+
+					glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+				}
 			}
 		}
 	}
 
-	//Load pixel data from disk with stbimage
+	//Load a tmx map, or its cooked .unmap file instead if that is newer. Also loads the pixel data of the tilesets
 	bool Tilemap::Load(const std::string& path, GLuint filteringType)
 	{
-		map = new tmx::Map();
-		if (!map->load(path))
+		//Loading again replaces the map instead of adding to it
+		Clear();
+		bool loaded = false;
+		const std::filesystem::path cookedPath = std::filesystem::path(path).replace_extension(".unmap");
+		if (std::filesystem::path(path).extension() == ".unmap")
+			loaded = LoadCooked(path, false);
+		else
+		{
+			//Prefer the cooked map, unless the tmx or the files it uses have been edited after it was cooked
+			std::error_code cookedError, tmxError;
+			const auto cookedTime = std::filesystem::last_write_time(cookedPath, cookedError);
+			const auto tmxTime = std::filesystem::last_write_time(path, tmxError);
+			if (!cookedError && (tmxError || cookedTime >= tmxTime))
+			{
+				loaded = LoadCooked(cookedPath.string(), true);
+				if (!loaded)
+				{
+					debug::LogWarning("Failed to load cooked tilemap " + cookedPath.string() + ", loading the tmx instead");
+					Clear();
+				}
+			}
+			if (!loaded)
+				loaded = LoadTMX(path);
+		}
+
+		if (!loaded)
+		{
+			Clear();
+			return false;
+		}
+		LoadTilesetTextures(filteringType);
+
+		ResetStreaming();
+
+		this->fullPath = path;
+		this->path = path.substr(resources::rootPath.size());
+		debug::LogSpam("Successfully loaded tilemap " + path);
+		return true;
+	}
+
+	//Parse a tmx map with tmxlite and build the layers from it, without loading the tileset images
+	bool Tilemap::LoadTMX(const std::string& path)
+	{
+		tmx::Map map;
+		if (!map.load(path))
 		{
 			debug::LogError("Failed to load tilemap at: " + path);
-			delete map;
 			return false;
 		}
 
-		tileSize = Vector2(map->getTileSize().x, map->getTileSize().y);
-		tilesets = map->getTilesets();
+		tileSize = Vector2(map.getTileSize().x, map.getTileSize().y);
+
+		SetDefaultCollider();
 
 		//Process all tiles in each tileset
-		for (const tmx::Tileset& tileset : tilesets)
+		for (const tmx::Tileset& tileset : map.getTilesets())
 		{
-			//TODO: Fix to use new resource management
-			//Load the tileset's texture
-			Texture* texture = new Texture();
-			texture->Load(tileset.getImagePath(), filteringType, false);
-			tilesetTextures.push_back(texture);
+			const uint32_t index = tilesets.size();
+			const uint32_t firstGID = tileset.getFirstGID();
+			const uint32_t lastGID = tileset.getLastGID();
+			tilesets.push_back(TilesetRange{ firstGID, lastGID, tileset.getColumnCount(), tileset.getTileCount() / std::max(tileset.getColumnCount(), 1u) });
+			tilesetNames.push_back(tileset.getName());
+			tilesetImagePaths.push_back(tileset.getImagePath());
+
+			//Every gid of the tileset starts with the default collider
+			if (lastGID >= firstGID)
+				tileData.resize(std::max<size_t>(tileData.size(), (size_t)lastGID + 1));
+			for (uint32_t gid = firstGID; gid <= lastGID && gid != 0; gid++)
+				tileData[gid] = TileData{ index, gid - firstGID, 0, 4, TileInTileset };
 
 			//Get the collider shapes for each tile id
 			for (const tmx::Tileset::Tile& tile: tileset.getTiles())
 			{
-				if (!tile.objectGroup.getObjects().empty())
+				if (!tile.objectGroup.getObjects().empty() && (size_t)firstGID + tile.ID <= lastGID)
 				{
+					TileData& data = tileData[firstGID + tile.ID];
+					const size_t colliderOffset = colliderVertices.size();
 					//Only one collider per tile is currently supported
 					//Get the first object in a tile to be used as a collider
 					for (const tmx::Vector2f& point: tile.objectGroup.getObjects()[0].getPoints())
@@ -179,63 +722,389 @@ namespace une
 						Vector2 vertex(point.x, point.y);
 						vertex.y = -vertex.y;
 						vertex += Vector2((double)tileSize.x / 2, (double)tileSize.y / 2);
-						tileColliders[tile.ID].push_back(vertex);
+						colliderVertices.push_back(vertex);
+					}
+					if (colliderVertices.size() > colliderOffset)
+					{
+						data.colliderOffset = colliderOffset;
+						data.colliderCount = colliderVertices.size() - colliderOffset;
+						data.flags |= TileCustomCollider;
 					}
 				}
 			}
 		}
 
-		this->fullPath = path;
-		this->path = path.substr(resources::rootPath.size());
-		debug::LogSpam("Successfully loaded tilemap " + path);
+		//A cooked map is only up to date while these haven't changed, the tmx itself is checked against the cooked map's write time
+		for (const std::string& tilesetPath : ExternalTilesetPaths(path))
+			sourceFiles.push_back(SourceFile{ tilesetPath, WriteTime(tilesetPath) });
+		for (const std::string& imagePath : tilesetImagePaths)
+			sourceFiles.push_back(SourceFile{ imagePath, WriteTime(imagePath) });
+
+		//Process all the layers, currently we only support tile layers
+		const auto& layers = map.getLayers();
+		std::vector<size_t> tileLayers;
+		for (size_t i = 0; i < layers.size(); i++)
+		{
+			if (layers[i]->getType() == tmx::Layer::Type::Tile)
+				tileLayers.push_back(i);
+		}
+
+		//Every layer decodes its tiles and merges its collider boxes on its own thread
+		//Maps are loaded on the resource loading threads, so the layers get their own tasks instead of blocking the frame's thread pool
+		mapLayers.resize(tileLayers.size(), nullptr);
+		auto loadLayer = [&](size_t i)
+			{
+				//Process the layer properties
+				std::unordered_map<std::string, tmx::Property> layerProperties;
+				for (const tmx::Property& property: layers[tileLayers[i]]->getProperties())
+				{
+					//Convert all properties to lower case
+					std::string propertyName = property.getName();
+					std::transform(propertyName.begin(), propertyName.end(), propertyName.begin(), tolower);
+					layerProperties[propertyName] = property;
+				}
+
+				MapLayer* layer = new MapLayer(&map, tileLayers[i], tilesets, layerProperties, chunkSize);
+				MergeColliderBoxes(*layer, Vector2Int(0, 0), Vector2Int(layer->width, layer->height));
+				mapLayers[i] = layer;
+			};
+		std::vector<std::future<void>> layerTasks;
+		for (size_t i = 1; i < tileLayers.size(); i++)
+			layerTasks.push_back(std::async(std::launch::async, loadLayer, i));
+		if (!tileLayers.empty())
+			loadLayer(0);
+		for (std::future<void>& task : layerTasks)
+			task.get();
+
+		if (map.isInfinite())
+		{
+			Vector2Int size;
+			InfiniteMapBounds(&map, tileOffset, size);
+		}
 		return true;
 	}
 
-	//Make OpenGl Texture using loaded pixel data
-	bool Tilemap::SetupGLResources()
+	//Read a cooked .unmap file into the layers
+	bool Tilemap::LoadCooked(const std::string& path, bool rejectStale)
 	{
-		for (Texture* texture : tilesetTextures)
+		//The whole file is read at once, everything after is copied straight out of it
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
 		{
-			if (!texture->SetupGLResources())
+			debug::LogError("Failed to open cooked tilemap at: " + path);
+			return false;
+		}
+		std::vector<char> data(file.tellg());
+		file.seekg(0);
+		if (!file.read(data.data(), data.size()))
+		{
+			debug::LogError("Failed to read cooked tilemap at: " + path);
+			return false;
+		}
+
+		CookedReader reader(data);
+		char magic[4];
+		uint32_t version = 0;
+		uint32_t cookedChunkSize = 0;
+		if (!reader.Read(magic) || memcmp(magic, cookedMagic, sizeof(magic)) != 0 || !reader.Read(version) || version != cookedVersion)
+		{
+			debug::LogError("Cooked tilemap " + path + " is not a version " + std::to_string(cookedVersion) + " .unmap file");
+			return false;
+		}
+		bool valid = reader.Read(tileSize.x) && reader.Read(tileSize.y) && reader.Read(tileOffset.x) && reader.Read(tileOffset.y) && reader.Read(cookedChunkSize);
+
+		//Source files and tileset images are stored relative to the cooked map
+		const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+		uint32_t sourceCount = 0;
+		valid = valid && reader.Read(sourceCount);
+		for (uint32_t i = 0; valid && i < sourceCount; i++)
+		{
+			SourceFile source;
+			valid = reader.ReadString(source.path) && reader.Read(source.writeTime);
+			source.path = (directory / source.path).lexically_normal().string();
+			if (valid && rejectStale && WriteTime(source.path) > source.writeTime)
 			{
-				debug::LogError("Failed to setup tilemap resources");
-				delete map;
+				debug::LogWarning("Cooked tilemap " + path + " is older than " + source.path);
 				return false;
 			}
+			sourceFiles.push_back(source);
 		}
 
-		//Process all the layers
-		const auto& layers = map->getLayers();
-		for (size_t i = 0; i < layers.size(); i++)
+		uint32_t tilesetCount = 0;
+		valid = valid && reader.Read(tilesetCount);
+		for (uint32_t i = 0; valid && i < tilesetCount; i++)
 		{
-			//Currently we only support tile layers
-			if (layers[i]->getType() == tmx::Layer::Type::Tile)
+			TilesetRange range;
+			std::string name, imagePath;
+			valid = reader.Read(range.firstGID) && reader.Read(range.lastGID) && reader.Read(range.columns) && reader.Read(range.rows)
+				&& reader.ReadString(name) && reader.ReadString(imagePath);
+			tilesets.push_back(range);
+			tilesetNames.push_back(name);
+			tilesetImagePaths.push_back((directory / imagePath).lexically_normal().string());
+		}
+
+		valid = valid && reader.ReadArray(tileData) && reader.ReadArray(colliderVertices);
+		if (!valid)
+		{
+			debug::LogError("Cooked tilemap " + path + " is truncated");
+			return false;
+		}
+		if (!ValidateCookedTiles(tileData, colliderVertices, tilesets.size()))
+		{
+			debug::LogError("Cooked tilemap " + path + " has corrupted tile data");
+			return false;
+		}
+
+		uint32_t layerCount = 0;
+		valid = reader.Read(layerCount);
+		for (uint32_t i = 0; valid && i < layerCount; i++)
+		{
+			uint32_t index = 0, width = 0, height = 0;
+			uint8_t enabled = 0, hasCollision = 0;
+			float zOffset = 0;
+			valid = reader.Read(index) && reader.Read(enabled) && reader.Read(hasCollision) && reader.Read(zOffset) && reader.Read(width) && reader.Read(height);
+			if (!valid)
+				break;
+
+			MapLayer* layer = new MapLayer(index, tilesets, width, height, chunkSize);
+			mapLayers.push_back(layer);
+			layer->enabled = enabled;
+			layer->hasCollision = hasCollision;
+			layer->zOffset = zOffset;
+
+			uint32_t propertyCount = 0;
+			valid = reader.Read(propertyCount);
+			for (uint32_t property = 0; valid && property < propertyCount; property++)
 			{
-				//Process the layer properties
-				std::unordered_map<std::string, tmx::Property> layerProperties;
-				for (const tmx::Property& property: layers[i]->getProperties())
+				std::string name;
+				uint8_t type = 0;
+				valid = reader.ReadString(name) && reader.Read(type);
+				if (valid)
+					valid = ReadProperty(reader, (tmx::Property::Type)type, layer->properties[name]);
+			}
+
+			valid = valid && reader.ReadArray(layer->tiles) && reader.ReadArray(layer->flipFlags) && reader.ReadArray(layer->colliderBoxes)
+				&& reader.ReadArray(layer->bakedChunks) && reader.ReadArray(layer->bakedTilesets) && reader.ReadArray(layer->bakedLookups);
+			if (!valid)
+				break;
+
+			//The baked lookups only fit chunks of the size they were cooked with
+			if (cookedChunkSize != layer->chunkSize)
+			{
+				layer->bakedChunks.clear();
+				layer->bakedTilesets.clear();
+				layer->bakedLookups.clear();
+			}
+			valid = ValidateCookedLayer(*layer, tilesets.size());
+			if (!valid)
+				break;
+			if (layer->hasCollision)
+			{
+				layer->tileBoxes.assign(layer->tiles.size(), 0);
+				for (uint32_t box = 0; box < layer->colliderBoxes.size(); box++)
 				{
-					//Convert all properties to lower case
-					std::string propertyName;
-					std::transform(propertyName.begin(), propertyName.end(), propertyName.begin(), tolower);
-					layerProperties[propertyName] = property;
+					const MapLayer::ColliderBox& colliderBox = layer->colliderBoxes[box];
+					for (uint32_t y = colliderBox.y; y < colliderBox.y + colliderBox.height; y++)
+						std::fill_n(layer->tileBoxes.begin() + (size_t)y * width + colliderBox.x, colliderBox.width, box + 1);
 				}
+			}
+		}
+		if (!valid)
+		{
+			debug::LogError("Cooked tilemap " + path + " is truncated or corrupted");
+			return false;
+		}
+		return true;
+	}
+
+	//Write the loaded map to a cooked .unmap file, which loads with a single read and no processing of the tiles
+	bool Tilemap::SaveCooked(const std::string& path) const
+	{
+		CookedWriter writer;
+		writer.Write(cookedMagic);
+		writer.Write(cookedVersion);
+		writer.Write(tileSize.x);
+		writer.Write(tileSize.y);
+		writer.Write(tileOffset.x);
+		writer.Write(tileOffset.y);
+		writer.Write(chunkSize);
+
+		const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+		writer.Write((uint32_t)sourceFiles.size());
+		for (const SourceFile& source : sourceFiles)
+		{
+			writer.WriteString(CookedPath(source.path, directory));
+			writer.Write(source.writeTime);
+		}
+
+		writer.Write((uint32_t)tilesets.size());
+		for (size_t i = 0; i < tilesets.size(); i++)
+		{
+			writer.Write(tilesets[i].firstGID);
+			writer.Write(tilesets[i].lastGID);
+			writer.Write(tilesets[i].columns);
+			writer.Write(tilesets[i].rows);
+			writer.WriteString(tilesetNames[i]);
+			writer.WriteString(CookedPath(tilesetImagePaths[i], directory));
+		}
 
-				mapLayers.push_back(new MapLayer(map, i, tilesetTextures, layerProperties));
+		writer.WriteArray(tileData);
+		writer.WriteArray(colliderVertices);
+
+		writer.Write((uint32_t)mapLayers.size());
+		for (const MapLayer* layer : mapLayers)
+		{
+			writer.Write(layer->index);
+			writer.Write((uint8_t)layer->enabled);
+			writer.Write((uint8_t)layer->hasCollision);
+			writer.Write(layer->zOffset);
+			writer.Write(layer->width);
+			writer.Write(layer->height);
+
+			std::vector<std::string> propertyNames;
+			for (const auto& [name, property] : layer->properties)
+			{
+				if (IsCookableProperty(property))
+					propertyNames.push_back(name);
+			}
+			std::sort(propertyNames.begin(), propertyNames.end());
+			writer.Write((uint32_t)propertyNames.size());
+			for (const std::string& name : propertyNames)
+			{
+				writer.WriteString(name);
+				WriteProperty(writer, layer->properties.at(name));
 			}
+
+			writer.WriteArray(layer->tiles);
+			writer.WriteArray(layer->flipFlags);
+			writer.WriteArray(layer->colliderBoxes);
+
+			//Bake the lookup data of every chunk, so loading a chunk is a copy. The chunks are built in parallel
+			std::vector<MapLayer::ChunkData> chunks(layer->chunkColumns * layer->chunkRows);
+			GetThreadPool().ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end, unsigned int)
+				{
+					for (size_t chunk = begin; chunk < end; chunk++)
+						layer->BuildChunk(chunk, chunks[chunk]);
+				});
+
+			std::vector<MapLayer::BakedChunk> bakedChunks;
+			std::vector<uint32_t> bakedTilesets;
+			std::vector<uint16_t> bakedLookups;
+			for (const MapLayer::ChunkData& chunkData : chunks)
+			{
+				bakedChunks.push_back(MapLayer::BakedChunk{ bakedLookups.size(), (uint32_t)bakedTilesets.size(), (uint32_t)chunkData.tilesets.size() });
+				bakedTilesets.insert(bakedTilesets.end(), chunkData.tilesets.begin(), chunkData.tilesets.end());
+				for (const std::vector<uint16_t>& lookup : chunkData.lookups)
+					bakedLookups.insert(bakedLookups.end(), lookup.begin(), lookup.end());
+			}
+			writer.WriteArray(bakedChunks);
+			writer.WriteArray(bakedTilesets);
+			writer.WriteArray(bakedLookups);
 		}
 
-		//Initialize the OpenGL resources
-		const tmx::FloatRect bounds = map->getBounds();
-		const float vertices[] = {
-			bounds.left, bounds.top, 0.f, 0.f, 1.f,
-			bounds.left + bounds.width, bounds.top, 0.f, 1.f, 1.f,
-			bounds.left, bounds.top + bounds.height, 0.f, 0.f, 0.f,
-			bounds.left + bounds.width, bounds.top + bounds.height, 0.f, 1.f, 0.f
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file || !file.write(writer.data.data(), writer.data.size()))
+		{
+			debug::LogError("Failed to write cooked tilemap to: " + path);
+			return false;
+		}
+		debug::LogSpam("Cooked tilemap " + path);
+		return true;
+	}
+
+	//Load a tmx map and write it to a cooked .unmap file next to it, for example as a build step
+	bool Tilemap::Cook(const std::string& tmxPath)
+	{
+		//The tmx is parsed even if there is a cooked map already
+		Tilemap tilemap;
+		if (!tilemap.LoadTMX(tmxPath))
+			return false;
+		return tilemap.SaveCooked(std::filesystem::path(tmxPath).replace_extension(".unmap").string());
+	}
+
+	//Load the pixel data of the tilesets
+	void Tilemap::LoadTilesetTextures(GLuint filteringType)
+	{
+		for (size_t i = 0; i < tilesets.size(); i++)
+		{
+			//TODO: Fix to use new resource management
+			Texture* texture = new Texture();
+			texture->Load(tilesetImagePaths[i], filteringType, false);
+			tilesetTextures.push_back(texture);
+			tilesets[i].texture = texture;
+		}
+	}
+
+	//Make an empty map without tilesets, filled in with SetTile or SetTiles. Every tile has the full tile collider
+	void Tilemap::Create(Vector2Int tileSize, uint32_t width, uint32_t height, uint32_t layerCount)
+	{
+		Clear();
+		this->tileSize = tileSize;
+		SetDefaultCollider();
+		for (uint32_t i = 0; i < layerCount; i++)
+			mapLayers.push_back(new MapLayer(i, tilesets, width, height, chunkSize));
+		ResetStreaming();
+	}
+
+	//Set the default collider of a tile from the tile size, before any tile's own collider
+	void Tilemap::SetDefaultCollider()
+	{
+		colliderVertices = {
+			Vector2(-((float) tileSize.x / 2), (float) tileSize.y / 2), //Top-Left
+			Vector2((float) tileSize.x / 2, (float) tileSize.y / 2), //Top-Right
+			Vector2((float) tileSize.x / 2, -((float) tileSize.y / 2)), //Bottom-Right
+			Vector2(-((float) tileSize.x / 2), -((float) tileSize.y / 2)) //Bottom-Left
 		};
+	}
 
-		//Map data is no longer needed
-		delete map;
+	//Mark every chunk of the layers as not loaded, nothing is streamed in until a camera requests it
+	void Tilemap::ResetStreaming()
+	{
+		requestedChunks.clear();
+		streamedBytes = 0;
+		const size_t chunkCount = mapLayers.empty() ? 0 : (size_t)mapLayers.front()->chunkColumns * mapLayers.front()->chunkRows;
+		chunkLoaded.assign(chunkCount, false);
+		chunkLastRequested.assign(chunkCount, 0);
+	}
+
+	//Delete the layers and tileset textures
+	void Tilemap::Clear()
+	{
+		for (MapLayer* layer : mapLayers)
+			delete layer;
+		for (Texture* tex : tilesetTextures)
+			delete tex;
+		mapLayers.clear();
+		tilesetTextures.clear();
+		tilesets.clear();
+		tilesetNames.clear();
+		tilesetImagePaths.clear();
+		sourceFiles.clear();
+		editedRects.clear();
+		tileData.clear();
+		colliderVertices.clear();
+		tileOffset = Vector2Int(0, 0);
+	}
+
+	//Make OpenGl Texture using loaded pixel data
+	bool Tilemap::SetupGLResources()
+	{
+		for (Texture* texture : tilesetTextures)
+		{
+			if (!texture->SetupGLResources())
+			{
+				debug::LogError("Failed to setup tilemap resources");
+				return false;
+			}
+		}
+
+		//Initialize the OpenGL resources, every chunk is drawn with a unit quad stretched over it
+		const float vertices[] = {
+			0.f, 0.f, 0.f, 0.f, 1.f,
+			1.f, 0.f, 0.f, 1.f, 1.f,
+			0.f, 1.f, 0.f, 0.f, 0.f,
+			1.f, 1.f, 0.f, 1.f, 0.f
+		};
 
 		//Make the single shared buffer
 		glGenVertexArrays(1, &VAO);
@@ -272,10 +1141,7 @@ namespace une
 			glDeleteVertexArrays(1, &VAO);
 			glDeleteVertexArrays(1, &VBO);
 		}
-		for (Texture* tex : tilesetTextures)
-			delete tex;
-		for (MapLayer* layer : mapLayers)
-			delete layer;
+		Clear();
 	}
 
 	void Tilemap::SetLayerVisibility(uint32_t layer, bool visible)
@@ -289,6 +1155,58 @@ namespace une
 		mapLayers[layer]->enabled = visible;
 	}
 
+	//Change a tile of a layer at tilemap coords, gid 0 removes the tile
+	void Tilemap::SetTile(uint32_t layer, Vector2Int pos, uint32_t gid, uint8_t flipFlags)
+	{
+		const TileEdit edit{ pos, gid, flipFlags };
+		SetTiles(layer, std::span(&edit, 1));
+	}
+
+	//Change many tiles of a layer at once, the collider boxes around the edits in each chunk are merged only once
+	void Tilemap::SetTiles(uint32_t layer, std::span<const TileEdit> edits)
+	{
+		if (layer >= mapLayers.size())
+		{
+			debug::LogWarning("Invalid layer id " + std::to_string(layer));
+			return;
+		}
+
+		MapLayer& mapLayer = *mapLayers[layer];
+		//Edits far apart don't merge every box between them, each chunk's edits get their own rectangle
+		std::vector<std::pair<uint32_t, Vector2Int>> changed;
+		for (const TileEdit& edit : edits)
+		{
+			if (edit.pos.x < 0 || edit.pos.y < 0 || edit.pos.x >= mapLayer.width || edit.pos.y >= mapLayer.height)
+				continue;
+			mapLayer.SetTile(edit.pos.x, edit.pos.y, edit.gid, edit.flipFlags);
+			if (mapLayer.hasCollision)
+				changed.emplace_back((edit.pos.y / mapLayer.chunkSize) * mapLayer.chunkColumns + edit.pos.x / mapLayer.chunkSize, edit.pos);
+		}
+		std::sort(changed.begin(), changed.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+		//Only the boxes around the changed tiles are merged again
+		for (auto first = changed.begin(); first != changed.end();)
+		{
+			TileRect rect{ first->second, Vector2Int(first->second.x + 1, first->second.y + 1) };
+			auto last = first;
+			for (; last != changed.end() && last->first == first->first; last++)
+			{
+				rect.start = Vector2Int(std::min(rect.start.x, last->second.x), std::min(rect.start.y, last->second.y));
+				rect.end = Vector2Int(std::max(rect.end.x, last->second.x + 1), std::max(rect.end.y, last->second.y + 1));
+			}
+			MergeColliderBoxes(mapLayer, rect.start, rect.end);
+			editedRects.push_back(rect);
+			first = last;
+		}
+	}
+
+	//Move the rectangles of collision tiles changed since the last call to the end of rects
+	void Tilemap::TakeEditedRects(std::vector<TileRect>& rects)
+	{
+		rects.insert(rects.end(), editedRects.begin(), editedRects.end());
+		editedRects.clear();
+	}
+
 	//Get the position of a tile in world coordinates when attached to an entity
 	Vector3 Tilemap::GetTilePosition(ecs::Entity entity, Vector2Int pos) const
 	{
@@ -308,49 +1226,232 @@ namespace une
 	}
 
 	//Returns the vertices making up this tile's collider
-	std::vector<Vector2> Tilemap::GetTileCollider(uint32_t gid) const
+	std::span<const Vector2> Tilemap::GetTileCollider(uint32_t gid) const
+	{
+		if (HasCustomCollider(gid))
+			return std::span(colliderVertices).subspan(tileData[gid].colliderOffset, tileData[gid].colliderCount);
+		//Default collider of a tile
+		return std::span(colliderVertices).first(std::min<size_t>(colliderVertices.size(), 4));
+	}
+
+	//Does this tile have its own collider shape instead of covering the whole tile
+	bool Tilemap::HasCustomCollider(uint32_t gid) const
 	{
-		if (tileColliders.contains(gid - 1))
+		return gid < tileData.size() && (tileData[gid].flags & TileCustomCollider);
+	}
+
+	//Returns the TileInfo of a gid, tiles not in any tileset have the full tile collider
+	Tilemap::TileInfo Tilemap::GetTileInfo(uint32_t gid) const
+	{
+		if (gid >= tileData.size())
+			return TileInfo{ gid, 0, 0, GetTileCollider(gid) };
+		return TileInfo{ gid, tileData[gid].id, tileData[gid].tileset, GetTileCollider(gid) };
+	}
+
+	//Name of a tileset by its index in TileInfo
+	const std::string& Tilemap::GetTilesetName(uint32_t tileset) const
+	{
+		return tilesetNames[tileset];
+	}
+
+	//Merge the full tile colliders of a layer into boxes again in the tiles from start up to but not including end
+	void Tilemap::MergeColliderBoxes(MapLayer& layer, Vector2Int start, Vector2Int end) const
+	{
+		if (!layer.hasCollision || layer.tiles.empty())
+			return;
+		layer.tileBoxes.resize(layer.tiles.size(), 0);
+
+		int64_t minX = std::max<int64_t>(start.x, 0);
+		int64_t minY = std::max<int64_t>(start.y, 0);
+		int64_t maxX = std::min<int64_t>(end.x, layer.width);
+		int64_t maxY = std::min<int64_t>(end.y, layer.height);
+		if (minX >= maxX || minY >= maxY)
+			return;
+
+		//Boxes reaching into the region are taken apart, and the region grows to cover them so their tiles merge again
+		std::vector<uint32_t> removed;
+		for (int64_t y = minY; y < maxY; y++)
 		{
-			return tileColliders.at(gid - 1);
+			for (int64_t x = minX; x < maxX; x++)
+			{
+				const uint32_t box = layer.tileBoxes[y * layer.width + x];
+				if (box != 0)
+					removed.push_back(box);
+			}
 		}
-		else
+		std::sort(removed.begin(), removed.end(), std::greater<uint32_t>());
+		removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+
+		auto stampBox = [&layer](const MapLayer::ColliderBox& box, uint32_t value)
+			{
+				for (uint32_t y = box.y; y < box.y + box.height; y++)
+					std::fill_n(layer.tileBoxes.begin() + y * layer.width + box.x, box.width, value);
+			};
+		//Removing the highest indices first means the box moved into a removed box's place is never removed itself
+		for (uint32_t index : removed)
 		{
-			//Default collider of a tile
-			return std::vector<Vector2>{
-				Vector2(-((float) tileSize.x / 2), (float) tileSize.y / 2), //Top-Left
-				Vector2((float) tileSize.x / 2, (float) tileSize.y / 2), //Top-Right
-				Vector2((float) tileSize.x / 2, -((float) tileSize.y / 2)), //Bottom-Right
-				Vector2(-((float) tileSize.x / 2), -((float) tileSize.y / 2)) //Bottom-Left
+			const MapLayer::ColliderBox box = layer.colliderBoxes[index - 1];
+			minX = std::min<int64_t>(minX, box.x);
+			minY = std::min<int64_t>(minY, box.y);
+			maxX = std::max<int64_t>(maxX, box.x + box.width);
+			maxY = std::max<int64_t>(maxY, box.y + box.height);
+			stampBox(box, 0);
+
+			if (index != layer.colliderBoxes.size())
+			{
+				layer.colliderBoxes[index - 1] = layer.colliderBoxes.back();
+				stampBox(layer.colliderBoxes[index - 1], index);
+			}
+			layer.colliderBoxes.pop_back();
+		}
+
+		//Greedily grow a box right as far as the same GID goes, then down while every tile of the next row matches
+		auto mergeable = [&layer](int64_t x, int64_t y, uint32_t gid)
+			{
+				const size_t tile = y * layer.width + x;
+				return layer.tiles[tile] == gid && layer.tileBoxes[tile] == 0;
 			};
+		for (int64_t y = minY; y < maxY; y++)
+		{
+			for (int64_t x = minX; x < maxX; x++)
+			{
+				const uint32_t gid = layer.tiles[y * layer.width + x];
+				if (gid == 0 || layer.tileBoxes[y * layer.width + x] != 0 || HasCustomCollider(gid))
+					continue;
+
+				MapLayer::ColliderBox box{ (uint32_t)x, (uint32_t)y, 1, 1, gid };
+				while (x + box.width < maxX && mergeable(x + box.width, y, gid))
+					box.width++;
+				while (y + box.height < maxY)
+				{
+					bool rowMatches = true;
+					for (int64_t rowX = x; rowX < x + box.width && rowMatches; rowX++)
+						rowMatches = mergeable(rowX, y + box.height, gid);
+					if (!rowMatches)
+						break;
+					box.height++;
+				}
+
+				layer.colliderBoxes.push_back(box);
+				stampBox(box, layer.colliderBoxes.size());
+				x += box.width - 1;
+			}
 		}
 	}
 
-	//Returns the TileInfo of every tile with a collider at tilemap coords
-	std::vector<Tilemap::TileInfo> Tilemap::GetCollisionTilesAtLocation(Vector2Int pos) const
+	//Keep the chunks from start up to but not including end loaded, in chunk coordinates
+	void Tilemap::RequestChunks(Vector2Int start, Vector2Int end)
 	{
-		std::vector<TileInfo> hits;
-		for (const MapLayer* layer : mapLayers)
+		if (mapLayers.empty())
+			return;
+
+		const MapLayer& layer = *mapLayers.front();
+		for (int64_t y = std::max<int64_t>(start.y, 0); y < std::min<int64_t>(end.y, layer.chunkRows); y++)
 		{
-			if (layer->hasCollision && layer->collider[pos.x][pos.y] != 0)
+			for (int64_t x = std::max<int64_t>(start.x, 0); x < std::min<int64_t>(end.x, layer.chunkColumns); x++)
 			{
-				TileInfo info{layer->collider[pos.x][pos.y]};
-				info.collider = tileColliders.at(info.gid);
+				const uint32_t chunk = y * layer.chunkColumns + x;
+				if (chunkLastRequested[chunk] == streamingFrame + 1)
+					continue;
+				chunkLastRequested[chunk] = streamingFrame + 1;
+				if (!chunkLoaded[chunk])
+					requestedChunks.push_back(chunk);
+			}
+		}
+	}
+
+	//Load the requested chunks on the thread pool, unloading the chunks requested longest ago to stay within the streaming budget
+	void Tilemap::UpdateStreaming()
+	{
+		streamingFrame++;
+		//Tiles changed since the last frame
+		for (MapLayer* layer : mapLayers)
+			streamedBytes += layer->UpdateDirtyChunks(chunkLoaded);
 
-				//Find the tileset this GID belongs to
-				for (int i = 0; i < tilesets.size(); i++)
+		if (requestedChunks.size() > chunkLoadsPerFrame)
+			requestedChunks.resize(chunkLoadsPerFrame);
+
+		//Build the lookup data of every layer of the chunks in parallel, only the upload needs the main thread
+		std::vector<MapLayer::ChunkData> chunkData(requestedChunks.size() * mapLayers.size());
+		GetThreadPool().ParallelFor(chunkData.size(), 1, [&](size_t begin, size_t end, unsigned int)
+			{
+				for (size_t i = begin; i < end; i++)
+					mapLayers[i % mapLayers.size()]->BuildChunk(requestedChunks[i / mapLayers.size()], chunkData[i]);
+			});
+
+		//Unload the chunks requested longest ago first, but never the ones requested this frame. They're only gathered once something has to go
+		std::vector<uint32_t> loaded;
+		size_t unloaded = 0;
+		bool gathered = false;
+		auto unloadOldest = [&]()
+			{
+				if (!gathered)
 				{
-					if (tilesets[i].getFirstGID() > info.gid)
+					gathered = true;
+					for (uint32_t chunk = 0; chunk < chunkLoaded.size(); chunk++)
 					{
-						i--;
-						info.id = info.gid - tilesets[i].getFirstGID();
-						info.tilesetName = tilesets[i].getName();
-						hits.push_back(info);
-						break;
+						if (chunkLoaded[chunk] && chunkLastRequested[chunk] != streamingFrame)
+							loaded.push_back(chunk);
 					}
+					std::sort(loaded.begin(), loaded.end(), [this](uint32_t lhs, uint32_t rhs)
+						{
+							return chunkLastRequested[lhs] != chunkLastRequested[rhs] ? chunkLastRequested[lhs] < chunkLastRequested[rhs] : lhs < rhs;
+						});
 				}
-			}
+				if (unloaded == loaded.size())
+					return false;
+				for (MapLayer* layer : mapLayers)
+					streamedBytes -= layer->UnloadChunk(loaded[unloaded]);
+				chunkLoaded[loaded[unloaded]] = false;
+				unloaded++;
+				return true;
+			};
+
+		//The budget is a hard limit, a requested chunk which doesn't fit after unloading the older chunks isn't loaded and neither are the ones after it
+		for (size_t i = 0; i < requestedChunks.size(); i++)
+		{
+			const MapLayer::ChunkData* data = &chunkData[i * mapLayers.size()];
+			size_t bytes = 0;
+			for (size_t layer = 0; layer < mapLayers.size(); layer++)
+				bytes += LookupBytes(data[layer]);
+			while (streamedBytes + bytes > streamingBudget && unloadOldest());
+			if (streamedBytes + bytes > streamingBudget)
+				break;
+
+			for (size_t layer = 0; layer < mapLayers.size(); layer++)
+				streamedBytes += mapLayers[layer]->UploadChunk(data[layer]);
+			chunkLoaded[requestedChunks[i]] = true;
 		}
+		requestedChunks.clear();
+
+		//Changed tiles can also grow the loaded chunks past the budget
+		while (streamedBytes > streamingBudget && unloadOldest());
+	}
+
+	//Bytes of chunk lookup textures currently loaded
+	size_t Tilemap::GetStreamedBytes() const
+	{
+		return streamedBytes;
+	}
+
+	//Returns the TileInfo of every tile with a collider at tilemap coords
+	std::vector<Tilemap::TileInfo> Tilemap::GetCollisionTilesAtLocation(Vector2Int pos) const
+	{
+		std::vector<TileInfo> hits;
+		GetCollisionTilesAtLocation(pos, hits);
 		return hits;
 	}
+
+	//Same as above but reuses the memory of hits, which is cleared first
+	void Tilemap::GetCollisionTilesAtLocation(Vector2Int pos, std::vector<TileInfo>& hits) const
+	{
+		hits.clear();
+		for (const MapLayer* layer : mapLayers)
+		{
+			//Only tiles in a tileset are returned
+			const uint32_t gid = layer->GetColliderGID(pos.x, pos.y);
+			if (gid != 0 && gid < tileData.size() && (tileData[gid].flags & TileInTileset))
+				hits.push_back(GetTileInfo(gid));
+		}
+	}
 }
@@ -1,59 +1,88 @@
 #include "TilemapCollision.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace une
 {
-	/*
-	//Find any collision layer tiles in a box
-	std::vector<Vector2> Tilemap::CheckCollisionBox(Vector2 topLeft, Vector2 bottomRight)
+	namespace
 	{
-		//Log all tiles
-		std::vector<Vector2> collisions;
-		if (collisionLayer.empty())
+		//World coordinates to tile coordinates of the tilemap, tile y coordinates grow downwards
+		Vector2 WorldToTile(const glm::mat4& worldToLocal, const Tilemap& tilemap, const Vector2& pos)
 		{
-			return collisions;
+			const glm::vec4 local = worldToLocal * glm::vec4(pos.x, pos.y, 0, 1);
+			return Vector2(local.x / tilemap.tileSize.x, -local.y / tilemap.tileSize.y);
 		}
 
-		//Calculate the x and y index bounds
-		int xMin = floor((topLeft.x + position.x) / tileSize.x);
-		int xMax = ceil((bottomRight.x + position.x) / tileSize.x);
-		int yMin = floor((-topLeft.y + position.y) / tileSize.y);
-		int yMax = ceil((-bottomRight.y + position.y) / tileSize.y);
-
-		//Check every position inside the box
-		for (int x = xMin; x < xMax; x++)
+		//Does any collision layer have a tile at tile coordinates
+		bool HasCollisionTile(const Tilemap& tilemap, int64_t x, int64_t y)
 		{
-			for (int y = yMin; y < yMax; y++)
+			for (const MapLayer* layer : tilemap.mapLayers)
 			{
-				//Check bounds
-				if (x < collisionLayer.size() && x >= 0 && y < collisionLayer[0].size() && y >= 0)
-				{
-					//If tile is in collision layer log it
-					if (collisionLayer[x][y] != 0)
-					{
-						collisions.push_back(Vector2(x, y));
-					}
-				}
+				if (layer->hasCollision && layer->GetColliderGID(x, y) != 0)
+					return true;
 			}
+			return false;
 		}
-		return collisions;
 	}
-	*/
 
-	/*
-	//Returns the collision layers tile ID at x and y
-	unsigned int Tilemap::checkCollision(float x, float y)
+	///Get the tilemap coords of a tile with a collider at this point in world coords
+	Vector2Int TilemapCollisionSystem::GetCollisionTile(ecs::Entity entity, Vector2 pos)
 	{
-		if (collisionLayer.empty())
-			return 0;
+		const Tilemap* tilemap = ecs::GetComponent<TilemapCollider>(entity).tilemap;
+		if (!tilemap)
+			return Vector2Int(-1, -1);
 
-		int xIndex = floor((x + position.x) / tileSize.x);
-		int yIndex = floor((-y + position.y) / tileSize.y);
+		const glm::mat4 worldToLocal = glm::inverse(TransformSystem::GetGlobalTransformMatrix(entity));
+		const Vector2 tile = WorldToTile(worldToLocal, *tilemap, pos);
+		const int64_t x = (int64_t)std::floor(tile.x);
+		const int64_t y = (int64_t)std::floor(tile.y);
+		return HasCollisionTile(*tilemap, x, y) ? Vector2Int(x, y) : Vector2Int(-1, -1);
+	}
 
-		//Check out of bounds
-		if (xIndex >= collisionLayer.size() || yIndex >= collisionLayer[0].size() || xIndex < 0 || yIndex < 0)
-			return 0;
+	///Get the tilemap coords of all tiles with colliders within a rectangle in world coords
+	std::vector<Vector2Int> TilemapCollisionSystem::GetCollisionTiles(ecs::Entity entity, Vector2 topLeft, Vector2 bottomRight)
+	{
+		std::vector<Vector2Int> tiles;
+		const Tilemap* tilemap = ecs::GetComponent<TilemapCollider>(entity).tilemap;
+		if (!tilemap)
+			return tiles;
+
+		//The rectangle may be rotated in the tilemap's space, so every corner is transformed
+		const glm::mat4 worldToLocal = glm::inverse(TransformSystem::GetGlobalTransformMatrix(entity));
+		const Vector2 corners[4] = {
+			WorldToTile(worldToLocal, *tilemap, topLeft),
+			WorldToTile(worldToLocal, *tilemap, Vector2(bottomRight.x, topLeft.y)),
+			WorldToTile(worldToLocal, *tilemap, bottomRight),
+			WorldToTile(worldToLocal, *tilemap, Vector2(topLeft.x, bottomRight.y)) };
+		double minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y;
+		for (const Vector2& corner : corners)
+		{
+			minX = std::min(minX, corner.x);
+			maxX = std::max(maxX, corner.x);
+			minY = std::min(minY, corner.y);
+			maxY = std::max(maxY, corner.y);
+		}
 
-		return collisionLayer[xIndex][yIndex];
+		//Only the tiles inside the layers can have colliders
+		int64_t width = 0, height = 0;
+		for (const MapLayer* layer : tilemap->mapLayers)
+		{
+			width = std::max<int64_t>(width, layer->width);
+			height = std::max<int64_t>(height, layer->height);
+		}
+		const int64_t startX = std::max<int64_t>((int64_t)std::floor(minX), 0);
+		const int64_t endX = std::min<int64_t>((int64_t)std::floor(maxX), width - 1);
+		const int64_t startY = std::max<int64_t>((int64_t)std::floor(minY), 0);
+		const int64_t endY = std::min<int64_t>((int64_t)std::floor(maxY), height - 1);
+		for (int64_t y = startY; y <= endY; y++)
+		{
+			for (int64_t x = startX; x <= endX; x++)
+			{
+				if (HasCollisionTile(*tilemap, x, y))
+					tiles.emplace_back(x, y);
+			}
+		}
+		return tiles;
 	}
-	*/
-}
\ No newline at end of file
+}
@@ -305,16 +305,17 @@ namespace une
 		return globalTransform;
 	}
 
-	glm::mat4 TransformSystem::GetLocalTranformMatrix(ecs::Entity entity)
+	//Get the Transform matrix of an entity without its parents, rendered includes the render offsets
+	glm::mat4 TransformSystem::GetLocalTranformMatrix(ecs::Entity entity, bool rendered)
 	{
 		const Transform& transform = ecs::GetComponent<Transform>(entity);
 
 		//Create the transform matrix
 		glm::mat4 transformMatrix = glm::mat4(1.0f);
 		//Position
-		transformMatrix = glm::translate(transformMatrix, transform.position.ToGlm());
+		transformMatrix = glm::translate(transformMatrix, (rendered ? transform.position + transform.renderPositionOffset : transform.position).ToGlm());
 		//Apply euler rotations in desired order
-		ApplyRotation(transformMatrix, transform.rotation, transform.rotationOrder);
+		ApplyRotation(transformMatrix, rendered ? transform.rotation + transform.renderRotationOffset : transform.rotation, transform.rotationOrder);
 		//Scale
 		transformMatrix = glm::scale(transformMatrix, transform.scale.ToGlm());
 		//Pivot
@@ -324,7 +325,8 @@ namespace une
 	}
 
 	//Get the global Transform matrix of an entity after all parent transforms have been applied
-	glm::mat4 TransformSystem::GetGlobalTransformMatrix(ecs::Entity entity)
+	//Renderers set rendered to include the render offsets of the entity and its parents
+	glm::mat4 TransformSystem::GetGlobalTransformMatrix(ecs::Entity entity, bool rendered)
 	{
 		const Transform& transform = ecs::GetComponent<Transform>(entity);
 
@@ -340,12 +342,12 @@ namespace une
 		}
 
 		//Create the transform matrix
-		glm::mat4 transformMatrix = GetLocalTranformMatrix(parents.back());
+		glm::mat4 transformMatrix = GetLocalTranformMatrix(parents.back(), rendered);
 
 		//Go through each parent from root up
 		for (int i = parents.size() - 2; i >= 0; i--)
 		{
-			transformMatrix *= GetLocalTranformMatrix(parents[i]);
+			transformMatrix *= GetLocalTranformMatrix(parents[i], rendered);
 		}
 
 		return transformMatrix;
@@ -380,7 +382,17 @@ namespace une
 	//Applies relevant 2D transforms to given 2D vertices and returns the transformed vertices
 	std::vector<Vector2> TransformSystem::ApplyTransforms2D(const std::vector<Vector2>& vertices, const Transform& transform)
 	{
-		std::vector<Vector2> transformedVerts;
+		std::vector<Vector2> transformedVerts(vertices.size());
+		ApplyTransforms2D(vertices, transform, transformedVerts.data());
+		return transformedVerts;
+	}
+
+	//Applies relevant 2D transforms to given 2D vertices and writes them to transformedVerts, which must have room for every vertice
+	void TransformSystem::ApplyTransforms2D(const std::vector<Vector2>& vertices, const Transform& transform, Vector2* transformedVerts)
+	{
+		const float angle = Radians(transform.rotation.z);
+		const float cos = cosf(angle);
+		const float sin = sinf(angle);
 		//For each vertice apply scale and rotation
 		for (int i = 0; i < vertices.size(); i++)
 		{
@@ -388,18 +400,16 @@ namespace une
 			//Pivot
 			transformedVert -= transform.pivot;
 			//Rotate
-			const float angle = Radians(transform.rotation.z);
 			const Vector2 tmp = transformedVert;
-			transformedVert.x = tmp.x * cosf(angle) - tmp.y * sinf(angle);
-			transformedVert.y = tmp.x * sinf(angle) + tmp.y * cosf(angle);
+			transformedVert.x = tmp.x * cos - tmp.y * sin;
+			transformedVert.y = tmp.x * sin + tmp.y * cos;
 			//Scale
 			transformedVert *= transform.scale;
 			//Translate
 			transformedVert += transform.position;
 
-			transformedVerts.push_back(transformedVert);
+			transformedVerts[i] = transformedVert;
 		}
-		return transformedVerts;
 	}
 
 	void TransformSystem::ApplyRotation(glm::mat4& mat, Vector3 eulers, RotationOrder order)
@@ -10,6 +10,18 @@ namespace une
 {
 	std::string frameTimerString;
 
+	void SimulationInit()
+	{
+		transformSystem = ecs::GetSystem<TransformSystem>();
+		ecs::SetComponentDestructor<Transform>(TransformSystem::OnTransformRemoved);
+		collisionSystem = ecs::GetSystem<CollisionSystem>();
+		ecs::SetComponentDestructor<PolygonCollider>(CollisionSystem::OnColliderRemoved);
+		ecs::SetComponentDestructor<CircleCollider>(CollisionSystem::OnCircleColliderRemoved);
+		ecs::SetComponentDestructor<CapsuleCollider>(CollisionSystem::OnCapsuleColliderRemoved);
+		physicsSystem = ecs::GetSystem<PhysicsSystem>();
+		ecs::SetComponentDestructor<Rigidbody>(PhysicsSystem::OnRigidbodyRemoved);
+	}
+
 	void EngineInit()
 	{
 		assert(mainWindow && "Make sure to create the main window before initializing UnEngine.");
@@ -17,10 +29,7 @@ namespace une
 		//Get the engine systems
 		timerSystem = ecs::GetSystem<TimerSystem>();
 		timerSystem->Init();
-		transformSystem = ecs::GetSystem<TransformSystem>();
-		ecs::SetComponentDestructor<Transform>(TransformSystem::OnTransformRemoved);
-		collisionSystem = ecs::GetSystem<CollisionSystem>();
-		physicsSystem = ecs::GetSystem<PhysicsSystem>();
+		SimulationInit();
 		soundSystem = ecs::GetSystem<SoundSystem>();
 		animationSystem = ecs::GetSystem<AnimationSystem>();
 		cameraSystem = ecs::GetSystem<CameraSystem>();
@@ -403,7 +403,11 @@ namespace debug::gui
 		ImGui::Checkbox("Trigger", &collider.trigger);
 		ImGui::Checkbox("Visualise", &collider.visualise);
 		ImGui::SetNextItemWidth(100);
-		ImGui::InputInt("Layer", &collider.layer);
+		if (ImGui::InputInt("Layer", &collider.layer))
+		{
+			if (ecs::HasComponent<une::Transform>(selectedEntity))
+				ecs::GetComponent<une::Transform>(selectedEntity).staleCache = true;
+		}
 		ImGui::SetNextItemWidth(100);
 		if (ImGui::DragFloat("Rotation Override", &collider.rotationOverride, 0.2f, -1.f, 360.f, "%.1f"))
 		{
@@ -446,6 +450,98 @@ namespace debug::gui
 		ImGui::Separator();
 	}
 
+	void CircleColliderInspector()
+	{
+		une::CircleCollider& collider = ecs::GetComponent<une::CircleCollider>(selectedEntity);
+		bool changed = false;
+
+		//Shape
+		float center[2] = { (float)collider.center.x, (float)collider.center.y };
+		if (ImGui::DragFloat2("Center", center, 0.1f, 0.f, 0.f))
+		{
+			collider.center = { center[0], center[1] };
+			changed = true;
+		}
+		float radius = collider.radius;
+		if (ImGui::DragFloat("Radius", &radius, 0.1f, 0.f, 10000.f))
+		{
+			collider.radius = radius;
+			changed = true;
+		}
+
+		//Simple members
+		ImGui::Separator();
+		changed |= ImGui::Checkbox("Trigger", &collider.trigger);
+		ImGui::Checkbox("Visualise", &collider.visualise);
+		ImGui::SetNextItemWidth(100);
+		changed |= ImGui::InputInt("Layer", &collider.layer);
+		if (changed && ecs::HasComponent<une::Transform>(selectedEntity))
+			ecs::GetComponent<une::Transform>(selectedEntity).staleCache = true;
+
+		//AABB
+		ImGui::Separator();
+		if (ImGui::TreeNode("Bounding Box"))
+		{
+			ImGui::Text("Top:    %.1f", collider.bounds[0]);
+			ImGui::Text("Right:  %.1f", collider.bounds[1]);
+			ImGui::Text("Bottom: %.1f", collider.bounds[2]);
+			ImGui::Text("Left:   %.1f", collider.bounds[3]);
+			ImGui::TreePop();
+		}
+
+		ImGui::Separator();
+	}
+
+	void CapsuleColliderInspector()
+	{
+		une::CapsuleCollider& collider = ecs::GetComponent<une::CapsuleCollider>(selectedEntity);
+		bool changed = false;
+
+		//Shape
+		float start[2] = { (float)collider.start.x, (float)collider.start.y };
+		if (ImGui::DragFloat2("Start", start, 0.1f, 0.f, 0.f))
+		{
+			collider.start = { start[0], start[1] };
+			changed = true;
+		}
+		float end[2] = { (float)collider.end.x, (float)collider.end.y };
+		if (ImGui::DragFloat2("End", end, 0.1f, 0.f, 0.f))
+		{
+			collider.end = { end[0], end[1] };
+			changed = true;
+		}
+		float radius = collider.radius;
+		if (ImGui::DragFloat("Radius", &radius, 0.1f, 0.f, 10000.f))
+		{
+			collider.radius = radius;
+			changed = true;
+		}
+
+		//Simple members
+		ImGui::Separator();
+		changed |= ImGui::Checkbox("Trigger", &collider.trigger);
+		ImGui::Checkbox("Visualise", &collider.visualise);
+		ImGui::SetNextItemWidth(100);
+		changed |= ImGui::InputInt("Layer", &collider.layer);
+		ImGui::SetNextItemWidth(100);
+		changed |= ImGui::DragFloat("Rotation Override", &collider.rotationOverride, 0.2f, -1.f, 360.f, "%.1f");
+		if (changed && ecs::HasComponent<une::Transform>(selectedEntity))
+			ecs::GetComponent<une::Transform>(selectedEntity).staleCache = true;
+
+		//AABB
+		ImGui::Separator();
+		if (ImGui::TreeNode("Bounding Box"))
+		{
+			ImGui::Text("Top:    %.1f", collider.bounds[0]);
+			ImGui::Text("Right:  %.1f", collider.bounds[1]);
+			ImGui::Text("Bottom: %.1f", collider.bounds[2]);
+			ImGui::Text("Left:   %.1f", collider.bounds[3]);
+			ImGui::TreePop();
+		}
+
+		ImGui::Separator();
+	}
+
 	void RigidbodyInspector()
 	{
 		une::Rigidbody& rb = ecs::GetComponent<une::Rigidbody>(selectedEntity);
@@ -463,6 +559,9 @@ namespace debug::gui
 		ImGui::DragFloat("Drag", &rb.drag, 0.01, 0, 999999, "%.3f");
 		ImGui::DragFloat("Restitution", &rb.restitution, 0.01, 0, 1, "%.3f");
 		ImGui::Checkbox("Kinematic", &rb.kinematic);
+		ImGui::Checkbox("Interpolate", &rb.interpolate);
+		ImGui::Checkbox("Can Sleep", &rb.canSleep);
+		ImGui::Text("Sleeping: %s", rb.sleeping ? "Yes" : "No");
 
 		ImGui::Separator();
 
@@ -154,7 +154,7 @@ namespace une::renderer
 		auto model = modelRenderer.model.lock();
 
 		//Create the model matrix, this is the same for each mesh so it only needs to be done once
-		glm::mat4 modelMatrix = TransformSystem::GetGlobalTransformMatrix(entity);
+		glm::mat4 modelMatrix = TransformSystem::GetGlobalTransformMatrix(entity, true);
 
 		unsigned int viewLoc = glGetUniformLocation(shader->ID, "view");
 		unsigned int projLoc = glGetUniformLocation(shader->ID, "projection");
@@ -304,7 +304,7 @@ namespace une
 			}
 
 			//Get mvp
-			glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity);
+			glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity, true);
 			glm::mat4 view = cam.view;
 			glm::mat4 projection = cam.projection;
 
@@ -171,7 +171,7 @@ namespace une::renderer
 		auto texture = sprite.texture.lock();
 
 		//Create the model matrix
-		glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity);
+		glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity, true);
 		model = glm::scale(model, glm::vec3(texture->Size().x, texture->Size().y, 1));
 
 		//Give the shader the model matrix
@@ -99,7 +99,7 @@ namespace une::renderer
 		shader->Use();
 
 		//Create the model matrix, this is the same for each mesh so it only needs to be done once
-		glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity);
+		glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity, true);
 
 		//Give the shader the model matrix
 		int modelLoc = glGetUniformLocation(shader->ID, "model");
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 
 #include "glm/gtc/type_ptr.hpp"
 
@@ -10,6 +11,67 @@
 
 namespace une::renderer
 {
+	namespace
+	{
+		//Chunks of a layer a camera can see from start up to but not including end, model is the layer's model matrix
+		//Never more than the tilemap's streamingRadius chunks away from the chunk in the middle of the view
+		void VisibleChunks(const Tilemap& tilemap, const MapLayer& layer, const glm::mat4& model, const Camera& camera, Vector2Int& start, Vector2Int& end)
+		{
+			//Cast a point of the screen onto the layer's plane, false when it looks past the plane such as above the horizon
+			const glm::mat4 screenToLocal = glm::inverse(camera.projection * camera.view * model);
+			auto castPoint = [&screenToLocal](float x, float y, glm::vec4& nearPoint, glm::vec4& farPoint, glm::vec4& point)
+				{
+					nearPoint = screenToLocal * glm::vec4(x, y, -1, 1);
+					farPoint = screenToLocal * glm::vec4(x, y, 1, 1);
+					nearPoint /= nearPoint.w;
+					farPoint /= farPoint.w;
+					const float t = nearPoint.z / (nearPoint.z - farPoint.z);
+					point = nearPoint + (farPoint - nearPoint) * t;
+					return t >= 0 && t <= 1;
+				};
+
+			//Bounds of the corners on the plane, and of the whole view for when a corner misses it since the view lies inside its near and far corners
+			float hitMinX = INFINITY, hitMinY = INFINITY, hitMaxX = -INFINITY, hitMaxY = -INFINITY;
+			float viewMinX = INFINITY, viewMinY = INFINITY, viewMaxX = -INFINITY, viewMaxY = -INFINITY;
+			bool missed = false;
+			for (float x : { -1.f, 1.f })
+			{
+				for (float y : { -1.f, 1.f })
+				{
+					glm::vec4 nearPoint, farPoint, point;
+					missed |= !castPoint(x, y, nearPoint, farPoint, point);
+					hitMinX = std::min(hitMinX, point.x);
+					hitMinY = std::min(hitMinY, point.y);
+					hitMaxX = std::max(hitMaxX, point.x);
+					hitMaxY = std::max(hitMaxY, point.y);
+					viewMinX = std::min({ viewMinX, nearPoint.x, farPoint.x });
+					viewMinY = std::min({ viewMinY, nearPoint.y, farPoint.y });
+					viewMaxX = std::max({ viewMaxX, nearPoint.x, farPoint.x });
+					viewMaxY = std::max({ viewMaxY, nearPoint.y, farPoint.y });
+				}
+			}
+			const float minX = missed ? viewMinX : hitMinX;
+			const float minY = missed ? viewMinY : hitMinY;
+			const float maxX = missed ? viewMaxX : hitMaxX;
+			const float maxY = missed ? viewMaxY : hitMaxY;
+			//The middle of the view is where its center hits the plane, or right below the camera when it doesn't
+			glm::vec4 nearCenter, farCenter, center;
+			if (!castPoint(0, 0, nearCenter, farCenter, center) || !std::isfinite(center.x) || !std::isfinite(center.y))
+				center = nearCenter;
+
+			//The first row of tiles is at the top of the layer
+			const float layerTop = (float)layer.height * tilemap.tileSize.y;
+			const float chunkWidth = (float)layer.chunkSize * tilemap.tileSize.x;
+			const float chunkHeight = (float)layer.chunkSize * tilemap.tileSize.y;
+			//The view can reach arbitrarily far, or to infinity with an infinite far plane. The bounds come first so they win over NaN
+			const float radius = (float)tilemap.streamingRadius;
+			const float centerX = std::clamp(std::floor(center.x / chunkWidth), -1e9f, 1e9f);
+			const float centerY = std::clamp(std::floor((layerTop - center.y) / chunkHeight), -1e9f, 1e9f);
+			start = Vector2Int((int64_t)std::max(centerX - radius, std::floor(minX / chunkWidth)), (int64_t)std::max(centerY - radius, std::floor((layerTop - maxY) / chunkHeight)));
+			end = Vector2Int((int64_t)std::min(centerX + radius, std::floor(maxX / chunkWidth)) + 1, (int64_t)std::min(centerY + radius, std::floor((layerTop - minY) / chunkHeight)) + 1);
+		}
+	}
+
 	void TilemapRenderSystem::Init()
 	{
 		shader = new Shader(
@@ -98,10 +160,11 @@ namespace une::renderer
 				)", false);
 	}
 
-	//Sorts the tilemap layers into their draw layers (currently only transparent world)
+	//Sorts the tilemap layers into their draw layers (currently only transparent world), and streams the chunks near the cameras
 	void TilemapRenderSystem::Prepass()
 	{
 		transparentWorldLayers.clear();
+		std::vector<Tilemap*> streamedTilemaps;
 
 		//Sort all entities into their draw orders
 		for (ecs::Entity entity: entities)
@@ -109,9 +172,23 @@ namespace une::renderer
 			TilemapRenderer& renderer = ecs::GetComponent<TilemapRenderer>(entity);
 			Vector3 pos = TransformSystem::GetGlobalTransform(entity).position;
 
-			if (!renderer.enabled)
+			if (!renderer.enabled || !renderer.tilemap || renderer.tilemap->mapLayers.empty())
 				continue;
 
+			//Request the chunks every camera sees, and a ring of chunks around them so they are loaded before they come into view
+			const glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity, true);
+			for (ecs::Entity cameraEntity : ecs::GetSystem<CameraSystem>()->entities)
+			{
+				const Camera& camera = ecs::GetComponent<Camera>(cameraEntity);
+				if (!camera.enabled)
+					continue;
+				Vector2Int start, end;
+				VisibleChunks(*renderer.tilemap, *renderer.tilemap->mapLayers.front(), model, camera, start, end);
+				renderer.tilemap->RequestChunks(Vector2Int(start.x - 1, start.y - 1), Vector2Int(end.x + 1, end.y + 1));
+			}
+			if (std::find(streamedTilemaps.begin(), streamedTilemaps.end(), renderer.tilemap) == streamedTilemaps.end())
+				streamedTilemaps.push_back(renderer.tilemap);
+
 			for (const MapLayer* layer: renderer.tilemap->mapLayers)
 			{
 				if (!layer->enabled)
@@ -119,6 +196,9 @@ namespace une::renderer
 				transparentWorldLayers.push_back({entity, pos + Vector3(0, 0, layer->zOffset), DrawRenderable, layer->index});
 			}
 		}
+
+		for (Tilemap* tilemap : streamedTilemaps)
+			tilemap->UpdateStreaming();
 	}
 
 	//Static version of DrawLayer for renderable
@@ -144,12 +224,11 @@ namespace une::renderer
 		shader->Use();
 
 		//Create the model matrix and offset it by the layer zOffset
-		glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity);
+		glm::mat4 model = TransformSystem::GetGlobalTransformMatrix(entity, true);
 		model = glm::translate(model, {0, 0, layer->zOffset});
 
-		//Get and set uniforms
+		//Get and set uniforms, the model matrix is set for each chunk
 		int modelLoc = glGetUniformLocation(shader->ID, "model");
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
 		int viewLoc = glGetUniformLocation(shader->ID, "view");
 		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(cam.view));
 		int projLoc = glGetUniformLocation(shader->ID, "projection");
@@ -161,9 +240,11 @@ namespace une::renderer
 		glUniform1i(glGetUniformLocation(shader->ID, "tilesetTexture"), 0);
 		glUniform1i(glGetUniformLocation(shader->ID, "lookupTexture"), 1);
 
-		//Draw all layer subsets with the same VAO
+		//Draw the loaded chunks this camera sees with the same VAO
+		Vector2Int start, end;
+		VisibleChunks(*tilemapRenderer.tilemap, *layer, model, cam, start, end);
 		glBindVertexArray(tilemapRenderer.tilemap->VAO);
-		layer->DrawSubsets(tilesetSizeLoc);
+		layer->DrawChunks(start, end, model, tilemapRenderer.tilemap->tileSize, modelLoc, tilesetSizeLoc);
 
 		glBindVertexArray(0);
 	}
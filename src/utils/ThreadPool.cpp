@@ -0,0 +1,144 @@
+#include "utils/ThreadPool.h"
+
+#include <algorithm>
+
+namespace une
+{
+	namespace
+	{
+		//Is this thread currently running a range, nested ParallelFors run inline
+		thread_local bool insideRange = false;
+		thread_local unsigned int currentThreadIndex = 0;
+	}
+
+	ThreadPool::ThreadPool(unsigned int threadCount)
+	{
+		StartWorkers(threadCount);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		StopWorkers();
+	}
+
+	//Restart the pool with a different amount of threads, 0 uses every hardware thread
+	void ThreadPool::SetThreadCount(unsigned int threadCount)
+	{
+		std::lock_guard callLock(callMutex);
+		StopWorkers();
+		StartWorkers(threadCount);
+	}
+
+	//Amount of threads including the calling thread, every threadIndex is below this
+	unsigned int ThreadPool::GetThreadCount() const
+	{
+		return workers.size() + 1;
+	}
+
+	//Call function on consecutive ranges of at most chunkSize indices covering [0, count), returns once every range is done
+	void ThreadPool::ParallelFor(size_t count, size_t chunkSize, const RangeFunction& function)
+	{
+		if (count == 0)
+			return;
+		chunkSize = std::max<size_t>(chunkSize, 1);
+
+		//Not worth waking the workers for, or already on a worker
+		if (insideRange || workers.empty() || count <= chunkSize)
+		{
+			//Every thread outside a range runs as threadIndex 0, so two of them must not run at once
+			//Inside a range the outer call already holds callMutex or owns its threadIndex
+			std::unique_lock callLock(callMutex, std::defer_lock);
+			if (!insideRange)
+				callLock.lock();
+
+			const bool wasInside = insideRange;
+			insideRange = true;
+			function(0, count, currentThreadIndex);
+			insideRange = wasInside;
+			return;
+		}
+
+		std::lock_guard callLock(callMutex);
+		{
+			std::lock_guard lock(mutex);
+			job = &function;
+			jobCount = count;
+			jobChunkSize = chunkSize;
+			nextChunk = 0;
+			busyWorkers = workers.size();
+			generation++;
+		}
+		wake.notify_all();
+
+		RunChunks(0);
+
+		std::unique_lock lock(mutex);
+		done.wait(lock, [this]() { return busyWorkers == 0; });
+		job = nullptr;
+	}
+
+	void ThreadPool::StartWorkers(unsigned int threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+		stopping = false;
+		for (unsigned int i = 1; i < threadCount; i++)
+			workers.emplace_back(&ThreadPool::WorkerLoop, this, i, generation);
+	}
+
+	void ThreadPool::StopWorkers()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+	}
+
+	void ThreadPool::WorkerLoop(unsigned int threadIndex, uint64_t seenGeneration)
+	{
+		currentThreadIndex = threadIndex;
+
+		std::unique_lock lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+			if (stopping)
+				return;
+			seenGeneration = generation;
+
+			lock.unlock();
+			RunChunks(threadIndex);
+			lock.lock();
+
+			if (--busyWorkers == 0)
+				done.notify_one();
+		}
+	}
+
+	//Take ranges of the current job until there are none left
+	void ThreadPool::RunChunks(unsigned int threadIndex)
+	{
+		insideRange = true;
+		while (true)
+		{
+			const size_t begin = nextChunk.fetch_add(jobChunkSize);
+			if (begin >= jobCount)
+				break;
+			(*job)(begin, std::min(begin + jobChunkSize, jobCount), threadIndex);
+		}
+		insideRange = false;
+	}
+
+	//Thread pool shared by the engine systems, created on first use with every hardware thread
+	ThreadPool& GetThreadPool()
+	{
+		static ThreadPool threadPool;
+		return threadPool;
+	}
+}